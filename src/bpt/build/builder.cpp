@@ -1,16 +1,22 @@
 #include "./builder.hpp"
 
+#include <bpt/build/iter_compilations.hpp>
 #include <bpt/build/plan/compile_exec.hpp>
 #include <bpt/build/plan/full.hpp>
+#include <bpt/build/source_listing.hpp>
 #include <bpt/compdb.hpp>
 #include <bpt/error/doc_ref.hpp>
 #include <bpt/error/errors.hpp>
 #include <bpt/usage_reqs.hpp>
 #include <bpt/util/fs/io.hpp>
 #include <bpt/util/fs/path.hpp>
+#include <bpt/util/jobserver.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/output.hpp>
+#include <bpt/util/siphash.hpp>
+#include <bpt/util/thread_pool.hpp>
 #include <bpt/util/time.hpp>
+#include <bpt/util/trace.hpp>
 
 #include <boost/leaf/exception.hpp>
 #include <fansi/styled.hpp>
@@ -58,8 +64,8 @@ struct lib_prep_info {
 
 library_plan prepare_library(const sdist_target&      sdt,
                              const crs::library_info& lib,
-                             const crs::package_info& pkg_man) {
-    library_build_params lp;
+                             const crs::package_info& pkg_man,
+                             library_build_params     lp) {
     lp.out_subdir      = normalize_path(sdt.params.subdir / lib.path);
     lp.build_apps      = sdt.params.build_apps;
     lp.build_tests     = sdt.params.build_tests;
@@ -109,7 +115,12 @@ static void activate_more(neo::output<std::set<const lib_prep_info*>> libs_to_bu
     }
 }
 
-build_plan prepare_build_plan(neo::ranges::range_of<sdist_target> auto&& sdists) {
+/**
+ * Create the plan for the given source distributions. `lib_params` provides the parameters of every
+ * library that are not specific to its source distribution.
+ */
+build_plan prepare_build_plan(neo::ranges::range_of<sdist_target> auto&& sdists,
+                              const library_build_params&                lib_params) {
     build_plan plan;
     // First generate a mapping of all libraries
     std::map<lm::usage, lib_prep_info> all_libs;
@@ -147,7 +158,7 @@ build_plan prepare_build_plan(neo::ranges::range_of<sdist_target> auto&& sdists)
                       .emplace(lp->sdt.sd.pkg.id.name, package_plan{lp->sdt.sd.pkg.id.name.str})
                       .first;
         }
-        cur->second.add_library(prepare_library(lp->sdt, lp->lib, lp->pkg));
+        cur->second.add_library(prepare_library(lp->sdt, lp->lib, lp->pkg, lib_params));
     }
     // Add all the packages to the plan:
     for (const auto& pair : pkg_plans) {
@@ -307,24 +318,135 @@ std::string hash_tweaks_dir(const fs::path& tweaks_dir) {
     return std::to_string(hash);
 }
 
+/**
+ * Compute a key of everything that the build plan and its compile commands are derived from: The
+ * package manifests (including those of the solved dependencies) and their build parameters, the
+ * rules and paths of each compilation, the toolchain, the working directory (which the #include
+ * paths are relative to), and the path and content of the tweaks directory.
+ */
+std::uint64_t
+calc_plan_key(const std::vector<sdist_target>& sdists, const build_plan& plan, build_env_ref env) {
+    std::string key;
+    for (auto& sdt : sdists) {
+        key += fmt::format("{}\n{}\n{}\n{}{}{}\n",
+                           sdt.sd.path.string(),
+                           sdt.sd.pkg.to_json(),
+                           sdt.params.subdir.string(),
+                           sdt.params.build_tests,
+                           sdt.params.build_apps,
+                           sdt.params.enable_warnings);
+        for (auto& lib : sdt.params.build_libraries) {
+            key += lib.str + "\n";
+        }
+    }
+    // Everything that generate_compile_command() reads from each compilation
+    for (const compile_file_plan& cf : iter_compilations(plan)) {
+        const auto& rules = cf.rules();
+        key += fmt::format("{}\n{}\n{}{}{}{}\n{}\n",
+                           cf.source_path().string(),
+                           cf.calc_object_file_path(env.toolchain, env.output_root).string(),
+                           rules.enable_warnings(),
+                           rules.syntax_only(),
+                           rules.scan_modules(),
+                           rules.create_precompiled_header(),
+                           rules.precompiled_header().value_or("").string());
+        for (auto& sf : cf.unity_sources()) {
+            key += "unity: " + sf.path.string() + "\n";
+        }
+        for (auto& dir : rules.include_dirs()) {
+            key += "include: " + dir.string() + "\n";
+        }
+        for (auto& def : rules.defs()) {
+            key += "def: " + def + "\n";
+        }
+        for (auto& use : rules.uses()) {
+            key += fmt::format("use: {}/{}\n", use.namespace_, use.name);
+        }
+        for (auto& dir : env.ureqs.include_paths(rules.uses())) {
+            key += "external: " + dir.string() + "\n";
+        }
+    }
+    key += fmt::format("{}\n{}\n{}\n{}\n{}\n{}",
+                       env.toolchain.hash(),
+                       env.knobs.tweaks_dir.value_or("").string(),
+                       env.knobs.cache_buster.value_or(""),
+                       env.knobs.is_tty,
+                       env.output_root.string(),
+                       fs::current_path().string());
+    return siphash64(42, 1729, neo::const_buffer(key)).digest();
+}
+
 template <typename Func>
 void with_build_plan(const build_params&              params,
                      const std::vector<sdist_target>& sdists,
                      Func&&                           fn) {
+    // Share our job limit with child processes (e.g. GCC's -flto=jobserver), unless we are already
+    // using the jobserver of a parent process. This must happen before any threads are started.
+    jobserver::global().serve(params.parallel_jobs);
+
     fs::create_directories(params.out_root);
     auto db = database::open(params.out_root / ".bpt.db");
 
-    auto      plan  = prepare_build_plan(sdists);
-    auto      ureqs = prepare_ureqs(plan, params.toolchain, params.out_root);
+    library_build_params lib_params;
+    // The source directories are only scanned again if they have changed since the prior build
+    lib_params.collect_sources = [&](const source_root& root) {
+        return collect_sources_cached(db, root);
+    };
+    if (params.unity_build) {
+        // Unity compilations are bounded by the times recorded when their sources were last
+        // compiled individually.
+        lib_params.unity.emplace(unity_build_params{
+            .out_root          = params.out_root,
+            .recorded_duration = [&](const compile_file_plan& comp)
+                -> std::optional<std::chrono::milliseconds> {
+                auto obj  = comp.calc_object_file_path(params.toolchain, params.out_root);
+                auto prev = db.command_of(fs::weakly_canonical(obj));
+                if (!prev) {
+                    return std::nullopt;
+                }
+                return prev->duration;
+            },
+        });
+    }
+
+    auto plan = [&] {
+        trace::slice trace_slice{"phase", "Prepare build plan"};
+        return prepare_build_plan(sdists, lib_params);
+    }();
+    auto ureqs = [&] {
+        trace::slice trace_slice{"phase", "Prepare usage requirements"};
+        return prepare_ureqs(plan, params.toolchain, params.out_root);
+    }();
+    stat_cache stats;
+
+    std::optional<object_cache> obj_cache;
+    if (params.object_cache_dir) {
+        // Results are keyed relative to the project and build directories, so that they can be
+        // shared between checkouts of the same project
+        std::vector<fs::path> base_dirs = {params.out_root};
+        for (auto& sdt : sdists) {
+            base_dirs.push_back(sdt.sd.path);
+        }
+        obj_cache.emplace(*params.object_cache_dir,
+                          params.object_cache_max_size,
+                          std::move(base_dirs));
+    }
+
     build_env env{
         params.toolchain,
         params.out_root,
         db,
+        stats,
         toolchain_knobs{
             .is_tty     = stdout_is_a_tty(),
             .tweaks_dir = params.tweaks_dir,
         },
         ureqs,
+        params.content_hash,
+        obj_cache ? &*obj_cache : nullptr,
+        params.memory_budget,
+        params.rerun_tests,
+        params.test_shard,
     };
 
     if (env.knobs.tweaks_dir) {
@@ -336,10 +458,32 @@ void with_build_plan(const build_params&              params,
     }
 
     if (params.generate_compdb) {
-        generate_compdb(plan, env);
+        trace::slice trace_slice{"phase", "Generate compilation database"};
+        // Every compile command would be generated again, so skip it if nothing has changed
+        auto compdb_path = params.out_root / "compile_commands.json";
+        auto plan_key    = calc_plan_key(sdists, plan, env);
+        if (fs::exists(compdb_path) && db.generated_file_key(compdb_path) == plan_key) {
+            bpt_log(debug,
+                    "Skip generating [{}] (The build plan is unchanged)",
+                    compdb_path.string());
+        } else {
+            generate_compdb(plan, env);
+            db.record_generated_file(compdb_path, plan_key);
+        }
     }
 
     fn(std::move(env), std::move(plan));
+
+    if (obj_cache) {
+        obj_cache->trim();
+        auto cache_stats = obj_cache->get_statistics();
+        bpt_log(info,
+                "Object cache: {} hits, {} misses, {} stored, {} evicted",
+                cache_stats.n_hits,
+                cache_stats.n_misses,
+                cache_stats.n_stored,
+                cache_stats.n_evicted);
+    }
 }
 
 }  // namespace
@@ -353,20 +497,25 @@ void builder::compile_files(const std::vector<fs::path>& files, const build_para
 void builder::build(const build_params& params) const {
     with_build_plan(params, _sdists, [&](build_env_ref env, const build_plan& plan) {
         bpt::stopwatch sw;
-        plan.compile_all(env, params.parallel_jobs);
-        bpt_log(info, "Compilation completed in {:L}ms", sw.elapsed_ms().count());
-
-        sw.reset();
-        plan.archive_all(env, params.parallel_jobs);
-        bpt_log(info, "Archiving completed in {:L}ms", sw.elapsed_ms().count());
-
-        sw.reset();
-        plan.link_all(env, params.parallel_jobs);
-        bpt_log(info, "Runtime binary linking completed in {:L}ms", sw.elapsed_ms().count());
-
-        sw.reset();
-        auto test_failures = plan.run_all_tests(env, params.parallel_jobs);
-        bpt_log(info, "Test execution finished in {:L}ms", sw.elapsed_ms().count());
+        auto           test_failures = plan.build_all(env, params.parallel_jobs);
+        bpt_log(info, "Build completed in {:L}ms", sw.elapsed_ms().count());
+        auto pool_stats = thread_pool::global().get_statistics();
+        auto idle_ms
+            = std::chrono::duration_cast<std::chrono::milliseconds>(pool_stats.idle_time);
+        bpt_log(debug,
+                "Thread pool: {} workers, {} tasks executed ({} stolen, {} cancelled), peak queue "
+                "depth {}, idle {:L}ms",
+                pool_stats.n_workers,
+                pool_stats.n_executed,
+                pool_stats.n_stolen,
+                pool_stats.n_cancelled,
+                pool_stats.peak_queue_depth,
+                idle_ms.count());
+        auto cache_stats = env.stats.get_statistics();
+        bpt_log(debug,
+                "File status cache: {} lookups, {} served without a filesystem query",
+                cache_stats.n_lookups,
+                cache_stats.n_hits);
 
         for (auto& fail : test_failures) {
             log_failure(fail);
@@ -6,6 +6,7 @@
 #include <bpt/util/shlex.hpp>
 #include <bpt/util/string.hpp>
 
+#include <fmt/core.h>
 #include <neo/ranges.hpp>
 
 using namespace bpt;
@@ -20,8 +21,11 @@ file_deps_info bpt::parse_mkfile_deps_str(std::string_view str) {
 
     // Remove escaped newlines
     auto no_newlines = replace(str, "\\\n", " ");
+    // Only the first rule names the inputs of the output. With C++ modules enabled, GCC emits
+    // additional rules for the module's BMI that we do not need.
+    auto first_rule = std::string_view(no_newlines).substr(0, no_newlines.find('\n'));
 
-    auto split = split_shell_string(str);
+    auto split = split_shell_string(first_rule);
     auto iter  = split.begin();
     auto stop  = split.end();
     if (iter == stop) {
@@ -29,21 +33,55 @@ file_deps_info bpt::parse_mkfile_deps_str(std::string_view str) {
                 "Invalid deps listing. Shell split was empty. This is almost certainly a bug.");
         return ret;
     }
-    auto& head = *iter;
-    ++iter;
-    if (!ends_with(head, ":")) {
+    // The rule may name more than one target (e.g. the object and a BMI). The first is the output.
+    auto head = *iter;
+    while (iter != stop && !ends_with(*iter, ":")) {
+        ++iter;
+    }
+    if (iter == stop || *iter == ":") {
         bpt_log(
             critical,
-            "Invalid deps listing. Leader item is not colon-terminated. This is probably a bug. "
-            "(Are you trying to use C++ Modules? That's not ready yet, sorry. Set `Deps-Mode` to "
-            "`None` in your toolchain file.)");
+            "Invalid deps listing. Leader item is not colon-terminated. This is probably a bug.");
         return ret;
     }
-    ret.output = head.substr(0, head.length() - 1);
+    if (iter == split.begin()) {
+        head.pop_back();
+    }
+    ++iter;
+    ret.output = head;
     ret.inputs.insert(ret.inputs.end(), iter, stop);
     return ret;
 }
 
+std::optional<outdated_output> bpt::check_output_outdated(database&        db,
+                                                          path_ref         output,
+                                                          std::string_view quoted_command,
+                                                          std::int64_t     toolchain_hash,
+                                                          stat_cache&      stats,
+                                                          bool             compare_digests) {
+    auto prior = get_prior_compilation(db, output, stats, compare_digests);
+    if (!prior) {
+        return outdated_output{"No recorded information"};
+    }
+    if (!stats.exists(output)) {
+        return outdated_output{"Output does not exist"};
+    }
+    if (prior->previous_command.quoted_command != quoted_command) {
+        return outdated_output{"Command has changed"};
+    }
+    if (prior->previous_command.toolchain_hash != toolchain_hash) {
+        return outdated_output{"Toolchain has changed"};
+    }
+    if (!prior->newer_inputs.empty()) {
+        auto reason = fmt::format("Input has changed: [{}]", prior->newer_inputs.front().string());
+        return outdated_output{std::move(reason), std::move(prior->newer_inputs)};
+    }
+    for (auto& in : prior->refreshed_inputs) {
+        db.refresh_dep(in.path, output, in.prev_mtime);
+    }
+    return std::nullopt;
+}
+
 msvc_deps_info bpt::parse_msvc_output_for_deps(std::string_view output, std::string_view leader) {
     auto           lines = split_view(output, "\n");
     std::string    cleaned_output;
@@ -65,51 +103,78 @@ msvc_deps_info bpt::parse_msvc_output_for_deps(std::string_view output, std::str
     return {deps, cleaned_output};
 }
 
-void bpt::update_deps_info(neo::output<database> db_, const file_deps_info& deps) {
+void bpt::update_deps_info(neo::output<database> db_,
+                           const file_deps_info& deps,
+                           stat_cache&           stats,
+                           bool                  record_digests) {
     database& db = db_;
     db.record_compilation(deps.output, deps.command);
     db.forget_inputs_of(deps.output);
     for (auto&& inp : deps.inputs) {
-        auto mtime = fs::last_write_time(inp);
-        db.record_dep(inp, deps.output, (std::min)(mtime, deps.compile_start_time));
+        auto mtime = stats.last_write_time(inp);
+        std::optional<std::uint64_t> digest;
+        if (record_digests && inp.extension() != ".syncheck"
+            && mtime <= deps.compile_start_time) {
+            digest = stats.digest(inp);
+            // The file may have been edited while it was being compiled, after its modification
+            // time was cached. The digest would then describe content that the output was not
+            // built from. Without a digest, the recorded mtime will not match, and the output will
+            // be rebuilt.
+            std::error_code ec;
+            if (fs::last_write_time(inp, ec) != mtime || ec) {
+                digest.reset();
+            }
+        }
+        db.record_dep(inp, deps.output, (std::min)(mtime, deps.compile_start_time), digest);
     }
 }
 
 std::optional<prior_compilation> bpt::get_prior_compilation(const database& db,
-                                                            path_ref        output_path) {
+                                                            path_ref        output_path,
+                                                            stat_cache&     stats,
+                                                            bool            compare_digests) {
     auto cmd_ = db.command_of(output_path);
     if (!cmd_) {
         return {};
     }
-    auto& cmd     = *cmd_;
-    auto  inputs_ = db.inputs_of(output_path);
+    auto inputs_ = db.inputs_of(output_path);
     if (!inputs_) {
         return {};
     }
-    auto& inputs        = *inputs_;
-    auto  changed_files =  //
-        inputs             //
-        | std::views::filter([](const input_file_info& input) {
-              if (input.path.extension() == ".syncheck") {
-                  // Do not consider .syncheck files, as they will always be re-written and have no
-                  // interesting content
-                  return false;
-              }
-              if (!fs::exists(input.path)) {
-                  // The input does not exist, so consider it out-of-date
-                  return true;
-              }
-              if (fs::last_write_time(input.path) != input.prev_mtime) {
-                  // The input has been modified since our last execution
-                  return true;
-              }
-              // No "new" inputs
-              return false;
-          })
-        | std::views::transform([](auto& info) { return info.path; })  //
-        | neo::to_vector;
+    return check_prior_compilation(recorded_compilation{std::move(*cmd_), std::move(*inputs_)},
+                                   stats,
+                                   compare_digests);
+}
+
+prior_compilation bpt::check_prior_compilation(const recorded_compilation& rec,
+                                               stat_cache&                 stats,
+                                               bool                        compare_digests) {
     prior_compilation ret;
-    ret.newer_inputs     = std::move(changed_files);
-    ret.previous_command = cmd;
+    for (const input_file_info& input : rec.inputs) {
+        if (input.path.extension() == ".syncheck") {
+            // Do not consider .syncheck files, as they will always be re-written and have no
+            // interesting content
+            continue;
+        }
+        auto st = stats.stat(input.path);
+        if (!st.exists) {
+            // The input does not exist, so consider it out-of-date
+            ret.newer_inputs.push_back(input.path);
+            continue;
+        }
+        if (st.mtime == input.prev_mtime) {
+            // Not modified since our last execution
+            continue;
+        }
+        if (compare_digests && input.prev_digest && stats.digest(input.path) == input.prev_digest) {
+            // The file was touched, but its content is the same as it was before.
+            ret.refreshed_inputs.push_back(
+                input_file_info{input.path, st.mtime, input.prev_digest});
+            continue;
+        }
+        // The input has been modified since our last execution
+        ret.newer_inputs.push_back(input.path);
+    }
+    ret.previous_command = rec.command;
     return ret;
 }
@@ -29,9 +29,11 @@
 
 #include <bpt/db/database.hpp>
 #include <bpt/util/fs/path.hpp>
+#include <bpt/util/fs/stat_cache.hpp>
 
 #include <neo/out.hpp>
 
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -122,8 +124,15 @@ msvc_deps_info parse_msvc_output_for_deps(std::string_view output, std::string_v
  * `get_prior_compilation`.
  * @param db The database to update
  * @param info The dependency information to store
+ * @param stats The cache from which to obtain the modification times of the inputs
+ * @param record_digests If `true`, also record a digest of the content of each input. No digest is
+ * recorded for an input that was modified after the compilation started, so that the output will be
+ * rebuilt.
  */
-void update_deps_info(neo::output<database> db, const file_deps_info& info);
+void update_deps_info(neo::output<database> db,
+                      const file_deps_info& info,
+                      stat_cache&           stats,
+                      bool                  record_digests = false);
 
 /**
  * The information that is pertinent to the rebuild of a file. This will contain a list of inputs
@@ -133,12 +142,58 @@ void update_deps_info(neo::output<database> db, const file_deps_info& info);
 struct prior_compilation {
     std::vector<fs::path> newer_inputs;
     completed_compilation previous_command;
+    /// Inputs that have a new mtime, but whose content matches the recorded digest
+    std::vector<input_file_info> refreshed_inputs = {};
 };
 
 /**
  * Given the path to an output file, read all the dependency information from the database. If the
  * given output has never been recorded, then the resulting object will be null.
  */
-std::optional<prior_compilation> get_prior_compilation(const database& db, path_ref output_path);
+std::optional<prior_compilation> get_prior_compilation(const database& db,
+                                                       path_ref        output_path,
+                                                       stat_cache&     stats,
+                                                       bool            compare_digests = false);
+
+/**
+ * Check the inputs of a compilation that was loaded from the database (e.g. via
+ * `database::compilations_of`) against the current state of the filesystem. This does not touch
+ * the database, and may be called concurrently.
+ *
+ * If `compare_digests` is `true`, an input with a changed mtime is hashed and compared against its
+ * recorded digest (if any). Inputs with unchanged content are placed in `refreshed_inputs` rather
+ * than `newer_inputs`.
+ */
+prior_compilation check_prior_compilation(const recorded_compilation& rec,
+                                          stat_cache&                 stats,
+                                          bool                        compare_digests = false);
+
+/**
+ * The reason that an output must be generated again, as determined by `check_output_outdated`
+ */
+struct outdated_output {
+    /// A description of the reason, for the logs
+    std::string reason;
+    /// If the output exists and was generated by the same command with the same toolchain, the
+    /// recorded inputs that have been modified since. Otherwise, empty.
+    std::vector<fs::path> changed_inputs = {};
+};
+
+/**
+ * Determine whether an output that is generated by a single command from a fixed set of inputs
+ * (e.g. a static library archive or a linked executable) must be generated again. The output is
+ * up-to-date if it exists, and the database records that it was generated by the same command with
+ * the same toolchain, and none of its recorded inputs have been modified since.
+ *
+ * Inputs that were touched without changing their content are updated in the database.
+ *
+ * @returns The reason that the output must be generated, or `nullopt` if it is up-to-date.
+ */
+std::optional<outdated_output> check_output_outdated(database&        db,
+                                                     path_ref         output,
+                                                     std::string_view quoted_command,
+                                                     std::int64_t     toolchain_hash,
+                                                     stat_cache&      stats,
+                                                     bool             compare_digests = false);
 
 }  // namespace bpt
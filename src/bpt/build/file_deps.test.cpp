@@ -1,5 +1,9 @@
 #include <bpt/build/file_deps.hpp>
 
+#include <bpt/db/database.hpp>
+#include <bpt/temp.hpp>
+#include <bpt/util/fs/io.hpp>
+
 #include <catch2/catch.hpp>
 
 auto path_vec = [](auto... args) { return std::vector<bpt::fs::path>{args...}; };
@@ -21,6 +25,17 @@ TEST_CASE("Parse Makefile deps") {
     CHECK(deps.inputs == path_vec("/foo.main.cpp", "/stdc-predef.h"));
 }
 
+TEST_CASE("Parse Makefile deps with C++ modules") {
+    // GCC names the BMI as a target and emits additional rules for modules
+    auto deps = bpt::parse_mkfile_deps_str(
+        "foo.o gcm.cache/foo.gcm: foo.cppm \\\n"
+        "  bar.hpp\n"
+        "foo.c++-module: gcm.cache/foo.gcm\n"
+        ".PHONY: foo.c++-module\n");
+    CHECK(deps.output == "foo.o");
+    CHECK(deps.inputs == path_vec("foo.cppm", "bar.hpp"));
+}
+
 TEST_CASE("Invalid deps") {
     // Invalid deps does not terminate. This will generate an error message in
     // the logs, but it is a non-fatal error that we can recover from.
@@ -54,4 +69,66 @@ Something else
               "C:\\foo\\bar\\filepath/quux.h",
               "C:\\foo\\bar\\filepath/cats/quux.h",
           }));
-}
\ No newline at end of file
+}
+
+TEST_CASE("Touched inputs with unchanged content are not considered modified") {
+    bpt::stat_cache stats;
+    auto            this_file = bpt::fs::path(__FILE__);
+    auto            digest    = stats.digest(this_file);
+    REQUIRE(digest);
+
+    // Pretend that the file was recorded with a different mtime, but the same content
+    bpt::recorded_compilation rec{
+        .command = {"compile", "", 0, std::chrono::milliseconds(0)},
+        .inputs  = {bpt::input_file_info{this_file, bpt::fs::file_time_type{}, digest}},
+    };
+    auto prior = bpt::check_prior_compilation(rec, stats);
+    CHECK(prior.newer_inputs == path_vec(this_file));
+
+    prior = bpt::check_prior_compilation(rec, stats, true);
+    CHECK(prior.newer_inputs.empty());
+    REQUIRE(prior.refreshed_inputs.size() == 1);
+    CHECK(prior.refreshed_inputs[0].prev_mtime == bpt::fs::last_write_time(this_file));
+
+    // A different digest is a real modification
+    rec.inputs[0].prev_digest = *digest + 1;
+    prior                     = bpt::check_prior_compilation(rec, stats, true);
+    CHECK(prior.newer_inputs == path_vec(this_file));
+}
+
+TEST_CASE("Inputs modified during a compilation are not given a digest") {
+    using namespace std::literals;
+    auto tdir  = bpt::temporary_dir::create();
+    auto input = tdir.path() / "a.cpp";
+    bpt::write_file(input, "int a = 1;");
+
+    bpt::stat_cache     stats;
+    auto                db = bpt::database::open(":memory:"s);
+    bpt::file_deps_info info{
+        .output  = tdir.path() / "a.o",
+        .inputs  = {input},
+        .command = {"compile", "", 0, 0ms},
+    };
+
+    SECTION("Modified after the compilation started") {
+        // The compiler may have read either version of the file
+        info.compile_start_time = bpt::fs::last_write_time(input) - 10s;
+    }
+    SECTION("Modified after its mtime was cached") {
+        info.compile_start_time = stats.last_write_time(input) + 10s;
+        bpt::write_file(input, "int a = 2;");
+        bpt::fs::last_write_time(input, stats.last_write_time(input) + 1s);
+    }
+
+    bpt::update_deps_info(neo::into(db), info, stats, true);
+    auto inputs = db.inputs_of(info.output);
+    REQUIRE(inputs);
+    REQUIRE(inputs->size() == 1);
+    CHECK_FALSE(inputs->front().prev_digest);
+
+    // A later build must consider the input to be modified
+    bpt::stat_cache           later_stats;
+    bpt::recorded_compilation rec{*db.command_of(info.output), *inputs};
+    auto                      prior = bpt::check_prior_compilation(rec, later_stats, true);
+    CHECK(prior.newer_inputs == path_vec(input));
+}
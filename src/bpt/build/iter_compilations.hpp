@@ -24,6 +24,12 @@ inline auto iter_libraries(const build_plan& plan) {
  * Return a range iterating over ever file compilation defined in the given build plan
  */
 inline auto iter_compilations(const build_plan& plan) {
+    auto pch_compiles =                                                 //
+        iter_libraries(plan)                                            //
+        | ranges::views::transform(&library_plan::precompiled_header)   //
+        | ranges::views::filter([&](auto&& opt) { return bool(opt); })  //
+        | ranges::views::transform([&](auto&& opt) -> auto& { return *opt; });
+
     auto lib_compiles =                                                 //
         iter_libraries(plan)                                            //
         | ranges::views::transform(&library_plan::archive_plan)         //
@@ -46,7 +52,7 @@ inline auto iter_compilations(const build_plan& plan) {
         | ranges::views::transform(&link_executable_plan::main_compile_file)  //
         ;
 
-    return ranges::views::concat(lib_compiles, header_compiles, exe_compiles);
+    return ranges::views::concat(pch_compiles, lib_compiles, header_compiles, exe_compiles);
 }
 
 }  // namespace bpt
\ No newline at end of file
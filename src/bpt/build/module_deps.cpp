@@ -0,0 +1,43 @@
+#include "./module_deps.hpp"
+
+#include <bpt/error/errors.hpp>
+#include <bpt/util/fs/io.hpp>
+
+#include <nlohmann/json.hpp>
+
+using namespace bpt;
+using json = nlohmann::json;
+
+module_deps_info bpt::parse_p1689_str(std::string_view str, path_ref source_path) {
+    auto data = json::parse(str, nullptr, false);
+    if (data.is_discarded() || !data.is_object() || !data["rules"].is_array()) {
+        throw_user_error<errc::compile_failure>(
+            "The module dependency scan of [{}] did not generate a valid P1689 result",
+            source_path.string());
+    }
+
+    module_deps_info ret;
+    // The scan of a single translation unit generates a single rule
+    for (auto& rule : data["rules"]) {
+        for (auto& prov : rule.value("provides", json::array())) {
+            ret.provides     = prov.at("logical-name").get<std::string>();
+            ret.is_interface = prov.value("is-interface", true);
+        }
+        for (auto& req : rule.value("requires", json::array())) {
+            auto name = req.at("logical-name").get<std::string>();
+            if (req.contains("lookup-method")) {
+                // Only header units are looked up by #include semantics
+                throw_user_error<errc::compile_failure>(
+                    "[{}] imports the header unit {}, but header units are not supported",
+                    source_path.string(),
+                    name);
+            }
+            ret.imports.push_back(std::move(name));
+        }
+    }
+    return ret;
+}
+
+module_deps_info bpt::parse_p1689_file(path_ref where, path_ref source_path) {
+    return parse_p1689_str(bpt::read_file(where), source_path);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <bpt/util/fs/path.hpp>
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bpt {
+
+/**
+ * The C++ module dependencies of a single translation unit, as discovered by a dependency scan.
+ */
+struct module_deps_info {
+    /// The name of the module (or module partition) that the translation unit provides, if any
+    std::optional<std::string> provides;
+    /// Whether the provided module is an interface that can be imported by others
+    bool is_interface = false;
+    /// The names of the modules that the translation unit imports
+    std::vector<std::string> imports;
+};
+
+/**
+ * Parse a P1689 dependency scan result, as generated by the compiler's scanning mode.
+ * @param str The JSON content of the scan result
+ * @param source_path The source file that was scanned. Used in error messages.
+ *
+ * @note Header units are not supported, and their use will generate an error.
+ */
+module_deps_info parse_p1689_str(std::string_view str, path_ref source_path);
+
+/**
+ * Parse the P1689 dependency scan result stored in the given file.
+ * @see `parse_p1689_str`
+ */
+module_deps_info parse_p1689_file(path_ref where, path_ref source_path);
+
+}  // namespace bpt
@@ -0,0 +1,43 @@
+#include <bpt/build/module_deps.hpp>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("Parse P1689 module deps") {
+    auto deps = bpt::parse_p1689_str(R"({
+        "version": 1,
+        "revision": 0,
+        "rules": [{
+            "primary-output": "foo.o",
+            "provides": [{"logical-name": "foo:part", "is-interface": true}],
+            "requires": [{"logical-name": "bar"}, {"logical-name": "std"}]
+        }]
+    })",
+                                     "foo.cppm");
+    CHECK(deps.provides == "foo:part");
+    CHECK(deps.is_interface);
+    CHECK(deps.imports == std::vector<std::string>{"bar", "std"});
+
+    // A file that does not use modules
+    deps = bpt::parse_p1689_str(R"({"version": 1, "rules": [{"primary-output": "baz.o"}]})",
+                                "baz.cpp");
+    CHECK_FALSE(deps.provides);
+    CHECK(deps.imports.empty());
+
+    // A module implementation unit
+    deps = bpt::parse_p1689_str(R"({"version": 1, "rules": [{
+        "provides": [{"logical-name": "foo", "is-interface": false}],
+        "requires": [{"logical-name": "foo"}]
+    }]})",
+                                "foo.cpp");
+    CHECK(deps.provides == "foo");
+    CHECK_FALSE(deps.is_interface);
+}
+
+TEST_CASE("Reject invalid P1689 module deps") {
+    CHECK_THROWS(bpt::parse_p1689_str("not json", "foo.cpp"));
+    // Header units are not supported
+    CHECK_THROWS(bpt::parse_p1689_str(R"({"version": 1, "rules": [{
+        "requires": [{"logical-name": "<vector>", "lookup-method": "include-angle"}]
+    }]})",
+                                      "foo.cpp"));
+}
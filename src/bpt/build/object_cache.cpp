@@ -0,0 +1,296 @@
+#include "./object_cache.hpp"
+
+#include <bpt/util/flock.hpp>
+#include <bpt/util/fs/io.hpp>
+#include <bpt/util/log.hpp>
+#include <bpt/util/paths.hpp>
+#include <bpt/util/siphash.hpp>
+
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <random>
+
+using namespace bpt;
+using json = nlohmann::json;
+
+namespace {
+
+/// The maximum number of results recorded in a single manifest
+constexpr std::size_t max_manifest_entries = 8;
+
+std::uint64_t hash_string(std::string_view s) noexcept {
+    return bpt::siphash64(42, 1729, neo::const_buffer(s)).digest();
+}
+
+std::uint64_t manifest_key(std::string_view quoted_command, std::uint64_t toolchain_hash) {
+    return hash_string(fmt::format("{}\n{}", toolchain_hash, quoted_command));
+}
+
+fs::path key_path(path_ref dir, std::uint64_t key, std::string_view ext) {
+    auto hex = fmt::format("{:016x}", key);
+    return dir / hex.substr(0, 2) / (hex + std::string(ext));
+}
+
+/// Generate a unique temporary path next to the given path
+fs::path tmp_path_for(path_ref dest) {
+    auto tmp = dest;
+    tmp += fmt::format(".tmp-{:x}", std::random_device{}());
+    return tmp;
+}
+
+/**
+ * Write a file such that concurrent readers (including other bpt processes) never observe a
+ * partially written file.
+ */
+void write_file_atomic(path_ref dest, std::string_view content) {
+    fs::create_directories(dest.parent_path());
+    auto tmp = tmp_path_for(dest);
+    bpt::write_file(tmp, content);
+    fs::rename(tmp, dest);
+}
+
+json read_manifest(path_ref path) {
+    std::error_code ec;
+    if (!fs::exists(path, ec)) {
+        return json::object({{"entries", json::array()}});
+    }
+    auto data = json::parse(bpt::read_file(path), nullptr, false);
+    if (data.is_discarded() || !data.is_object() || !data["entries"].is_array()) {
+        bpt_log(debug, "Ignoring invalid object cache manifest [{}]", path.string());
+        return json::object({{"entries", json::array()}});
+    }
+    return data;
+}
+
+}  // namespace
+
+object_cache::object_cache(fs::path root, std::uint64_t max_size, std::vector<fs::path> base_dirs)
+    : _root(std::move(root))
+    , _max_size(max_size) {
+    fs::create_directories(_root);
+    for (auto i = 0u; i < base_dirs.size(); ++i) {
+        _base_dirs.emplace_back(base_dirs[i].string(), fmt::format("<base-{}>", i));
+    }
+    // A base directory may be within another (e.g. the build directory within the project), so
+    // the longest must be replaced first
+    std::ranges::stable_sort(_base_dirs, std::ranges::greater{}, [](auto& pair) {
+        return pair.first.size();
+    });
+}
+
+std::string object_cache::_normalize(std::string_view str) const {
+    std::string ret;
+    while (!str.empty()) {
+        auto found = std::ranges::find_if(_base_dirs, [&](auto& pair) {
+            auto& [dir, _] = pair;
+            if (!str.starts_with(dir)) {
+                return false;
+            }
+            // Only match whole path elements
+            auto rest = str.substr(dir.size());
+            return rest.empty() || rest[0] == '/' || rest[0] == '\\' || rest[0] == '"'
+                || rest[0] == '\'' || rest[0] == ' ';
+        });
+        if (found != _base_dirs.end()) {
+            ret += found->second;
+            str.remove_prefix(found->first.size());
+        } else {
+            ret.push_back(str.front());
+            str.remove_prefix(1);
+        }
+    }
+    return ret;
+}
+
+fs::path object_cache::_expand(std::string_view path) const {
+    for (auto& [dir, placeholder] : _base_dirs) {
+        if (path.starts_with(placeholder)) {
+            return fs::path(dir + std::string(path.substr(placeholder.size())));
+        }
+    }
+    return fs::path(path);
+}
+
+fs::path object_cache::default_path() noexcept { return bpt::bpt_cache_dir() / "objects"; }
+
+fs::path object_cache::_manifest_path(std::uint64_t key) const noexcept {
+    return key_path(_root / "manifests", key, ".json");
+}
+
+fs::path object_cache::_result_path(std::uint64_t key) const noexcept {
+    return key_path(_root / "results", key, ".o");
+}
+
+std::optional<object_cache::cached_result>
+object_cache::restore(std::string_view quoted_command,
+                      std::uint64_t    toolchain_hash,
+                      path_ref         object_path,
+                      stat_cache&      stats) {
+    const auto mkey     = manifest_key(_normalize(quoted_command), toolchain_hash);
+    auto       manifest = read_manifest(_manifest_path(mkey));
+    for (auto& entry : manifest["entries"]) {
+        // Check whether every input of this entry matches its current content
+        cached_result ret;
+        bool          all_match = true;
+        for (auto& input : entry["inputs"]) {
+            auto path   = _expand(input["path"].get<std::string>());
+            auto digest = input["digest"].get<std::uint64_t>();
+            if (stats.digest(path) != digest) {
+                all_match = false;
+                break;
+            }
+            ret.inputs.push_back(std::move(path));
+        }
+        if (!all_match) {
+            continue;
+        }
+
+        auto            result_path = _result_path(entry["result"].get<std::uint64_t>());
+        auto            output_path = fs::path(result_path).replace_extension(".json");
+        std::error_code ec;
+        if (!fs::exists(result_path, ec) || !fs::exists(output_path, ec)) {
+            // The result has been evicted
+            continue;
+        }
+        // The object is copied through a temporary file, so that an interrupted restore never
+        // leaves a truncated object behind. Another bpt process sharing the cache may evict the
+        // result at any point in the meantime, which is only a miss.
+        auto tmp = tmp_path_for(object_path);
+        try {
+            auto output         = json::parse(bpt::read_file(output_path));
+            ret.compiler_output = output["compiler_output"].get<std::string>();
+            fs::create_directories(object_path.parent_path());
+            fs::copy_file(result_path, tmp, fs::copy_options::overwrite_existing);
+            fs::rename(tmp, object_path);
+        } catch (const std::exception& e) {
+            bpt_log(debug,
+                    "Failed to restore the object cache result [{}]: {}",
+                    result_path.string(),
+                    e.what());
+            fs::remove(tmp, ec);
+            continue;
+        }
+        // Mark the result as recently used
+        fs::last_write_time(result_path, fs::file_time_type::clock::now(), ec);
+        ++_n_hits;
+        return ret;
+    }
+    ++_n_misses;
+    return std::nullopt;
+}
+
+void object_cache::store(std::string_view             quoted_command,
+                         std::uint64_t                toolchain_hash,
+                         path_ref                     object_path,
+                         const std::vector<fs::path>& inputs,
+                         std::string_view             compiler_output,
+                         stat_cache&                  stats) {
+    const auto mkey = manifest_key(_normalize(quoted_command), toolchain_hash);
+
+    // The result is identified by the manifest and the content of every input
+    auto inputs_json = json::array();
+    auto result_id   = fmt::format("{:016x}", mkey);
+    for (auto& input : inputs) {
+        auto digest = stats.digest(input);
+        if (!digest) {
+            // An input has disappeared. Don't try to cache this.
+            return;
+        }
+        auto path = _normalize(input.string());
+        result_id += fmt::format("\n{}\n{:016x}", path, *digest);
+        inputs_json.push_back(json::object({
+            {"path", std::move(path)},
+            {"digest", *digest},
+        }));
+    }
+    const auto rkey = hash_string(result_id);
+
+    auto result_path = _result_path(rkey);
+    auto output_path = fs::path(result_path).replace_extension(".json");
+    fs::create_directories(result_path.parent_path());
+    auto tmp = tmp_path_for(result_path);
+    fs::copy_file(object_path, tmp, fs::copy_options::overwrite_existing);
+    fs::rename(tmp, result_path);
+    write_file_atomic(output_path,
+                      json::object({{"compiler_output", std::string(compiler_output)}}).dump());
+
+    // Record the new result at the front of the manifest. Other bpt processes may be updating the
+    // same manifest, so the file lock is held over the whole read-modify-write, or their entries
+    // could be lost. (The file lock does not exclude other threads of this process.)
+    std::unique_lock  lk{_manifest_mut};
+    shared_file_mutex file_mut{_root / "manifests.lock"};
+    std::unique_lock  file_lk{file_mut};
+    auto              manifest_path = _manifest_path(mkey);
+    auto              manifest      = read_manifest(manifest_path);
+    auto&             entries       = manifest["entries"];
+    auto              new_entries   = json::array({json::object({
+        {"result", rkey},
+        {"inputs", std::move(inputs_json)},
+    })});
+    for (auto& entry : entries) {
+        if (new_entries.size() >= max_manifest_entries) {
+            break;
+        }
+        if (entry["result"] != rkey) {
+            new_entries.push_back(std::move(entry));
+        }
+    }
+    entries = std::move(new_entries);
+    write_file_atomic(manifest_path, manifest.dump());
+    ++_n_stored;
+}
+
+void object_cache::trim() {
+    struct cached_file {
+        fs::path           path;
+        std::uint64_t      size;
+        fs::file_time_type mtime;
+    };
+    std::vector<cached_file> files;
+    std::uint64_t            total_size = 0;
+
+    std::error_code ec;
+    for (auto& entry : fs::recursive_directory_iterator{_root / "results", ec}) {
+        if (!entry.is_regular_file(ec) || entry.path().extension() != ".o") {
+            continue;
+        }
+        auto size = entry.file_size(ec);
+        files.push_back(cached_file{entry.path(), size, entry.last_write_time(ec)});
+        total_size += size;
+    }
+    if (total_size <= _max_size) {
+        return;
+    }
+
+    // Remove the oldest results until we are comfortably below the limit, so that we do not need
+    // to trim again on the very next build.
+    std::sort(files.begin(), files.end(), [](auto& lhs, auto& rhs) {
+        return lhs.mtime < rhs.mtime;
+    });
+    const auto target = _max_size - (_max_size / 10);
+    for (auto& file : files) {
+        if (total_size <= target) {
+            break;
+        }
+        fs::remove(file.path, ec);
+        fs::remove(fs::path(file.path).replace_extension(".json"), ec);
+        total_size -= file.size;
+        ++_n_evicted;
+    }
+    bpt_log(debug,
+            "Trimmed the object cache to {:L} bytes ({} results evicted)",
+            total_size,
+            _n_evicted.load());
+}
+
+object_cache::statistics object_cache::get_statistics() const noexcept {
+    return statistics{
+        .n_hits    = _n_hits.load(),
+        .n_misses  = _n_misses.load(),
+        .n_stored  = _n_stored.load(),
+        .n_evicted = _n_evicted.load(),
+    };
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <bpt/util/fs/path.hpp>
+#include <bpt/util/fs/stat_cache.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace bpt {
+
+/**
+ * A local content-addressed cache of compiled object files, shared between builds.
+ *
+ * A compilation is identified by its command and the toolchain that runs it. For each such
+ * compilation, the cache stores a "manifest": A list of the results that have been produced by that
+ * command, each with the set of input files (as reported by the compiler's dependency output) and
+ * the digests of their contents at the time of compilation. If the current content of every input
+ * of an entry matches, then the cached object file and compiler output for that entry can be used
+ * in place of running the compiler.
+ *
+ * The cache is bounded in size. Using a cached result marks it as recently used, and `trim()` will
+ * remove the least-recently-used results to bring the cache below its size limit.
+ *
+ * The cache may be given "base directories", such as the project and build output directories.
+ * Within commands and input paths, these are replaced by placeholders before they are used as keys,
+ * so that copies of a project at different locations can share results. (An object file restored
+ * this way may still name the location where it was first compiled, e.g. in its debug info.)
+ *
+ * Manifests are updated under a file lock, so several bpt processes may share one cache.
+ */
+class object_cache {
+public:
+    /**
+     * A compilation result that was restored from the cache
+     */
+    struct cached_result {
+        /// The output of the compiler when the object was originally compiled
+        std::string compiler_output;
+        /// The inputs of the compilation
+        std::vector<fs::path> inputs;
+    };
+
+    /**
+     * Counters of the effectiveness of the cache
+     */
+    struct statistics {
+        std::uint64_t n_hits    = 0;
+        std::uint64_t n_misses  = 0;
+        std::uint64_t n_stored  = 0;
+        std::uint64_t n_evicted = 0;
+    };
+
+private:
+    fs::path      _root;
+    std::uint64_t _max_size;
+    /// The base directories, longest first, each with the placeholder that replaces it in keys
+    std::vector<std::pair<std::string, std::string>> _base_dirs;
+
+    /// Guards modifications to manifests
+    std::mutex _manifest_mut;
+
+    std::atomic<std::uint64_t> _n_hits{0};
+    std::atomic<std::uint64_t> _n_misses{0};
+    std::atomic<std::uint64_t> _n_stored{0};
+    std::atomic<std::uint64_t> _n_evicted{0};
+
+    fs::path _manifest_path(std::uint64_t key) const noexcept;
+    fs::path _result_path(std::uint64_t key) const noexcept;
+
+    /// Replace the base directories within the given string with their placeholders
+    std::string _normalize(std::string_view str) const;
+    /// Replace a placeholder at the start of the given normalized path with its base directory
+    fs::path _expand(std::string_view path) const;
+
+public:
+    /**
+     * Open an object cache in the given directory. The directory will be created if it does not
+     * exist.
+     * @param root The directory of the cache
+     * @param max_size The number of bytes of object files that `trim()` will keep
+     * @param base_dirs Directories whose locations are not part of the cache keys
+     */
+    object_cache(fs::path root, std::uint64_t max_size, std::vector<fs::path> base_dirs = {});
+
+    /**
+     * The default location of the object cache, within the user's bpt cache directory
+     */
+    static fs::path default_path() noexcept;
+
+    /**
+     * Attempt to restore the result of the given compilation from the cache. On a hit, the cached
+     * object file is copied to `object_path`.
+     */
+    std::optional<cached_result> restore(std::string_view quoted_command,
+                                         std::uint64_t    toolchain_hash,
+                                         path_ref         object_path,
+                                         stat_cache&      stats);
+
+    /**
+     * Store the result of a successful compilation in the cache.
+     */
+    void store(std::string_view             quoted_command,
+               std::uint64_t                toolchain_hash,
+               path_ref                     object_path,
+               const std::vector<fs::path>& inputs,
+               std::string_view             compiler_output,
+               stat_cache&                  stats);
+
+    /**
+     * Remove the least-recently-used results from the cache until it is within its size limit.
+     */
+    void trim();
+
+    /**
+     * Obtain a snapshot of the cache's counters
+     */
+    statistics get_statistics() const noexcept;
+};
+
+}  // namespace bpt
@@ -0,0 +1,105 @@
+#include "./object_cache.hpp"
+
+#include <bpt/temp.hpp>
+#include <bpt/util/fs/io.hpp>
+
+#include <catch2/catch.hpp>
+#include <fmt/core.h>
+
+TEST_CASE("Store and restore objects") {
+    auto tdir = bpt::temporary_dir::create();
+    auto root = tdir.path();
+    bpt::write_file(root / "input.cpp", "int main() {}");
+    bpt::write_file(root / "input.o", "<object>");
+
+    bpt::object_cache cache{root / "cache", 1024 * 1024};
+    {
+        bpt::stat_cache stats;
+        CHECK_FALSE(cache.restore("compile input.cpp", 42, root / "restored.o", stats));
+        cache.store("compile input.cpp",
+                    42,
+                    root / "input.o",
+                    {root / "input.cpp"},
+                    "A warning",
+                    stats);
+        auto restored = cache.restore("compile input.cpp", 42, root / "restored.o", stats);
+        REQUIRE(restored);
+        CHECK(restored->compiler_output == "A warning");
+        CHECK(restored->inputs == std::vector<bpt::fs::path>{root / "input.cpp"});
+        CHECK(bpt::read_file(root / "restored.o") == "<object>");
+        // A different command or toolchain is a different compilation
+        CHECK_FALSE(cache.restore("compile input.cpp -O2", 42, root / "restored.o", stats));
+        CHECK_FALSE(cache.restore("compile input.cpp", 43, root / "restored.o", stats));
+    }
+    {
+        // The content of the input has changed
+        bpt::write_file(root / "input.cpp", "int main() { return 1; }");
+        bpt::stat_cache stats;
+        CHECK_FALSE(cache.restore("compile input.cpp", 42, root / "restored.o", stats));
+    }
+
+    auto stats = cache.get_statistics();
+    CHECK(stats.n_hits == 1);
+    CHECK(stats.n_misses == 4);
+    CHECK(stats.n_stored == 1);
+}
+
+TEST_CASE("Share objects between copies of a project") {
+    auto tdir = bpt::temporary_dir::create();
+    auto root = tdir.path();
+    for (auto copy : {"a", "b"}) {
+        bpt::fs::create_directories(root / copy / "_build");
+        bpt::write_file(root / copy / "input.cpp", "int main() {}");
+        bpt::write_file(root / copy / "_build/input.o", "<object>");
+    }
+    auto command = [&](std::string copy) {
+        return fmt::format("compile {0}/input.cpp -o {0}/_build/input.o", (root / copy).string());
+    };
+    auto open_cache = [&](std::string copy) {
+        return bpt::object_cache{root / "cache",
+                                 1024 * 1024,
+                                 {root / copy, root / copy / "_build"}};
+    };
+    {
+        auto            cache = open_cache("a");
+        bpt::stat_cache stats;
+        cache.store(command("a"),
+                    42,
+                    root / "a/_build/input.o",
+                    {root / "a/input.cpp"},
+                    "",
+                    stats);
+    }
+    auto            cache = open_cache("b");
+    bpt::stat_cache stats;
+    auto restored = cache.restore(command("b"), 42, root / "b/_build/restored.o", stats);
+    REQUIRE(restored);
+    // The inputs are reported within the copy that is being built
+    CHECK(restored->inputs == std::vector<bpt::fs::path>{root / "b/input.cpp"});
+    CHECK(bpt::read_file(root / "b/_build/restored.o") == "<object>");
+
+    // A directory that merely begins with the same name is not a base directory
+    bpt::fs::create_directories(root / "bb");
+    bpt::write_file(root / "bb/input.cpp", "int main() {}");
+    CHECK_FALSE(cache.restore(command("bb"), 42, root / "b/_build/restored.o", stats));
+}
+
+TEST_CASE("A result that cannot be read is a miss") {
+    auto tdir = bpt::temporary_dir::create();
+    auto root = tdir.path();
+    bpt::write_file(root / "input.cpp", "int main() {}");
+    bpt::write_file(root / "input.o", "<object>");
+
+    bpt::object_cache cache{root / "cache", 1024 * 1024};
+    bpt::stat_cache   stats;
+    cache.store("compile input.cpp", 42, root / "input.o", {root / "input.cpp"}, "", stats);
+    // As if another process had evicted the result while it was being read
+    for (auto& entry : bpt::fs::recursive_directory_iterator{root / "cache/results"}) {
+        if (entry.path().extension() == ".json") {
+            bpt::write_file(entry.path(), "{ truncated");
+        }
+    }
+    CHECK_FALSE(cache.restore("compile input.cpp", 42, root / "restored.o", stats));
+    CHECK_FALSE(bpt::fs::exists(root / "restored.o"));
+    CHECK(cache.get_statistics().n_misses == 1);
+}
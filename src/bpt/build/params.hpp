@@ -1,9 +1,11 @@
 #pragma once
 
+#include <bpt/build/test_schedule.hpp>
 #include <bpt/sdist/dist.hpp>
 #include <bpt/toolchain/toolchain.hpp>
 #include <bpt/util/fs/path.hpp>
 
+#include <cstdint>
 #include <optional>
 
 namespace bpt {
@@ -16,6 +18,19 @@ struct build_params {
     bpt::toolchain          toolchain;
     bool                    generate_compdb = true;
     int                     parallel_jobs   = 0;
+    bool                    content_hash    = false;
+    /// If set, use an object cache in the given directory
+    std::optional<fs::path> object_cache_dir{};
+    /// The maximum size of the object cache, in bytes
+    std::uint64_t object_cache_max_size = 0;
+    /// The memory that concurrently running compilations may use, in bytes. Zero for no limit.
+    std::uint64_t memory_budget = 0;
+    /// Whether to combine the sources of each library into unity compilations
+    bool unity_build = false;
+    /// Whether to run tests that passed with the same executable and environment in a prior build
+    bool rerun_tests = false;
+    /// If set, only run the tests that belong to this shard
+    std::optional<bpt::test_shard> test_shard{};
 };
 
 }  // namespace bpt
@@ -1,30 +1,54 @@
 #include "./archive.hpp"
 
+#include <bpt/build/file_deps.hpp>
 #include <bpt/error/doc_ref.hpp>
 #include <bpt/error/errors.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/proc.hpp>
 #include <bpt/util/time.hpp>
+#include <bpt/util/trace.hpp>
 
 #include <boost/leaf/exception.hpp>
 #include <fansi/styled.hpp>
 #include <range/v3/range/conversion.hpp>
 #include <range/v3/view/transform.hpp>
 
+#include <algorithm>
+#include <set>
+
 using namespace bpt;
 using namespace fansi::literals;
 
+namespace {
+
+/// Whether each of the given files has a distinct filename. Archive tools generally identify the
+/// members of an archive by filename alone, so they cannot replace members that share a filename.
+bool filenames_are_unique(const std::vector<fs::path>& files) {
+    std::set<fs::path> filenames;
+    return std::ranges::all_of(files,
+                               [&](path_ref f) { return filenames.insert(f.filename()).second; });
+}
+
+}  // namespace
+
 fs::path create_archive_plan::calc_archive_file_path(const toolchain& tc) const noexcept {
     return _subdir / fmt::format("{}{}{}", "lib", _name, tc.archive_suffix());
 }
 
 void create_archive_plan::archive(const build_env& env) const {
     // Convert the file compilation plans into the paths to their respective object files.
-    const auto objects =  //
-        _compile_files    //
+    auto objects =      //
+        _compile_files  //
         | ranges::views::transform([&](auto&& cf) { return cf.calc_object_file_path(env); })
         | ranges::to_vector  //
         ;
+    if (_pch_compile && env.toolchain.supports_precompiled_headers()) {
+        auto pch_obj = env.toolchain.precompiled_header_object(
+            _pch_compile->calc_object_file_path(env));
+        if (pch_obj) {
+            objects.push_back(std::move(*pch_obj));
+        }
+    }
     // Build up the archive command
     archive_spec ar;
 
@@ -37,21 +61,66 @@ void create_archive_plan::archive(const build_env& env) const {
     // in the logs
     auto out_relpath = fs::relative(ar.out_path, env.output_root).string();
 
-    // Different archiving tools behave differently between platforms depending on whether the
-    // archive file exists. Make it uniform by simply removing the prior copy.
-    if (fs::exists(ar.out_path)) {
-        bpt_log(debug, "Remove prior archive file [{}]", ar.out_path.string());
-        fs::remove(ar.out_path);
+    // Skip the archive if neither its objects nor the command have changed. If only some objects
+    // have changed, the toolchain may be able to replace just those within the existing archive.
+    const auto            quoted_cmd = quote_command(ar_cmd);
+    std::vector<fs::path> changed_objects;
+    {
+        auto lk       = env.db.lock();
+        auto outdated = check_output_outdated(env.db,
+                                              ar.out_path,
+                                              quoted_cmd,
+                                              env.toolchain.hash(),
+                                              env.stats,
+                                              env.content_hash);
+        if (!outdated) {
+            bpt_log(debug, "Skip archive of {} (Result is up-to-date)", out_relpath);
+            return;
+        }
+        bpt_log(trace, "Archive {}: {}", out_relpath, outdated->reason);
+        if (env.toolchain.supports_archive_update() && filenames_are_unique(ar.input_files)) {
+            changed_objects = std::move(outdated->changed_inputs);
+        }
+    }
+
+    auto run_cmd = ar_cmd;
+    if (changed_objects.empty()) {
+        // Different archiving tools behave differently between platforms depending on whether the
+        // archive file exists. Make it uniform by simply removing the prior copy.
+        if (fs::exists(ar.out_path)) {
+            bpt_log(debug, "Remove prior archive file [{}]", ar.out_path.string());
+            fs::remove(ar.out_path);
+        }
+        bpt_log(info, "[{}] Archive: {}", _qual_name, out_relpath);
+    } else {
+        run_cmd = env.toolchain.create_archive_update_command(archive_spec{changed_objects,
+                                                                           ar.out_path},
+                                                              ar_cwd,
+                                                              env.knobs);
+        bpt_log(info,
+                "[{}] Archive: {} (Update {} of {} objects)",
+                _qual_name,
+                out_relpath,
+                changed_objects.size(),
+                ar.input_files.size());
     }
 
     // Ensure the parent directory exists
     fs::create_directories(ar.out_path.parent_path());
 
     // Do it!
-    bpt_log(info, "[{}] Archive: {}", _qual_name, out_relpath);
+    trace::slice trace_slice{"archive",
+                             [&] { return fmt::format("[{}] {}", _qual_name, out_relpath); },
+                             [&] { return quote_command(run_cmd); }};
+    auto         start_time = fs::file_time_type::clock::now();
     auto&& [dur_ms, ar_res] = timed<std::chrono::milliseconds>(
-        [&] { return run_proc(proc_options{.command = ar_cmd, .cwd = ar_cwd}); });
+        [&] { return run_proc(proc_options{.command = run_cmd, .cwd = ar_cwd}); });
     bpt_log(info, "[{}] Archive: {} - {:L}ms", _qual_name, out_relpath, dur_ms.count());
+    bpt_log(debug,
+            "[{}] Archive: {} - {}",
+            _qual_name,
+            out_relpath,
+            describe_resource_usage(ar_res.usage));
 
     // Check, log, and throw
     if (!ar_res.okay()) {
@@ -61,7 +130,7 @@ void create_archive_plan::archive(const build_env& env) const {
                 _qual_name);
         bpt_log(error,
                 "Subcommand FAILED: .bold.yellow[{}]\n{}"_styled,
-                quote_command(ar_cmd),
+                quote_command(run_cmd),
                 ar_res.output);
         BOOST_LEAF_THROW_EXCEPTION(make_external_error<errc::archive_failure>(
                                        "Creating static library archive [{}] failed for '{}'",
@@ -69,4 +138,21 @@ void create_archive_plan::archive(const build_env& env) const {
                                        _qual_name),
                                    BPT_ERR_REF("archive-failure"));
     }
+
+    // Record the archive so that it can be skipped in the next build. The full archive command is
+    // recorded even for an update, as that is what the next build will compare against.
+    env.stats.forget(ar.out_path);
+    file_deps_info info{
+        .output             = ar.out_path,
+        .inputs             = std::move(ar.input_files),
+        .command            = {quoted_cmd,
+                               std::move(ar_res.output),
+                               env.toolchain.hash(),
+                               dur_ms,
+                               ar_res.usage},
+        .compile_start_time = start_time,
+    };
+    auto lk = env.db.lock();
+    update_deps_info(neo::into(env.db), info, env.stats, env.content_hash);
+    env.db.flush();
 }
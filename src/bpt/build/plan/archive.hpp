@@ -3,6 +3,7 @@
 #include <bpt/build/plan/compile_file.hpp>
 #include <bpt/util/fs/path.hpp>
 
+#include <optional>
 #include <string>
 #include <string_view>
 
@@ -24,6 +25,8 @@ class create_archive_plan {
     fs::path _subdir;
     /// The plans for compiling the constituent source files of this library
     std::vector<compile_file_plan> _compile_files;
+    /// The plan for creating the library's precompiled header, if it has one
+    std::optional<compile_file_plan> _pch_compile;
 
 public:
     /**
@@ -33,15 +36,19 @@ public:
      *      will be placed
      * @param cfs The file compilation plans that will be collected together to
      *      form the static library.
+     * @param pch The plan that creates the library's precompiled header, if any. Some toolchains
+     *      generate an object file along with the precompiled header that must be archived.
      */
-    create_archive_plan(std::string_view               name,
-                        std::string_view               qual_name,
-                        path_ref                       subdir,
-                        std::vector<compile_file_plan> cfs)
+    create_archive_plan(std::string_view                 name,
+                        std::string_view                 qual_name,
+                        path_ref                         subdir,
+                        std::vector<compile_file_plan>   cfs,
+                        std::optional<compile_file_plan> pch = std::nullopt)
         : _name(name)
         , _qual_name(qual_name)
         , _subdir(subdir)
-        , _compile_files(std::move(cfs)) {}
+        , _compile_files(std::move(cfs))
+        , _pch_compile(std::move(pch)) {}
 
     /**
      * Get the name of the archive library.
@@ -1,21 +1,47 @@
 #pragma once
 
+#include <bpt/build/object_cache.hpp>
+#include <bpt/build/test_schedule.hpp>
 #include <bpt/db/database.hpp>
 #include <bpt/toolchain/toolchain.hpp>
 #include <bpt/usage_reqs.hpp>
+#include <bpt/util/fs/stat_cache.hpp>
 
+#include <cstdint>
 #include <filesystem>
 
 namespace bpt {
 
+class module_graph;
+
 struct build_env {
     bpt::toolchain        toolchain;
     std::filesystem::path output_root;
     database&             db;
+    /// Cached filesystem metadata, shared by the whole build
+    stat_cache& stats;
 
     toolchain_knobs knobs;
 
     const usage_requirements& ureqs;
+
+    /// If `true`, inputs with a new mtime are only considered modified if their content changed
+    bool content_hash = false;
+
+    /// If non-null, the cache from which to restore (and in which to store) object files
+    object_cache* obj_cache = nullptr;
+
+    /// The memory that concurrently running compilations may use, in bytes. Zero for no limit.
+    std::uint64_t memory_budget = 0;
+
+    /// If `true`, run every test, even those that passed with the same executable and environment
+    bool rerun_tests = false;
+
+    /// If set, only run the tests that belong to this shard
+    std::optional<bpt::test_shard> test_shard = std::nullopt;
+
+    /// If non-null, the C++ module dependencies of the compilations in the build
+    const module_graph* modules = nullptr;
 };
 
 using build_env_ref = const build_env&;
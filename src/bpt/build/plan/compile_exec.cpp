@@ -1,7 +1,9 @@
 #include "./compile_exec.hpp"
 
 #include <bpt/build/file_deps.hpp>
+#include <bpt/build/plan/modules.hpp>
 #include <bpt/error/errors.hpp>
+#include <bpt/util/fs/io.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/parallel.hpp>
 #include <bpt/util/proc.hpp>
@@ -9,17 +11,24 @@
 #include <bpt/util/signal.hpp>
 #include <bpt/util/string.hpp>
 #include <bpt/util/time.hpp>
+#include <bpt/util/trace.hpp>
 
 #include <fansi/styled.hpp>
 #include <neo/assert.hpp>
-#include <range/v3/algorithm/count_if.hpp>
+#include <neo/event.hpp>
 #include <range/v3/range/conversion.hpp>
 #include <range/v3/view/transform.hpp>
 
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <thread>
+#include <variant>
 
 using namespace bpt;
 using namespace ranges;
@@ -27,34 +36,113 @@ using namespace fansi::literals;
 
 namespace {
 
+/// The number of finished compilations that will be written to the database in one transaction
+constexpr std::size_t write_batch_size = 32;
+/// The longest that a finished compilation will wait before being written to the database
+constexpr auto write_interval = std::chrono::milliseconds{500};
+
 /// Simple aggregate that stores a counter for keeping track of compile progress
 struct compile_counter {
     std::atomic_size_t n{1};
-    const std::size_t  max;
-    const std::size_t  max_digits;
+    // The number of files known to need compilation. This grows as tickets are evaluated.
+    std::atomic_size_t max{0};
 };
 
 struct compile_ticket {
     std::reference_wrapper<const compile_file_plan> plan;
     // If non-null, the information required to compile the file
-    compile_command_info command;
-    fs::path             object_file_path;
-    bool                 needs_recompile;
+    compile_command_info command          = {};
+    fs::path             object_file_path = {};
+    bool                 needs_recompile  = false;
     // Information about the previous time a file was compiled, if any
-    std::optional<completed_compilation> prior_command;
+    std::optional<completed_compilation> prior_command = {};
     // Whether this compilation is for the purpose of header independence
     bool is_syntax_only = false;
+    // Whether this compilation creates a precompiled header
+    bool creates_pch = false;
+    // Whether this compilation scans for C++ module dependencies
+    bool scans_modules = false;
+    // The C++ module dependencies of this compilation, if it uses modules
+    const module_graph::unit* module_unit = nullptr;
+    // Set if the compilation cannot be performed by the toolchain, and will be skipped
+    bool unsupported = false;
+    // The compilation recorded in the database, pending evaluation of its inputs
+    std::optional<recorded_compilation> recorded = {};
+    // Inputs that were touched without changing their content, to be updated in the database
+    std::vector<input_file_info> refreshed_inputs = {};
+};
+
+/**
+ * Attempt to obtain the result of a compilation from the object cache rather than running the
+ * compiler. Returns the dependency information for the compilation on a cache hit.
+ */
+std::optional<file_deps_info> try_restore_cached(const compile_ticket& compile,
+                                                 build_env_ref         env) {
+    if (!env.obj_cache || compile.is_syntax_only || compile.creates_pch || compile.scans_modules
+        || env.toolchain.deps_mode() == file_deps_mode::none) {
+        // We can't cache results for which we do not know the inputs
+        return std::nullopt;
+    }
+    if (compile.module_unit && compile.module_unit->output) {
+        // The object cache does not store the BMI that is generated along with the object
+        return std::nullopt;
+    }
+    auto                                       quoted = quote_command(compile.command.command);
+    std::optional<object_cache::cached_result> cached;
+    try {
+        cached = env.obj_cache->restore(quoted,
+                                        env.toolchain.hash(),
+                                        compile.object_file_path,
+                                        env.stats);
+    } catch (const std::exception& e) {
+        bpt_log(warn, "Failed to read from the object cache: {}", e.what());
+    }
+    if (!cached) {
+        return std::nullopt;
+    }
+    file_deps_info ret;
+    ret.output                 = compile.object_file_path;
+    ret.inputs                 = std::move(cached->inputs);
+    ret.command.quoted_command = std::move(quoted);
+    ret.command.output         = std::move(cached->compiler_output);
+    ret.command.toolchain_hash = env.toolchain.hash();
+    // A zero duration does not contribute to the recorded average duration
+    ret.command.duration   = std::chrono::milliseconds{0};
+    ret.compile_start_time = fs::file_time_type::clock::now();
+    return ret;
+}
+
+/**
+ * The state of a compilation while its compiler is running
+ */
+struct running_compilation {
+    /// The progress message that was shown when the compilation began
+    std::string msg;
+    /// The time at which the compiler was started
+    fs::file_time_type start_time;
+    /// Measures the duration of the compiler, which is set once it has exited
+    stopwatch                 timer;
+    std::chrono::milliseconds duration{0};
+    /// Covers the compilation in the build trace. The compiler does not occupy a thread while it
+    /// runs, so the slice is given a lane of its own.
+    std::unique_ptr<trace::async_slice> trace_slice;
 };
 
 /**
- * Actually performs a compilation and collects deps information from that compilation
+ * Begin a compilation. If the compiler does not need to run, because the file is up-to-date or
+ * because the result was restored from the object cache, returns the dependency information of the
+ * compilation (if any). Otherwise, returns the state of the compilation: The compiler must then be
+ * run, and its result given to `finish_compilation`.
  *
  * @param cf The compilation to execute
  * @param env The build environment
  * @param counter A thread-safe counter for display progress to the user
  */
-std::optional<file_deps_info>
-handle_compilation(const compile_ticket& compile, build_env_ref env, compile_counter& counter) {
+std::variant<std::optional<file_deps_info>, std::shared_ptr<running_compilation>>
+begin_compilation(const compile_ticket& compile, build_env_ref env, compile_counter& counter) {
+    if (compile.unsupported) {
+        return {};
+    }
     if (!compile.needs_recompile) {
         // We don't actually compile this file. Just issue any prior warning messages that were from
         // a prior compilation.
@@ -80,7 +168,8 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
         }
         bpt_log(
             warn,
-            "While compiling file .bold.cyan[{}] [.bold.yellow[{}]] (.br.blue[cached compiler output]):\n{}"_styled,
+            "While compiling file .bold.cyan[{}] [.bold.yellow[{}]] "
+            "(.br.blue[cached compiler output]):\n{}"_styled,
             compile.plan.get().source_path().string(),
             prior.quoted_command,
             prior.output);
@@ -93,32 +182,89 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
     // Generate a log message to display to the user
     auto source_path = compile.plan.get().source_path();
 
-    std::string_view compile_event_msg = compile.is_syntax_only ? "Check" : "Compile";
-    auto             msg
-        = fmt::format("[{}] {}: .br.cyan[{}]"_styled,
-                      compile.plan.get().qualifier(),
-                      compile_event_msg,
-                      fs::relative(source_path, compile.plan.get().source().basis_path).string());
+    std::string_view compile_event_msg = compile.is_syntax_only ? "Check"
+        : compile.creates_pch                                   ? "Precompile"
+        : compile.scans_modules                                 ? "Scan"
+                                                                : "Compile";
+    auto rel_source = fs::relative(source_path, compile.plan.get().source().basis_path).string();
+    auto running    = std::make_shared<running_compilation>();
+    running->msg    = fmt::format("[{}] {}: .br.cyan[{}]"_styled,
+                               compile.plan.get().qualifier(),
+                               compile_event_msg,
+                               rel_source);
 
-    // Do it!
-    bpt_log(info, msg);
-    auto start_time = fs::file_time_type::clock::now();
-    auto&& [dur_ms, proc_res]
-        = timed<std::chrono::milliseconds>([&] { return run_proc(compile.command.command); });
-    auto nth = counter.n.fetch_add(1);
+    running->trace_slice = std::make_unique<trace::async_slice>(
+        compile.is_syntax_only  ? "check"
+        : compile.scans_modules ? "scan"
+                                : "compile",
+        [&] { return fmt::format("[{}] {}", compile.plan.get().qualifier(), rel_source); },
+        [&] { return quote_command(compile.command.command); });
+
+    if (auto cached = try_restore_cached(compile, env)) {
+        running->trace_slice->set_detail("Restored from the object cache");
+        auto nth        = counter.n.fetch_add(1);
+        auto max        = counter.max.load();
+        auto max_digits = fmt::formatted_size("{}", max);
+        bpt_log(info, "{:60} - {:>9} [{:{}}/{}]", running->msg, "(cached)", nth, max_digits, max);
+        if (!bpt::trim_view(cached->command.output).empty()
+            && compile.plan.get().rules().enable_warnings()) {
+            bpt_log(
+                warn,
+                "While compiling file .bold.cyan[{}] [.bold.yellow[{}]] "
+                "(.br.blue[cached compiler output]):\n{}"_styled,
+                source_path.string(),
+                cached->command.quoted_command,
+                cached->command.output);
+        }
+        env.stats.forget(compile.object_file_path);
+        return cached;
+    }
+
+    bpt_log(info, running->msg);
+    running->start_time = fs::file_time_type::clock::now();
+    running->timer.reset();
+    return running;
+}
+
+/**
+ * Complete a compilation that was started by `begin_compilation`, once its compiler has exited,
+ * and collect the dependency information from it. Throws if the compilation failed.
+ */
+std::optional<file_deps_info> finish_compilation(const compile_ticket& compile,
+                                                 build_env_ref         env,
+                                                 compile_counter&      counter,
+                                                 running_compilation&  running,
+                                                 proc_result           proc_res) {
+    cancellation_point();
+    auto  source_path = compile.plan.get().source_path();
+    auto& msg         = running.msg;
+    auto  dur_ms      = running.duration;
+    auto  start_time  = running.start_time;
+
+    auto nth        = counter.n.fetch_add(1);
+    auto max        = counter.max.load();
+    auto max_digits = fmt::formatted_size("{}", max);
     bpt_log(info,
             "{:60} - {:>7L}ms [{:{}}/{}]",
             msg,
             dur_ms.count(),
             nth,
-            counter.max_digits,
-            counter.max);
+            max_digits,
+            max);
+    bpt_log(debug, "{:60} - {}", msg, describe_resource_usage(proc_res.usage));
 
     const bool  compiled_okay   = proc_res.okay();
     const auto  compile_retc    = proc_res.retc;
     const auto  compile_signal  = proc_res.signal;
+    const auto  usage           = proc_res.usage;
     std::string compiler_output = std::move(proc_res.output);
 
+    if (compiled_okay && compile.command.output_from_stdout) {
+        // The output of the command is its result, rather than diagnostics
+        bpt::write_file(*compile.command.output_from_stdout, compiler_output);
+        compiler_output.clear();
+    }
+
     // Build dependency information, if applicable to the toolchain
     std::optional<file_deps_info> ret_deps_info;
 
@@ -174,9 +320,28 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
          */
     }
 
+    if (ret_deps_info) {
+        // Compilers do not list the precompiled header or the imported BMIs among the dependencies
+        // of the compilation, but the output must be rebuilt when they change.
+        auto& inputs    = ret_deps_info->inputs;
+        auto  add_input = [&](path_ref file) {
+            auto input = env.stats.weakly_canonical(file);
+            if (std::ranges::find(inputs, input) == inputs.end()) {
+                inputs.push_back(std::move(input));
+            }
+        };
+        if (compile.command.precompiled_header_file) {
+            add_input(*compile.command.precompiled_header_file);
+        }
+        for (auto& bmi : compile.command.imported_bmis) {
+            add_input(bmi);
+        }
+    }
+
     if (ret_deps_info) {
         ret_deps_info->command.toolchain_hash = env.toolchain.hash();
         ret_deps_info->compile_start_time     = start_time;
+        ret_deps_info->command.usage          = usage;
     }
 
     // MSVC prints the filename of the source file. Remove it from the output.
@@ -220,29 +385,64 @@ handle_compilation(const compile_ticket& compile, build_env_ref env, compile_cou
 
     // We'll only get here if the compilation was successful, otherwise we throw
     assert(compiled_okay);
+
+    // The stat cache assumes that files do not change during the build, but the compilations that
+    // use a precompiled header or BMI, and the archives and links that use an object file, have not
+    // been checked yet and must see the new file.
+    env.stats.forget(compile.object_file_path);
+    if (compile.module_unit && compile.module_unit->output) {
+        env.stats.forget(compile.module_unit->output->bmi_path);
+    }
+
+    if (env.obj_cache && ret_deps_info && !compile.is_syntax_only && !compile.scans_modules) {
+        try {
+            env.obj_cache->store(ret_deps_info->command.quoted_command,
+                                 env.toolchain.hash(),
+                                 compile.object_file_path,
+                                 ret_deps_info->inputs,
+                                 compiler_output,
+                                 env.stats);
+        } catch (const std::exception& e) {
+            bpt_log(warn, "Failed to store a result in the object cache: {}", e.what());
+        }
+    }
     return ret_deps_info;
 }
 
 /**
- * Determine if the given compile command should actually be executed based on
- * the dependency information we have recorded in the database.
+ * Determine if the given compile command should actually be executed based on the dependency
+ * information that was recorded in the database. The ticket's object path and recorded compilation
+ * must have already been loaded.
  */
-compile_ticket mk_compile_ticket(const compile_file_plan& plan, build_env_ref env) {
-    compile_ticket ret{.plan             = plan,
-                       .command          = plan.generate_compile_command(env),
-                       .object_file_path = plan.calc_object_file_path(env),
-                       .needs_recompile  = false,
-                       .prior_command    = {},
-                       .is_syntax_only   = plan.rules().syntax_only()};
-
-    auto rb_info = get_prior_compilation(env.db, ret.object_file_path);
+void evaluate_ticket(compile_ticket& ret, build_env_ref env) {
+    auto& plan = ret.plan.get();
+    if (ret.creates_pch && !env.toolchain.supports_precompiled_headers()) {
+        bpt_log(debug,
+                "The toolchain does not support precompiled headers. [{}] will not be precompiled.",
+                plan.source_path().string());
+        ret.unsupported = true;
+        return;
+    }
+    ret.command = plan.generate_compile_command(env);
+
+    std::optional<prior_compilation> rb_info;
+    if (ret.recorded) {
+        rb_info = check_prior_compilation(*ret.recorded, env.stats, env.content_hash);
+        // The inputs are no longer needed, and there may be many thousands of them
+        ret.recorded.reset();
+    }
+
     if (!rb_info) {
         bpt_log(trace, "Compile {}: No recorded compilation info", plan.source_path().string());
         ret.needs_recompile = true;
-    } else if (!fs::exists(ret.object_file_path) && !ret.is_syntax_only) {
+    } else if (!env.stats.exists(ret.object_file_path) && !ret.is_syntax_only) {
         bpt_log(trace, "Compile {}: Output does not exist", plan.source_path().string());
         // The output file simply doesn't exist. We have to recompile, of course.
         ret.needs_recompile = true;
+    } else if (ret.module_unit && ret.module_unit->output
+               && !env.stats.exists(ret.module_unit->output->bmi_path)) {
+        bpt_log(trace, "Compile {}: Module BMI does not exist", plan.source_path().string());
+        ret.needs_recompile = true;
     } else if (!rb_info->newer_inputs.empty()) {
         // Inputs to this file have changed from a prior execution.
         bpt_log(trace,
@@ -261,52 +461,380 @@ compile_ticket mk_compile_ticket(const compile_file_plan& plan, build_env_ref en
         bpt_log(debug,
                 "Skip compilation of {} (Result is up-to-date)",
                 plan.source_path().string());
+        for (auto& in : rb_info->refreshed_inputs) {
+            bpt_log(trace, "  - Touched, but content is unchanged: [{}]", in.path.string());
+        }
+        ret.refreshed_inputs = std::move(rb_info->refreshed_inputs);
     }
     if (rb_info) {
-        ret.prior_command = rb_info->previous_command;
+        ret.prior_command = std::move(rb_info->previous_command);
     }
-    return ret;
 }
 
 }  // namespace
 
-bool bpt::detail::compile_all(const ref_vector<const compile_file_plan>& compiles,
-                              build_env_ref                              env,
-                              int                                        njobs) {
-    auto each_realized =  //
+struct compile_batch::impl {
+    build_env_ref               env;
+    std::vector<compile_ticket> tickets;
+    compile_counter             counter;
+    // The assumed duration and memory usage of compilations that have no recorded history
+    std::chrono::milliseconds default_duration;
+    std::uint64_t             default_peak_rss;
+
+    // Set if any ticket evaluation or compilation fails
+    std::atomic_bool failed{false};
+
+    // As we execute, accumulate new dependency information from successful compilations. The
+    // writer thread periodically takes these and stores them in the database, so that completed
+    // work is not lost if the build fails or is interrupted.
+    std::vector<file_deps_info> new_deps{};
+    std::mutex                  mut{};
+    std::condition_variable     cv{};
+    bool                        stop_writer = false;
+    std::exception_ptr          write_error{};
+    std::thread                 writer{};
+
+    ~impl() { stop_writing(); }
+
+    /// Queue the dependency information of a finished compilation to be written to the database
+    void add_deps(std::optional<file_deps_info> info) {
+        if (!info) {
+            return;
+        }
+        std::unique_lock lk{mut};
+        new_deps.push_back(std::move(*info));
+        if (new_deps.size() >= write_batch_size) {
+            cv.notify_one();
+        }
+    }
+
+    /// Store the given dependency information in the database, in a single transaction
+    void write_deps(const std::vector<file_deps_info>& deps) {
+        trace::slice   trace_slice{"phase",
+                                 "Update dependency database",
+                                 fmt::format("{} compilations", deps.size())};
+        bpt::stopwatch update_timer;
+        auto&          db = env.db;
+        // Archives and links may use the database concurrently
+        auto lk = db.lock();
+        for (auto& info : deps) {
+            bpt_log(trace, "Update dependency info on {}", info.output.string());
+            update_deps_info(neo::into(db), info, env.stats, env.content_hash);
+        }
+        db.flush();
+        bpt_log(debug,
+                "Recorded dependency information for {} compilations in {:L}ms",
+                deps.size(),
+                update_timer.elapsed_ms().count());
+    }
+
+    /// The main loop of the writer thread
+    void write_loop() noexcept {
+        neo::listener log_listen = &log::ev_log::print;
+
+        std::unique_lock lk{mut};
+        while (true) {
+            // Write whenever enough results have accumulated, or after a short delay, whichever
+            // comes first
+            cv.wait_for(lk, write_interval, [&] {
+                return stop_writer || new_deps.size() >= write_batch_size;
+            });
+            if (!new_deps.empty()) {
+                auto batch = std::exchange(new_deps, {});
+                lk.unlock();
+                try {
+                    write_deps(batch);
+                } catch (...) {
+                    lk.lock();
+                    if (!write_error) {
+                        write_error = std::current_exception();
+                    }
+                    continue;
+                }
+                lk.lock();
+            }
+            if (stop_writer && new_deps.empty()) {
+                break;
+            }
+        }
+    }
+
+    /// Write any remaining results and stop the writer thread
+    void stop_writing() noexcept {
+        if (!writer.joinable()) {
+            return;
+        }
+        {
+            std::unique_lock lk{mut};
+            stop_writer = true;
+        }
+        cv.notify_one();
+        writer.join();
+    }
+};
+
+compile_batch::compile_batch(const ref_vector<const compile_file_plan>& compiles,
+                             build_env_ref                              env) {
+    auto tickets =  //
         compiles
-        // Convert each _plan_ into a concrete object for compiler invocation.
-        | views::transform([&](auto&& plan) { return mk_compile_ticket(plan, env); })
-        // Convert to to a real vector so we can ask its size.
+        | views::transform([&](const compile_file_plan& plan) {
+              return compile_ticket{.plan           = plan,
+                                    .is_syntax_only = plan.rules().syntax_only(),
+                                    .creates_pch    = plan.rules().create_precompiled_header(),
+                                    .scans_modules  = plan.rules().scan_modules()};
+          })
         | ranges::to_vector;
 
-    auto n_to_compile = static_cast<std::size_t>(
-        ranges::count_if(each_realized, &compile_ticket::needs_recompile));
+    // Resolving the output paths requires filesystem access, so do it in parallel
+    parallel_run(tickets, 0, [&](compile_ticket& tkt) {
+        tkt.object_file_path = tkt.plan.get().calc_object_file_path(env);
+        if (env.modules) {
+            tkt.module_unit = env.modules->find(tkt.object_file_path);
+        }
+    });
 
-    // Keep a counter to display progress to the user.
-    const auto      max_digits = fmt::format("{}", n_to_compile).size();
-    compile_counter counter{.max = n_to_compile, .max_digits = max_digits};
+    // Load everything we know about the prior compilations in one go, rather than issuing queries
+    // for each file individually.
+    auto recorded = env.db.compilations_of(
+        tickets | views::transform(&compile_ticket::object_file_path) | ranges::to_vector);
 
-    // Ass we execute, accumulate new dependency information from successful compilations
-    std::vector<file_deps_info> all_new_deps;
-    std::mutex                  mut;
-    // Do it!
-    auto okay = parallel_run(each_realized, njobs, [&](const compile_ticket& tkt) {
-        auto new_dep = handle_compilation(tkt, env, counter);
-        if (new_dep) {
-            std::unique_lock lk{mut};
-            all_new_deps.push_back(std::move(*new_dep));
+    // Files that have never been compiled are assumed to take an average amount of time
+    std::chrono::milliseconds total_known{0};
+    std::int64_t              n_known         = 0;
+    std::uint64_t             total_rss_known = 0;
+    std::uint64_t             n_rss_known     = 0;
+    for (compile_ticket& tkt : tickets) {
+        auto found = recorded.find(tkt.object_file_path);
+        if (found == recorded.end()) {
+            continue;
+        }
+        total_known += found->second.command.duration;
+        ++n_known;
+        if (found->second.command.usage.peak_rss) {
+            total_rss_known += found->second.command.usage.peak_rss;
+            ++n_rss_known;
         }
+        tkt.recorded = std::move(found->second);
+    }
+
+    _impl.reset(new impl{
+        .env              = env,
+        .tickets          = std::move(tickets),
+        .counter          = {},
+        .default_duration = n_known ? total_known / n_known : std::chrono::milliseconds{0},
+        .default_peak_rss = n_rss_known ? total_rss_known / n_rss_known : 0,
     });
+    _impl->writer = std::thread([this_impl = _impl.get()] { this_impl->write_loop(); });
+}
+
+compile_batch::compile_batch(compile_batch&&) noexcept = default;
+compile_batch::~compile_batch()                        = default;
+
+std::size_t compile_batch::size() const noexcept { return _impl->tickets.size(); }
+
+bool compile_batch::failed() const noexcept { return _impl->failed.load(); }
+
+std::vector<task_graph::task_id> compile_batch::add_tasks(task_graph& graph) const {
+    // Tickets are evaluated in small chunks, each as its own task. The compilations of a chunk can
+    // begin as soon as that chunk is evaluated, without waiting on the rest of the batch. Because
+    // an evaluation task inherits the critical path of the compilations that depend on it, the
+    // scheduler will prefer evaluating tickets over starting compilations.
+    constexpr std::size_t chunk_size = 32;
+
+    auto& impl        = *_impl;
+    auto  run_guarded = [&impl](auto fn) {
+        return [&impl, fn] {
+            try {
+                fn();
+            } catch (...) {
+                impl.failed = true;
+                throw;
+            }
+        };
+    };
+
+    auto add_eval_task = [&](std::vector<std::size_t> indices) {
+        return graph.add(run_guarded([&impl, indices = std::move(indices)] {
+            for (auto idx : indices) {
+                evaluate_ticket(impl.tickets[idx], impl.env);
+                if (impl.tickets[idx].needs_recompile) {
+                    ++impl.counter.max;
+                }
+            }
+        }));
+    };
+
+    auto add_compile_task = [&](std::size_t idx, task_graph::task_id eval_id) {
+        // Prefer the duration recorded for this file. We do not know yet whether the file is
+        // up-to-date, but if it is, the compilation task will finish immediately.
+        const compile_ticket& tkt = impl.tickets[idx];
+        auto cost = tkt.recorded ? tkt.recorded->command.duration : impl.default_duration;
+        // Likewise for the memory that the compilation is expected to use
+        auto memory = tkt.recorded && tkt.recorded->command.usage.peak_rss
+            ? tkt.recorded->command.usage.peak_rss
+            : impl.default_peak_rss;
+        // The compiler does not occupy a worker while it runs
+        auto id = graph.add_async(
+            [this, idx, run_guarded](task_graph::resume_fn resume) {
+                run_guarded([&] {
+                    start(idx, [resume, run_guarded](std::function<void()> finish) {
+                        resume(run_guarded(std::move(finish)));
+                    });
+                })();
+            },
+            cost,
+            memory);
+        graph.add_dependency(id, eval_id);
+        return id;
+    };
+
+    // Precompiled headers and the BMIs of C++ modules must be up-to-date before we can decide
+    // whether the files that use them need to be recompiled, so each compilation that generates one
+    // is evaluated and compiled on its own, and the evaluation of the files that use it waits for
+    // it.
+    auto is_producer = [&](std::size_t idx) {
+        auto& tkt = impl.tickets[idx];
+        return tkt.creates_pch || (tkt.module_unit && tkt.module_unit->output);
+    };
+    std::map<fs::path, std::size_t> index_of_object;
+    for (std::size_t idx = 0; idx < impl.tickets.size(); ++idx) {
+        index_of_object.emplace(impl.tickets[idx].object_file_path, idx);
+    }
+
+    std::vector<task_graph::task_id>                ret(impl.tickets.size());
+    std::map<fs::path, task_graph::task_id>         pch_tasks;
+    std::map<std::size_t, task_graph::task_id>      producer_tasks;
+    std::function<task_graph::task_id(std::size_t)> add_producer;
+
+    // Obtain the compilation tasks that must finish before the given ticket is evaluated
+    auto prerequisites = [&](std::size_t idx) {
+        std::vector<task_graph::task_id> deps;
+        auto&                            tkt   = impl.tickets[idx];
+        auto&                            rules = tkt.plan.get().rules();
+        if (rules.precompiled_header() && !rules.syntax_only() && !tkt.creates_pch) {
+            auto found = pch_tasks.find(*rules.precompiled_header());
+            if (found != pch_tasks.end()) {
+                deps.push_back(found->second);
+            }
+        }
+        if (tkt.module_unit) {
+            for (auto& provider : tkt.module_unit->providers) {
+                auto found = index_of_object.find(provider);
+                if (found != index_of_object.end()) {
+                    deps.push_back(add_producer(found->second));
+                }
+            }
+        }
+        return deps;
+    };
+
+    // Module imports cannot be cyclic, so this recursion terminates
+    add_producer = [&](std::size_t idx) {
+        auto found = producer_tasks.find(idx);
+        if (found != producer_tasks.end()) {
+            return found->second;
+        }
+        auto eval_id = add_eval_task({idx});
+        for (auto dep : prerequisites(idx)) {
+            graph.add_dependency(eval_id, dep);
+        }
+        ret[idx] = add_compile_task(idx, eval_id);
+        producer_tasks.emplace(idx, ret[idx]);
+        return ret[idx];
+    };
+
+    std::vector<std::size_t> other_indices;
+    for (std::size_t idx = 0; idx < impl.tickets.size(); ++idx) {
+        if (impl.tickets[idx].creates_pch) {
+            pch_tasks.emplace(*impl.tickets[idx].plan.get().rules().precompiled_header(),
+                              add_producer(idx));
+        }
+    }
+    for (std::size_t idx = 0; idx < impl.tickets.size(); ++idx) {
+        if (is_producer(idx)) {
+            add_producer(idx);
+        } else {
+            other_indices.push_back(idx);
+        }
+    }
+
+    for (std::size_t first = 0; first < other_indices.size(); first += chunk_size) {
+        const auto last = (std::min)(first + chunk_size, other_indices.size());
+        std::vector<std::size_t> chunk(other_indices.begin() + first, other_indices.begin() + last);
+        auto                     eval_id = add_eval_task(chunk);
+        std::set<task_graph::task_id> prereq_deps;
+        for (auto idx : chunk) {
+            for (auto dep : prerequisites(idx)) {
+                if (prereq_deps.insert(dep).second) {
+                    graph.add_dependency(eval_id, dep);
+                }
+            }
+            ret[idx] = add_compile_task(idx, eval_id);
+        }
+    }
+    return ret;
+}
 
-    // Update compile dependency information
-    bpt::stopwatch update_timer;
-    auto           tr = env.db.transaction();
-    for (auto& info : all_new_deps) {
-        bpt_log(trace, "Update dependency info on {}", info.output.string());
-        update_deps_info(neo::into(env.db), info);
+void compile_batch::start(std::size_t index, task_graph::resume_fn resume) const {
+    auto& impl    = *_impl;
+    auto& tkt     = impl.tickets.at(index);
+    auto  started = begin_compilation(tkt, impl.env, impl.counter);
+    if (auto done = std::get_if<std::optional<file_deps_info>>(&started)) {
+        impl.add_deps(std::move(*done));
+        resume([] {});
+        return;
     }
-    bpt_log(debug, "Dependency update took {:L}ms", update_timer.elapsed_ms().count());
+
+    auto running = std::get<std::shared_ptr<running_compilation>>(std::move(started));
+    run_proc_async({.command = tkt.command.command},
+                   [&impl, &tkt, running, resume](std::exception_ptr error, proc_result res) {
+                       running->duration = running->timer.elapsed_ms();
+                       resume([&impl, &tkt, running, error, res]() mutable {
+                           if (error) {
+                               std::rethrow_exception(error);
+                           }
+                           impl.add_deps(finish_compilation(tkt,
+                                                            impl.env,
+                                                            impl.counter,
+                                                            *running,
+                                                            std::move(res)));
+                       });
+                   });
+}
+
+void compile_batch::finish() {
+    // Write whatever dependency information is still pending
+    _impl->stop_writing();
+    if (_impl->write_error) {
+        std::rethrow_exception(std::exchange(_impl->write_error, nullptr));
+    }
+
+    trace::slice trace_slice{"phase", "Update dependency database"};
+    auto&        db = _impl->env.db;
+    // Record the new mtimes of inputs that were found to be unchanged, so that we do not need to
+    // hash them again on the next build.
+    for (compile_ticket& tkt : _impl->tickets) {
+        for (auto& in : tkt.refreshed_inputs) {
+            db.refresh_dep(in.path, tkt.object_file_path, in.prev_mtime);
+        }
+        tkt.refreshed_inputs.clear();
+    }
+    db.flush();
+}
+
+bool bpt::detail::compile_all(const ref_vector<const compile_file_plan>& compiles,
+                              build_env_ref                              env,
+                              int                                        njobs) {
+    compile_batch batch{compiles, env};
+
+    // Start the longest compilations first, so that they do not become the tail of the build
+    task_graph graph;
+    batch.add_tasks(graph);
+
+    // Do it!
+    auto okay = graph.run(njobs, env.memory_budget);
+
+    batch.finish();
 
     cancellation_point();
     // Return whether or not there were any failures.
@@ -3,12 +3,72 @@
 #include <bpt/build/plan/base.hpp>
 #include <bpt/build/plan/compile_file.hpp>
 #include <bpt/util/algo.hpp>
+#include <bpt/util/task_graph.hpp>
 
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <vector>
 
 namespace bpt {
 
+/**
+ * A set of file compilations that can be executed individually (and in any order) as part of a
+ * larger build. Dependency information collected from the executed compilations is written to the
+ * build database in small batches as the compilations finish, so that completed work survives a
+ * failed or interrupted build. `finish()` writes whatever remains.
+ */
+class compile_batch {
+    struct impl;
+    std::unique_ptr<impl> _impl;
+
+public:
+    /**
+     * Prepare the given compilations for execution. This loads the prior compilation information
+     * for every file from the build database at once. Checking whether each file is up-to-date is
+     * deferred to the tasks created by `add_tasks`.
+     */
+    compile_batch(const ref_vector<const compile_file_plan>& files, build_env_ref env);
+    compile_batch(compile_batch&&) noexcept;
+    ~compile_batch();
+
+    /**
+     * The number of compilations in this batch
+     */
+    std::size_t size() const noexcept;
+
+    /**
+     * Whether any compilation (or the evaluation of whether it is up-to-date) has failed
+     */
+    bool failed() const noexcept;
+
+    /**
+     * Add the work of this batch to the given task graph. Files are checked for being up-to-date
+     * in parallel, in small chunks, and each compilation may start as soon as its own chunk has
+     * been checked. Compilations are weighted by their recorded durations, with files that have
+     * no recorded history assumed to take as long as the average of those that do.
+     *
+     * @returns The ID of the compilation task for each file, in the same order as the files that
+     * were given to the constructor.
+     */
+    std::vector<task_graph::task_id> add_tasks(task_graph& graph) const;
+
+    /**
+     * Begin the compilation at the given index, without waiting for the compiler. Once the
+     * compiler has exited, `resume` is given a function that finishes the compilation, which
+     * throws if the compilation failed. If the file is up-to-date, only replays any prior compiler
+     * output before calling `resume`. This may be called concurrently from multiple threads for
+     * different indices, but only once the file has been checked by the tasks of `add_tasks`.
+     */
+    void start(std::size_t index, task_graph::resume_fn resume) const;
+
+    /**
+     * Store any dependency information that has not yet been written to the build database. Must
+     * be called after all compilations have finished.
+     */
+    void finish();
+};
+
 namespace detail {
 
 bool compile_all(const ref_vector<const compile_file_plan>& files, build_env_ref env, int njobs);
@@ -1,5 +1,6 @@
 #include "./compile_file.hpp"
 
+#include <bpt/build/plan/modules.hpp>
 #include <bpt/util/algo.hpp>
 #include <bpt/util/proc.hpp>
 #include <bpt/util/signal.hpp>
@@ -15,26 +16,55 @@ using namespace bpt;
 
 compile_command_info compile_file_plan::generate_compile_command(build_env_ref env) const {
     compile_file_spec spec{_source.path, calc_object_file_path(env)};
-    spec.enable_warnings = _rules.enable_warnings();
-    spec.syntax_only     = _rules.syntax_only();
+    spec.enable_warnings  = _rules.enable_warnings();
+    spec.syntax_only      = _rules.syntax_only();
+    spec.scan_module_deps = _rules.scan_modules();
+    if (_rules.precompiled_header()) {
+        spec.precompiled_header        = env.output_root / *_rules.precompiled_header();
+        spec.create_precompiled_header = _rules.create_precompiled_header();
+    }
     for (auto dirpath : _rules.include_dirs()) {
         dirpath = bpt::resolve_path_weak(dirpath);
         spec.include_dirs.push_back(std::move(dirpath));
     }
-    for (const auto& use : _rules.uses()) {
-        extend(spec.external_include_dirs, env.ureqs.include_paths(use));
-    }
+    // The usage closures are already free of duplicates, and their order is significant
+    spec.external_include_dirs = env.ureqs.include_paths(_rules.uses());
     extend(spec.definitions, _rules.defs());
+    if (env.modules && !spec.scan_module_deps) {
+        if (auto unit = env.modules->find(spec.out_path)) {
+            spec.module_output  = unit->output;
+            spec.module_imports = unit->imports;
+        }
+    }
     // Avoid huge command lines by shrinking down the list of #include dirs
-    sort_unique_erase(spec.external_include_dirs);
     sort_unique_erase(spec.include_dirs);
     return env.toolchain.create_compile_command(spec, bpt::fs::current_path(), env.knobs);
 }
 
+compile_file_plan compile_file_plan::module_scan_plan() const {
+    auto ret                  = *this;
+    ret._rules                = _rules.clone();
+    ret._rules.scan_modules() = true;
+    return ret;
+}
+
 fs::path compile_file_plan::calc_object_file_path(const build_env& env) const noexcept {
+    return env.stats.weakly_canonical(calc_object_file_path(env.toolchain, env.output_root));
+}
+
+fs::path compile_file_plan::calc_object_file_path(const toolchain& tc,
+                                                  path_ref         out_root) const noexcept {
+    if (_rules.create_precompiled_header() && _rules.precompiled_header()) {
+        // The output of creating a precompiled header is the precompiled header file itself
+        return tc.precompiled_header_file(out_root / *_rules.precompiled_header());
+    }
     auto relpath = _source.relative_path();
     // The full output directory is prefixed by `_subdir`
-    auto ret = env.output_root / _subdir / relpath;
-    ret.replace_filename(relpath.filename().string() + env.toolchain.object_suffix());
-    return fs::weakly_canonical(ret);
+    auto ret = out_root / _subdir / relpath;
+    ret.replace_filename(relpath.filename().string() + tc.object_suffix());
+    if (_rules.scan_modules()) {
+        // The scan result is named for the object file that the source will be compiled to
+        ret += ".ddi";
+    }
+    return ret;
 }
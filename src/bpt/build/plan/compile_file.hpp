@@ -6,6 +6,7 @@
 #include <libman/library.hpp>
 
 #include <memory>
+#include <optional>
 
 namespace bpt {
 
@@ -30,6 +31,9 @@ class shared_compile_file_rules {
         std::vector<lm::usage>   uses;
         bool                     enable_warnings = false;
         bool                     syntax_only     = false;
+        std::optional<fs::path>  precompiled_header;
+        bool                     create_precompiled_header = false;
+        bool                     scan_modules              = false;
     };
 
     /// The actual PIMPL.
@@ -74,6 +78,25 @@ public:
      */
     auto& syntax_only() noexcept { return _impl->syntax_only; }
     auto& syntax_only() const noexcept { return _impl->syntax_only; }
+
+    /**
+     * The precompiled header used by the associated compiles, as a path relative to the build
+     * output root. The toolchain places the precompiled header file alongside this path.
+     */
+    auto& precompiled_header() noexcept { return _impl->precompiled_header; }
+    auto& precompiled_header() const noexcept { return _impl->precompiled_header; }
+
+    /**
+     * A boolean to toggle creating the `precompiled_header` rather than using it
+     */
+    auto& create_precompiled_header() noexcept { return _impl->create_precompiled_header; }
+    auto& create_precompiled_header() const noexcept { return _impl->create_precompiled_header; }
+
+    /**
+     * A boolean to toggle scanning for C++ module dependencies rather than compiling
+     */
+    auto& scan_modules() noexcept { return _impl->scan_modules; }
+    auto& scan_modules() const noexcept { return _impl->scan_modules; }
 };
 
 /**
@@ -90,6 +113,8 @@ class compile_file_plan {
     std::string _qualifier;
     /// The subdirectory in which the object file will be generated
     fs::path _subdir;
+    /// If non-empty, the sources that are combined by the generated unity source `_source`
+    std::vector<source_file> _unity_sources;
 
 public:
     /**
@@ -98,15 +123,19 @@ public:
      * @param sf The source file that will be compiled
      * @param qual An arbitrary qualifier for the source file, shown in log output
      * @param subdir The subdirectory where the object file will be generated
+     * @param unity_sources If non-empty, `sf` is a unity source file that #includes each of these
+     *      sources, in order. The file is generated by `combine_unity_sources`.
      */
     compile_file_plan(shared_compile_file_rules rules,
                       source_file               sf,
                       std::string_view          qual,
-                      path_ref                  subdir)
+                      path_ref                  subdir,
+                      std::vector<source_file>  unity_sources = {})
         : _rules(rules)
         , _source(std::move(sf))
         , _qualifier(qual)
-        , _subdir(subdir) {}
+        , _subdir(subdir)
+        , _unity_sources(std::move(unity_sources)) {}
 
     /**
      * The `source_file` object for this plan.
@@ -124,11 +153,26 @@ public:
      * The arbitrary qualifier for this compilation
      */
     auto& qualifier() const noexcept { return _qualifier; }
+    /**
+     * The sources combined by this compilation, if it compiles a generated unity source file.
+     */
+    auto& unity_sources() const noexcept { return _unity_sources; }
+
+    /**
+     * Create a plan that scans the source file of this plan for its C++ module dependencies. The
+     * scan result is written alongside the object file of this plan.
+     */
+    compile_file_plan module_scan_plan() const;
 
     /**
      * Generate the path that will be the destination of this compile output
      */
     fs::path calc_object_file_path(build_env_ref env) const noexcept;
+    /**
+     * Generate the path that will be the destination of this compile output when building into
+     * `out_root` with the given toolchain. Unlike the above, the path is not canonicalized.
+     */
+    fs::path calc_object_file_path(const toolchain& tc, path_ref out_root) const noexcept;
     /**
      * Generate a concrete compile command object for this source file for the given build
      * environment.
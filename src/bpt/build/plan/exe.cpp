@@ -1,20 +1,61 @@
 #include "./exe.hpp"
 
+#include <bpt/build/file_deps.hpp>
 #include <bpt/build/plan/library.hpp>
+#include <bpt/build/test_schedule.hpp>
 #include <bpt/error/errors.hpp>
 #include <bpt/util/algo.hpp>
+#include <bpt/util/env.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/proc.hpp>
+#include <bpt/util/siphash.hpp>
+#include <bpt/util/string.hpp>
 #include <bpt/util/time.hpp>
+#include <bpt/util/trace.hpp>
 
 #include <fansi/styled.hpp>
 
 #include <algorithm>
 #include <chrono>
+#include <iterator>
 
 using namespace bpt;
 using namespace fansi::literals;
 
+namespace {
+
+/**
+ * Compute the key of a run of a test executable. A test that passed with the same key is expected
+ * to pass again, as the key covers the content of the executable, its command line, the working
+ * directory, and every environment variable.
+ */
+std::uint64_t calc_test_key(std::uint64_t exe_digest, const std::vector<std::string>& command) {
+    // The environment does not change during the build
+    static const std::string env_key = [] {
+        std::string ret;
+        for (auto& var : bpt::environment_entries()) {
+            // The make flags differ between otherwise identical runs (e.g. the jobserver file
+            // descriptors, or the jobserver that bpt itself serves), and do not affect a test.
+            if (starts_with(var, "MAKEFLAGS=") || starts_with(var, "MFLAGS=")) {
+                continue;
+            }
+            ret += var;
+            ret.push_back('\0');
+        }
+        return ret;
+    }();
+    auto key    = fmt::format("{}\n{}\n{}\n{}",
+                           exe_digest,
+                           quote_command(command),
+                           fs::current_path().string(),
+                           env_key);
+    auto digest = siphash64(42, 1729, neo::const_buffer(key)).digest();
+    // Zero is recorded for tests that did not pass
+    return digest ? digest : 1;
+}
+
+}  // namespace
+
 fs::path link_executable_plan::calc_executable_path(build_env_ref env) const noexcept {
     return env.output_root / _out_subdir / (_name + env.toolchain.executable_suffix());
 }
@@ -39,24 +80,58 @@ void link_executable_plan::link(build_env_ref env, const library_plan& lib) cons
                               / lib.archive_plan()->calc_archive_file_path(env.toolchain));
     } else {
         bpt_log(trace, "Executable has no corresponding archive library input");
+        // Some toolchains generate an object file along with a precompiled header, which would
+        // otherwise have been included in the archive.
+        if (lib.precompiled_header() && env.toolchain.supports_precompiled_headers()) {
+            auto pch_obj = env.toolchain.precompiled_header_object(
+                lib.precompiled_header()->calc_object_file_path(env));
+            if (pch_obj) {
+                spec.inputs.push_back(std::move(*pch_obj));
+            }
+        }
     }
 
     for (const lm::usage& links : _links) {
         bpt_log(trace, "  - Link with: {}/{}", links.name, links.namespace_);
-        extend(spec.inputs, env.ureqs.link_paths(links));
     }
+    // Each library appears once, before the libraries that it requires
+    extend(spec.inputs, env.ureqs.link_paths(_links));
 
     // Do it!
     const auto link_command
         = env.toolchain.create_link_executable_command(spec, bpt::fs::current_path(), env.knobs);
+    const auto quoted_cmd = quote_command(link_command);
+
+    // Skip the link if neither its inputs nor the command have changed
+    {
+        auto lk       = env.db.lock();
+        auto outdated = check_output_outdated(env.db,
+                                              spec.output,
+                                              quoted_cmd,
+                                              env.toolchain.hash(),
+                                              env.stats,
+                                              env.content_hash);
+        if (!outdated) {
+            bpt_log(debug, "Skip link of {} (Result is up-to-date)", spec.output.string());
+            return;
+        }
+        bpt_log(trace, "Link {}: {}", spec.output.string(), outdated->reason);
+    }
+
     fs::create_directories(spec.output.parent_path());
-    auto msg = fmt::format("[{}] Link: {:30}",
-                           lib.qualified_name(),
-                           fs::relative(spec.output, env.output_root).string());
+    auto out_relpath = fs::relative(spec.output, env.output_root).string();
+    auto msg         = fmt::format("[{}] Link: {:30}", lib.qualified_name(), out_relpath);
     bpt_log(info, msg);
+    trace::slice trace_slice{"link",
+                             [&] {
+                                 return fmt::format("[{}] {}", lib.qualified_name(), out_relpath);
+                             },
+                             [&] { return quoted_cmd; }};
+    auto start_time = fs::file_time_type::clock::now();
     auto [dur_ms, proc_res]
         = timed<std::chrono::milliseconds>([&] { return run_proc(link_command); });
     bpt_log(info, "{} - {:>6L}ms", msg, dur_ms.count());
+    bpt_log(debug, "{} - {}", msg, describe_resource_usage(proc_res.usage));
 
     // Check and throw if errant
     if (!proc_res.okay()) {
@@ -64,10 +139,30 @@ void link_executable_plan::link(build_env_ref env, const library_plan& lib) cons
             "Failed to link executable [{}]. Link command was [{}] [Exited {}], produced "
             "output:\n{}",
             spec.output.string(),
-            quote_command(link_command),
+            quoted_cmd,
             proc_res.retc,
             proc_res.output);
     }
+
+    // Record the link so that it can be skipped in the next build. Only the inputs that are files
+    // can be checked for changes.
+    env.stats.forget(spec.output);
+    file_deps_info info{
+        .output             = spec.output,
+        .inputs             = {},
+        .command            = {quoted_cmd,
+                               std::move(proc_res.output),
+                               env.toolchain.hash(),
+                               dur_ms,
+                               proc_res.usage},
+        .compile_start_time = start_time,
+    };
+    std::ranges::copy_if(spec.inputs, std::back_inserter(info.inputs), [&](path_ref input) {
+        return env.stats.exists(input);
+    });
+    auto lk = env.db.lock();
+    update_deps_info(neo::into(env.db), info, env.stats, env.content_hash);
+    env.db.flush();
 }
 
 bool link_executable_plan::is_app() const noexcept {
@@ -82,10 +177,45 @@ std::optional<test_failure> link_executable_plan::run_test(build_env_ref env) co
     auto exe_path = calc_executable_path(env);
     auto msg      = fmt::format("Run test: .br.cyan[{:30}]"_styled,
                            fs::relative(exe_path, env.output_root).string());
+
+    recorded_test_result prior;
+    {
+        auto lk = env.db.lock();
+        prior   = env.db.test_result(exe_path).value_or(recorded_test_result{});
+    }
+
+    // Do not run the test again if it passed with the same executable and environment
+    std::vector<std::string> command  = {exe_path.string()};
+    std::uint64_t            test_key = 0;
+    if (auto exe_digest = env.stats.digest(exe_path)) {
+        test_key = calc_test_key(*exe_digest, command);
+        if (!env.rerun_tests && prior.pass_key == test_key) {
+            bpt_log(info, "{} - .br.green[PASS] (cached)"_styled, msg);
+            return std::nullopt;
+        }
+    }
+
+    // Allow the test to run much longer than it usually does before considering it to be hung
+    auto timeout = test_timeout(prior.durations);
+    bpt_log(debug, "{} - Timeout is {:L}ms", msg, timeout.count());
+
     bpt_log(info, msg);
-    using namespace std::chrono_literals;
+    trace::slice trace_slice{"test",
+                             [&] { return fs::relative(exe_path, env.output_root).string(); },
+                             [] { return std::string(); }};
     auto&& [dur, res] = timed<std::chrono::microseconds>(
-        [&] { return run_proc({.command = {exe_path.string()}, .timeout = 10s}); });
+        [&] { return run_proc({.command = command, .timeout = timeout}); });
+    bpt_log(debug, "{} - {}", msg, describe_resource_usage(res.usage));
+
+    {
+        auto lk = env.db.lock();
+        // A test that timed out was killed, and its duration says nothing about how long it
+        // would have taken. Recording it would only raise the timeout for the next runs.
+        env.db.record_test_result(exe_path,
+                                  res.okay() ? test_key : 0,
+                                  res.timed_out ? std::nullopt : std::optional(dur),
+                                  res.usage);
+    }
 
     if (res.okay()) {
         bpt_log(info, "{} - .br.green[PASS] - {:>9L}μs"_styled, msg, dur.count());
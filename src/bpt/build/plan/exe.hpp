@@ -59,6 +59,11 @@ public:
      */
     auto& main_compile_file() const noexcept { return _main_compile; }
 
+    /**
+     * Get the usage requirements that this executable will link against
+     */
+    auto& links() const noexcept { return _links; }
+
     /**
      * Calculate the output path of the executable for the given build environment
      */
@@ -2,15 +2,20 @@
 
 #include <bpt/build/iter_compilations.hpp>
 #include <bpt/build/plan/compile_exec.hpp>
+#include <bpt/build/plan/modules.hpp>
+#include <bpt/build/test_schedule.hpp>
 #include <bpt/error/doc_ref.hpp>
 #include <bpt/error/errors.hpp>
 #include <bpt/error/nonesuch.hpp>
 #include <bpt/error/on_error.hpp>
 #include <bpt/util/log.hpp>
 #include <bpt/util/parallel.hpp>
+#include <bpt/util/signal.hpp>
+#include <bpt/util/task_graph.hpp>
 #include <bpt/util/tl.hpp>
 
 #include <boost/leaf/exception.hpp>
+#include <neo/fwd.hpp>
 #include <neo/tl.hpp>
 #include <range/v3/algorithm/any_of.hpp>
 #include <range/v3/range/conversion.hpp>
@@ -21,7 +26,11 @@
 #include <range/v3/view/transform.hpp>
 #include <range/v3/view/zip.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <map>
 #include <mutex>
+#include <optional>
 #include <thread>
 
 using namespace bpt;
@@ -41,10 +50,106 @@ struct pending_file {
     auto operator<=>(const pending_file&) const noexcept = default;
 };
 
+/**
+ * Wrap a task function such that the given flag will be set if the task fails.
+ */
+template <typename Func>
+auto flag_failure(std::atomic_bool& flag, Func&& fn) {
+    return [&flag, fn = NEO_FWD(fn)] {
+        try {
+            fn();
+        } catch (...) {
+            flag = true;
+            throw;
+        }
+    };
+}
+
+/**
+ * How a test executable of the plan is scheduled
+ */
+struct scheduled_test {
+    /// Whether the test is run by this build, i.e. it belongs to the selected test shard
+    bool selected = true;
+    /// The expected duration of the test, from its recorded history
+    std::chrono::milliseconds cost{};
+};
+
+/**
+ * Decide which of the tests in the plan will be run, and how long each is expected to take.
+ */
+std::map<const link_executable_plan*, scheduled_test> schedule_tests(const build_plan& plan,
+                                                                     build_env_ref     env) {
+    std::map<const link_executable_plan*, scheduled_test> ret;
+    std::size_t                                           n_tests    = 0;
+    std::size_t                                           n_selected = 0;
+    for (const library_plan& lib : iter_libraries(plan)) {
+        for (const link_executable_plan& exe : lib.executables()) {
+            if (!exe.is_test()) {
+                continue;
+            }
+            auto exe_path = exe.calc_executable_path(env);
+            auto prior    = env.db.test_result(exe_path);
+            auto expected = prior ? expected_test_duration(prior->durations) : std::nullopt;
+            // Shards are assigned by the test's path within the build directory, and not by its
+            // recorded duration, so that every machine computes the same assignment.
+            auto           relpath = exe_path.lexically_relative(env.output_root).generic_string();
+            scheduled_test sched;
+            sched.selected = !env.test_shard
+                || assign_test_shard(relpath, env.test_shard->count) == env.test_shard->index - 1;
+            sched.cost = std::chrono::ceil<std::chrono::milliseconds>(
+                expected.value_or(std::chrono::microseconds{}));
+            ++n_tests;
+            n_selected += sched.selected ? 1 : 0;
+            ret.emplace(&exe, sched);
+        }
+    }
+    if (env.test_shard) {
+        bpt_log(info,
+                "Running {} of {} tests in shard {}/{}",
+                n_selected,
+                n_tests,
+                env.test_shard->index,
+                env.test_shard->count);
+    }
+    return ret;
+}
+
+/**
+ * The build environment for a set of compilations. If the toolchain supports C++ modules, the
+ * compilations are first scanned for their module dependencies.
+ */
+struct module_build_env {
+    std::optional<module_graph> modules;
+    build_env                   env;
+
+    module_build_env(build_env_ref                              base,
+                     const ref_vector<const compile_file_plan>& compiles,
+                     int                                        njobs)
+        : env(base) {
+        if (base.toolchain.supports_modules()) {
+            modules.emplace(module_graph::scan(compiles, base, njobs));
+            env.modules = &*modules;
+        }
+    }
+
+    module_build_env(const module_build_env&) = delete;
+};
+
+ref_vector<const compile_file_plan> all_compilations(const build_plan& plan) {
+    ref_vector<const compile_file_plan> ret;
+    for (auto&& cf : iter_compilations(plan)) {
+        ret.push_back(cf);
+    }
+    return ret;
+}
+
 }  // namespace
 
 void build_plan::compile_all(const build_env& env, int njobs) const {
-    auto okay = bpt::compile_all(iter_compilations(*this), env, njobs);
+    auto             compiles = all_compilations(*this);
+    module_build_env mod_env{env, compiles, njobs};
+    auto             okay = bpt::detail::compile_all(compiles, mod_env.env, njobs);
     if (!okay) {
         throw_user_error<errc::compile_failure>();
     }
@@ -64,18 +169,40 @@ void build_plan::compile_files(const build_env&             env,
     bpt::sort_unique_erase(as_pending);
 
     auto check_compilation = [&](const compile_file_plan& comp) {
-        return ranges::any_of(as_pending, [&](pending_file& f) {
-            bool same_file = f.filepath == fs::weakly_canonical(comp.source_path());
-            if (same_file) {
-                f.marked = true;
+        // A unity compilation is selected by any of the sources that it combines
+        auto sources = comp.unity_sources().empty()
+            ? std::vector<fs::path>{comp.source_path()}
+            : comp.unity_sources() | ranges::views::transform(&source_file::path)
+                | ranges::to_vector;
+        bool any_marked = false;
+        for (auto& f : as_pending) {
+            if (ranges::any_of(sources, [&](path_ref p) {
+                    return f.filepath == fs::weakly_canonical(p);
+                })) {
+                f.marked   = true;
+                any_marked = true;
             }
-            return same_file;
-        });
+        }
+        return any_marked;
     };
 
+    auto             all_comps = all_compilations(*this);
+    module_build_env mod_env{env, all_comps, njobs};
+
     // Create a vector of compilations, and mark files so that we can find who hasn't been marked.
-    auto comps
-        = iter_compilations(*this) | ranges::views::filter(check_compilation) | ranges::to_vector;
+    // Precompiled headers and module interfaces are always included, as the requested files may
+    // depend on them.
+    auto generates_bmi = [&](const compile_file_plan& comp) {
+        auto unit = mod_env.modules ? mod_env.modules->find(comp.calc_object_file_path(env))
+                                    : nullptr;
+        return unit && unit->output;
+    };
+    auto comps = all_comps  //
+        | ranges::views::filter([&](const compile_file_plan& comp) {
+                     return check_compilation(comp) || comp.rules().create_precompiled_header()
+                         || generates_bmi(comp);
+                 })
+        | ranges::to_vector;
 
     // Make an error if there are any unmarked files
     auto missing_files = as_pending  //
@@ -87,7 +214,7 @@ void build_plan::compile_files(const build_env&             env,
         BOOST_LEAF_THROW_EXCEPTION(make_user_error<errc::compile_failure>(), missing_files);
     }
 
-    auto okay = bpt::compile_all(comps, env, njobs);
+    auto okay = bpt::compile_all(comps, mod_env.env, njobs);
     if (!okay) {
         BOOST_LEAF_THROW_EXCEPTION(make_user_error<errc::compile_failure>(),
                                    BPT_ERR_REF("compile-failure"));
@@ -127,20 +254,23 @@ void build_plan::link_all(const build_env& env, int njobs) const {
 }
 
 std::vector<test_failure> build_plan::run_all_tests(build_env_ref env, int njobs) const {
-    using namespace ranges::views;
-    // Collect executables that are tests
-    auto test_executables =                       //
-        iter_libraries(*this)                     //
-        | transform(&library_plan::executables)   //
-        | join                                    //
-        | filter(&link_executable_plan::is_test)  //
-        ;
+    // Collect the tests to run, and start the longest tests first so that they do not finish last
+    auto                                      schedule = schedule_tests(*this, env);
+    std::vector<const link_executable_plan*> test_executables;
+    for (auto& [exe, sched] : schedule) {
+        if (sched.selected) {
+            test_executables.push_back(exe);
+        }
+    }
+    std::ranges::stable_sort(test_executables, std::greater{}, [&](auto exe) {
+        return schedule.at(exe).cost;
+    });
 
     std::mutex                mut;
     std::vector<test_failure> fails;
 
-    parallel_run(test_executables, njobs, [&](const auto& exe) {
-        auto fail_info = exe.run_test(env);
+    parallel_run(test_executables, njobs, [&](const link_executable_plan* exe) {
+        auto fail_info = exe->run_test(env);
         if (fail_info) {
             std::scoped_lock lk{mut};
             fails.emplace_back(std::move(*fail_info));
@@ -148,3 +278,102 @@ std::vector<test_failure> build_plan::run_all_tests(build_env_ref env, int njobs
     });
     return fails;
 }
+
+std::vector<test_failure> build_plan::build_all(build_env_ref base_env, int njobs) const {
+    task_graph graph;
+
+    std::atomic_bool archive_failed = false;
+    std::atomic_bool link_failed    = false;
+
+    // Create the tasks for every compilation in the plan, and remember which task belongs to which
+    // compilation so that we can attach archives and links to them.
+    auto compiles = all_compilations(*this);
+    // Module dependencies must be known before the compilations can be ordered
+    module_build_env mod_env{base_env, compiles, njobs};
+    build_env_ref    env = mod_env.env;
+    compile_batch    batch{compiles, env};
+
+    auto compile_ids = batch.add_tasks(graph);
+    std::map<const compile_file_plan*, task_graph::task_id> compile_tasks;
+    for (auto&& [cf, id] : ranges::views::zip(compiles, compile_ids)) {
+        compile_tasks.emplace(&cf.get(), id);
+    }
+
+    // Each archive depends only on the object files that it contains
+    std::map<fs::path, task_graph::task_id> archive_tasks;
+    for (const library_plan& lib : iter_libraries(*this)) {
+        auto& arc = lib.archive_plan();
+        if (!arc) {
+            continue;
+        }
+        auto id = graph.add(flag_failure(archive_failed, [&env, &arc] { arc->archive(env); }));
+        for (const compile_file_plan& cf : arc->file_compilations()) {
+            graph.add_dependency(id, compile_tasks.at(&cf));
+        }
+        archive_tasks.emplace(env.output_root / arc->calc_archive_file_path(env.toolchain), id);
+    }
+
+    // Each executable depends on its entry point object, the archive of its owning library, and
+    // the archives of every library that it links against. Tests depend on their executable, and
+    // are prioritized by their expected duration.
+    auto                      test_schedule = schedule_tests(*this, env);
+    std::mutex                mut;
+    std::vector<test_failure> fails;
+    for (const library_plan& lib : iter_libraries(*this)) {
+        for (const link_executable_plan& exe : lib.executables()) {
+            auto link_id
+                = graph.add(flag_failure(link_failed, [&env, &exe, &lib] { exe.link(env, lib); }));
+            graph.add_dependency(link_id, compile_tasks.at(&exe.main_compile_file()));
+
+            std::vector<fs::path> link_inputs;
+            if (lib.archive_plan()) {
+                link_inputs.push_back(env.output_root
+                                      / lib.archive_plan()->calc_archive_file_path(env.toolchain));
+            }
+            for (const lm::usage& use : exe.links()) {
+                if (env.ureqs.get(use)) {
+                    extend(link_inputs, env.ureqs.link_paths(use));
+                }
+            }
+            sort_unique_erase(link_inputs);
+            for (auto& input : link_inputs) {
+                auto found = archive_tasks.find(input);
+                if (found != archive_tasks.end()) {
+                    graph.add_dependency(link_id, found->second);
+                }
+            }
+
+            if (!exe.is_test() || !test_schedule.at(&exe).selected) {
+                continue;
+            }
+            auto test_id = graph.add(
+                [&env, &exe, &mut, &fails] {
+                    auto fail_info = exe.run_test(env);
+                    if (fail_info) {
+                        std::scoped_lock lk{mut};
+                        fails.emplace_back(std::move(*fail_info));
+                    }
+                },
+                test_schedule.at(&exe).cost);
+            graph.add_dependency(test_id, link_id);
+        }
+    }
+
+    graph.run(njobs, env.memory_budget);
+
+    // Store dependency information for whatever compilations completed, even if others failed.
+    batch.finish();
+    cancellation_point();
+
+    if (batch.failed()) {
+        throw_user_error<errc::compile_failure>();
+    }
+    if (archive_failed) {
+        throw_external_error<errc::archive_failure>();
+    }
+    if (link_failed) {
+        BOOST_LEAF_THROW_EXCEPTION(make_user_error<errc::link_failure>(),
+                                   BPT_ERR_REF("link-failure"));
+    }
+    return fails;
+}
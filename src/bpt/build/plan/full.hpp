@@ -50,6 +50,14 @@ public:
      * Execute all tests defined in the plan. Returns information for every failed test.
      */
     std::vector<test_failure> run_all_tests(build_env_ref env, int njobs) const;
+
+    /**
+     * Compile, archive, link, and run tests for the entire plan as a single dependency-ordered
+     * task graph: Each archive is created as soon as its own object files are ready, each
+     * executable is linked as soon as its inputs exist, and each test is executed as soon as it is
+     * linked. Returns information for every failed test.
+     */
+    std::vector<test_failure> build_all(build_env_ref env, int njobs) const;
 };
 
 }  // namespace bpt
@@ -1,7 +1,9 @@
 #include "./library.hpp"
 
+#include <bpt/error/errors.hpp>
 #include <bpt/sdist/root.hpp>
 #include <bpt/util/algo.hpp>
+#include <bpt/util/fs/io.hpp>
 #include <bpt/util/log.hpp>
 
 #include <fansi/styled.hpp>
@@ -14,13 +16,123 @@
 #include <range/v3/view/filter.hpp>
 #include <range/v3/view/transform.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <functional>
 #include <ranges>
 #include <string>
 
 using namespace bpt;
 using namespace fansi::literals;
 
+namespace {
+
+/**
+ * Write the unity source file that #includes each of the given sources. The file is only written if
+ * its content would change, so that it does not appear newer than its prior compilation.
+ */
+void write_unity_source(path_ref unity_file, const std::vector<source_file>& sources) {
+    std::string content = "// This file was generated by bpt. DO NOT EDIT!\n";
+    for (auto& sf : sources) {
+        content += fmt::format("#include \"{}\"\n", sf.path.generic_string());
+    }
+    if (fs::exists(unity_file) && bpt::read_file(unity_file) == content) {
+        return;
+    }
+    bpt_log(trace, "Writing unity source file [{}]", unity_file.string());
+    fs::create_directories(unity_file.parent_path());
+    bpt::write_file(unity_file, content);
+}
+
+}  // namespace
+
+std::vector<compile_file_plan> bpt::combine_unity_sources(std::vector<compile_file_plan> compiles,
+                                                          const unity_build_params&      params,
+                                                          std::string_view               qual_name,
+                                                          path_ref                       out_dir) {
+    const auto unity_dir = params.out_root / out_dir / "unity";
+    auto       is_c      = [](const compile_file_plan& comp) {
+        return comp.source_path().extension() == ".c";
+    };
+    // A module interface must be the primary source file of its translation unit
+    auto is_module_interface = [](const compile_file_plan& comp) {
+        auto ext = comp.source_path().extension();
+        return ext == ".cppm" || ext == ".ixx" || ext == ".mpp";
+    };
+
+    std::vector<compile_file_plan> ret;
+    auto                           flush = [&](std::vector<compile_file_plan>& group) {
+        if (group.size() == 1) {
+            ret.push_back(std::move(group.front()));
+        } else if (!group.empty()) {
+            // Name the group for its first source, so that a group keeps its name (and its object
+            // file) when sources are added to or removed from other groups.
+            auto filename  = fmt::format("{}.unity{}",
+                                         group.front().source().relative_path().generic_string(),
+                                         is_c(group.front()) ? ".c" : ".cpp");
+            auto unity_src = source_file{
+                .path       = unity_dir / filename,
+                .basis_path = unity_dir,
+                .kind       = source_kind::source,
+            };
+            auto sources = group | ranges::views::transform(&compile_file_plan::source)
+                | ranges::to_vector;
+            bpt_log(debug,
+                    "Combining {} sources of {} into [{}]",
+                    sources.size(),
+                    qual_name,
+                    unity_src.path.string());
+            write_unity_source(unity_src.path, sources);
+            ret.emplace_back(group.front().rules(),
+                             std::move(unity_src),
+                             qual_name,
+                             out_dir / "unity",
+                             std::move(sources));
+        }
+        group.clear();
+    };
+
+    // Group the sources in a fixed order, since the order in which they were collected from the
+    // filesystem is unspecified. Otherwise the groups (and their object files) could change
+    // between builds of the same sources.
+    std::ranges::sort(compiles, std::less<>{}, [](const compile_file_plan& comp) {
+        return comp.source().relative_path().generic_string();
+    });
+    auto c_begin = std::ranges::stable_partition(compiles, std::not_fn(is_c)).begin();
+    for (auto part : {std::ranges::subrange(compiles.begin(), c_begin),
+                      std::ranges::subrange(c_begin, compiles.end())}) {
+        std::vector<compile_file_plan> group;
+        std::uintmax_t                 group_bytes = 0;
+        std::chrono::milliseconds      group_duration{0};
+        for (auto& comp : part) {
+            if (is_module_interface(comp)) {
+                ret.push_back(std::move(comp));
+                continue;
+            }
+            std::error_code ec;
+            auto            bytes = fs::file_size(comp.source_path(), ec);
+            if (ec) {
+                bytes = 0;
+            }
+            auto duration = params.recorded_duration ? params.recorded_duration(comp)
+                                                     : std::nullopt;
+            auto add_duration = duration.value_or(std::chrono::milliseconds{0});
+            if (!group.empty()
+                && (group_bytes + bytes > params.max_bytes
+                    || group_duration + add_duration > params.max_duration)) {
+                flush(group);
+                group_bytes    = 0;
+                group_duration = std::chrono::milliseconds{0};
+            }
+            group_bytes += bytes;
+            group_duration += add_duration;
+            group.push_back(std::move(comp));
+        }
+        flush(group);
+    }
+    return ret;
+}
+
 library_plan library_plan::create(path_ref                    pkg_base,
                                   const crs::package_info&    pkg,
                                   const crs::library_info&    lib,
@@ -35,13 +147,17 @@ library_plan library_plan::create(path_ref                    pkg_base,
     std::vector<source_file> header_sources;
     std::vector<source_file> public_header_sources;
 
+    auto collect_sources = [&](const bpt::source_root& root) {
+        return params.collect_sources ? params.collect_sources(root) : root.collect_sources();
+    };
+
     // Collect the source for this library. This will look for any compilable sources in the
     // `src/` subdirectory of the library.
     auto src_dir = bpt::source_root(pkg_base / lib.path / "src");
     if (src_dir.exists()) {
         // Sort each source file between the three source arrays, depending on
         // the kind of source that we are looking at.
-        auto all_sources = src_dir.collect_sources();
+        auto all_sources = collect_sources(src_dir);
         for (const auto& sfile : all_sources) {
             if (sfile.kind == source_kind::test) {
                 test_sources.push_back(sfile);
@@ -59,7 +175,7 @@ library_plan library_plan::create(path_ref                    pkg_base,
 
     auto include_dir = bpt::source_root{pkg_base / lib.path / "include"};
     if (include_dir.exists()) {
-        auto all_sources = include_dir.collect_sources();
+        auto all_sources = collect_sources(include_dir);
         for (const auto& sfile : all_sources) {
             if (!is_header(sfile.kind)) {
                 bpt_log(
@@ -117,6 +233,27 @@ library_plan library_plan::create(path_ref                    pkg_base,
         src_header_compile_rules.include_dirs().push_back(src_dir.path);
     }
 
+    // If the library has a precompiled header, it is created using the same rules as the library's
+    // sources, and every C++ compilation of the library's sources, tests, and apps will use it.
+    // (Header independence checks do not use it, as it would hide missing #includes.)
+    std::optional<compile_file_plan> pch_compile;
+    if (lib.precompiled_header) {
+        auto pch_path   = pkg_base / lib.path / *lib.precompiled_header;
+        auto pch_source = source_file::from_path(pch_path, pkg_base / lib.path);
+        if (!pch_source || !is_header(pch_source->kind) || !fs::is_regular_file(pch_path)) {
+            throw_user_error<errc::invalid_pkg_filesystem>(
+                "The precompiled header [{}] of library '{}' is not an existing header file",
+                pch_path.string(),
+                qual_name);
+        }
+        auto stub_path                        = out_dir / "pch" / pch_path.filename();
+        auto pch_rules                        = compile_rules.clone();
+        pch_rules.precompiled_header()        = stub_path;
+        pch_rules.create_precompiled_header() = true;
+        compile_rules.precompiled_header()    = stub_path;
+        pch_compile.emplace(pch_rules, *pch_source, qual_name, out_dir / "pch");
+    }
+
     // Convert the library sources into their respective file compilation plans.
     auto lib_compile_files =  //
         lib_sources           //
@@ -124,6 +261,12 @@ library_plan library_plan::create(path_ref                    pkg_base,
               return compile_file_plan(compile_rules, sf, qual_name, out_dir / "obj");
           })
         | ranges::to_vector;
+    if (params.unity) {
+        lib_compile_files = combine_unity_sources(std::move(lib_compile_files),
+                                                  *params.unity,
+                                                  qual_name,
+                                                  out_dir);
+    }
 
     // Run a syntax-only pass over headers to verify that headers can build in isolation.
     auto header_indep_plan = header_sources  //
@@ -146,7 +289,11 @@ library_plan library_plan::create(path_ref                    pkg_base,
     std::optional<create_archive_plan> archive_plan;
     if (!lib_compile_files.empty()) {
         bpt_log(debug, "Generating an archive library for {}", qual_name);
-        archive_plan.emplace(lib.name.str, qual_name, out_dir, std::move(lib_compile_files));
+        archive_plan.emplace(lib.name.str,
+                             qual_name,
+                             out_dir,
+                             std::move(lib_compile_files),
+                             pch_compile);
     } else {
         bpt_log(debug,
                 "Library {} has no compiled inputs, so no archive will be generated",
@@ -201,6 +348,7 @@ library_plan library_plan::create(path_ref                    pkg_base,
                         std::move(archive_plan),
                         std::move(link_executables),
                         std::move(header_indep_plan),
+                        std::move(pch_compile),
                         std::move(lib_uses)};
 }
 
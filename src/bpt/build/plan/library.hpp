@@ -2,6 +2,7 @@
 
 #include <bpt/build/plan/archive.hpp>
 #include <bpt/build/plan/exe.hpp>
+#include <bpt/sdist/root.hpp>
 #include <bpt/usage_reqs.hpp>
 #include <bpt/util/fs/path.hpp>
 
@@ -9,12 +10,47 @@
 
 #include <libman/library.hpp>
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <optional>
 #include <string>
 #include <vector>
 
 namespace bpt {
 
+/**
+ * The parameters for combining the sources of a library into unity compilations.
+ */
+struct unity_build_params {
+    /// The root of the build output. Unity source files are generated within the library's
+    /// subdirectory.
+    fs::path out_root;
+    /// The largest total size of the sources combined into a single unity compilation
+    std::uintmax_t max_bytes = 512 * 1024;
+    /// The largest total recorded compile time of the sources combined into a single unity
+    /// compilation. Sources with no recorded compile time only count against `max_bytes`.
+    std::chrono::milliseconds max_duration{10'000};
+    /// Obtain the recorded duration of compiling the given plan for an individual source, if known
+    std::function<std::optional<std::chrono::milliseconds>(const compile_file_plan&)>
+        recorded_duration;
+};
+
+/**
+ * Group the given compilations of library sources into generated unity source files. Each group
+ * takes the sources in order of their relative paths until adding another would exceed the size or
+ * duration limits of `params`, so the same sources always produce the same groups. C and C++
+ * sources are grouped separately. A group of a single source is compiled as-is, as are C++ module
+ * interface units.
+ *
+ * Each unity source is named for the relative path of the first source in its group, within the
+ * `unity` subdirectory of `out_dir`, and is written (if changed) before this function returns.
+ */
+std::vector<compile_file_plan> combine_unity_sources(std::vector<compile_file_plan> compiles,
+                                                     const unity_build_params&      params,
+                                                     std::string_view               qual_name,
+                                                     path_ref                       out_dir);
+
 /**
  * The parameters that tweak the behavior of building a library
  */
@@ -29,6 +65,11 @@ struct library_build_params {
     bool build_apps = false;
     /// Whether compiler warnings should be enabled for building the source files in this library.
     bool enable_warnings = false;
+    /// If set, the library's sources are combined into unity compilations
+    std::optional<unity_build_params> unity = std::nullopt;
+    /// If set, obtains the source files within the library's source roots in place of scanning the
+    /// directories, e.g. to reuse the listings that were recorded by a prior build
+    std::function<std::vector<source_file>(const source_root&)> collect_sources = nullptr;
 };
 
 /**
@@ -59,6 +100,8 @@ class library_plan {
     std::vector<link_executable_plan> _link_exes;
     /// The headers that must be checked for independence
     std::vector<compile_file_plan> _headers;
+    /// The compilation that creates the precompiled header of this library, if it has one
+    std::optional<compile_file_plan> _pch;
     /// Libraries used by this library
     std::vector<lm::usage> _lib_uses;
 
@@ -68,6 +111,8 @@ public:
      * @param lib The `library_root` object underlying this plan.
      * @param ar The `create_archive_plan`, or `nullopt` for this library.
      * @param exes The `link_executable_plan` objects for this library.
+     * @param headers The header independence checks for this library.
+     * @param pch The compilation of the library's precompiled header, or `nullopt`.
      */
     library_plan(std::string                        name,
                  path_ref                           lib_root,
@@ -76,6 +121,7 @@ public:
                  std::optional<create_archive_plan> ar,
                  std::vector<link_executable_plan>  exes,
                  std::vector<compile_file_plan>     headers,
+                 std::optional<compile_file_plan>   pch,
                  std::vector<lm::usage>             lib_uses)
         : _name(name)
         , _lib_root(lib_root)
@@ -84,6 +130,7 @@ public:
         , _create_archive(std::move(ar))
         , _link_exes(std::move(exes))
         , _headers(std::move(headers))
+        , _pch(std::move(pch))
         , _lib_uses(std::move(lib_uses)) {}
     std::string_view name() const noexcept { return _name; }
     /**
@@ -111,6 +158,11 @@ public:
      * The headers that should be checked for independence by this library
      */
     auto& headers() const noexcept { return _headers; }
+    /**
+     * The compilation that creates this library's precompiled header, if it has one. Every C++
+     * compilation of the library's sources, tests, and apps depends on it.
+     */
+    auto& precompiled_header() const noexcept { return _pch; }
     /**
      * The library identifiers that are used by this library
      */
@@ -0,0 +1,107 @@
+#include "./library.hpp"
+
+#include <bpt/temp.hpp>
+#include <bpt/util/fs/io.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct unity_fixture {
+    bpt::temporary_dir             tdir = bpt::temporary_dir::create();
+    bpt::shared_compile_file_rules rules;
+
+    bpt::compile_file_plan add(std::string name, std::size_t size) {
+        auto path = tdir.path() / "src" / name;
+        bpt::fs::create_directories(path.parent_path());
+        bpt::write_file(path, std::string(size, ' '));
+        auto sf = bpt::source_file{path, tdir.path() / "src", bpt::source_kind::source};
+        return bpt::compile_file_plan(rules, sf, "test/lib", "obj");
+    }
+
+    std::vector<std::string> combine(std::vector<bpt::compile_file_plan> compiles) {
+        auto params = bpt::unity_build_params{.out_root = tdir.path() / "_build", .max_bytes = 250};
+        auto groups = bpt::combine_unity_sources(std::move(compiles), params, "test/lib", "lib");
+        std::vector<std::string> ret;
+        for (auto& comp : groups) {
+            auto name = comp.source().relative_path().generic_string();
+            for (auto& member : comp.unity_sources()) {
+                name += " " + member.relative_path().generic_string();
+            }
+            ret.push_back(name);
+        }
+        return ret;
+    }
+};
+
+}  // namespace
+
+TEST_CASE_METHOD(unity_fixture, "Combine library sources into unity compilations") {
+    auto groups = combine({
+        add("a.cpp", 100),
+        add("b.c", 100),
+        add("sub/c.cpp", 100),
+        add("d.cpp", 100),
+        add("e.c", 100),
+        add("f.cppm", 10),
+        add("g.cpp", 300),
+    });
+    // Sources are grouped in order of their relative paths. C and C++ sources are grouped
+    // separately. Module interfaces, and groups of one, are compiled on their own.
+    CHECK(groups
+          == std::vector<std::string>{
+              "f.cppm",
+              "a.cpp.unity.cpp a.cpp d.cpp",
+              "g.cpp",
+              "sub/c.cpp",
+              "b.c.unity.c b.c e.c",
+          });
+    // The unity source is generated along with the plan
+    auto unity_file = tdir.path() / "_build/lib/unity/a.cpp.unity.cpp";
+    REQUIRE(bpt::fs::exists(unity_file));
+    CHECK(bpt::read_file(unity_file)
+          == "// This file was generated by bpt. DO NOT EDIT!\n"
+             "#include \"" + (tdir.path() / "src/a.cpp").generic_string() + "\"\n"
+             "#include \"" + (tdir.path() / "src/d.cpp").generic_string() + "\"\n");
+}
+
+TEST_CASE_METHOD(unity_fixture, "The same sources always produce the same unity compilations") {
+    std::vector<bpt::compile_file_plan> compiles = {
+        add("a.cpp", 100),
+        add("b.cpp", 100),
+        add("c/d.cpp", 100),
+        add("e.cpp", 100),
+        add("f.c", 100),
+    };
+    auto expect = std::vector<std::string>{
+        "a.cpp.unity.cpp a.cpp b.cpp",
+        "c/d.cpp.unity.cpp c/d.cpp e.cpp",
+        "f.c",
+    };
+    CHECK(combine(compiles) == expect);
+    std::ranges::reverse(compiles);
+    CHECK(combine(compiles) == expect);
+    std::ranges::rotate(compiles, compiles.begin() + 2);
+    CHECK(combine(compiles) == expect);
+}
+
+TEST_CASE_METHOD(unity_fixture, "Unity compilations are named for their first source") {
+    auto a = add("a.cpp", 100);
+    auto b = add("b.cpp", 100);
+    auto x = add("x.c", 100);
+    auto y = add("y.c", 100);
+    CHECK(combine({a, b, x, y})
+          == std::vector<std::string>{"a.cpp.unity.cpp a.cpp b.cpp", "x.c.unity.c x.c y.c"});
+    // Adding a source does not rename the groups that it does not join
+    auto z = add("z.cpp", 100);
+    CHECK(combine({a, b, z, x, y})
+          == std::vector<std::string>{
+              "a.cpp.unity.cpp a.cpp b.cpp",
+              "z.cpp",
+              "x.c.unity.c x.c y.c",
+          });
+}
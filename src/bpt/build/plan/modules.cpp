@@ -0,0 +1,201 @@
+#include "./modules.hpp"
+
+#include <bpt/build/module_deps.hpp>
+#include <bpt/build/plan/compile_exec.hpp>
+#include <bpt/error/errors.hpp>
+#include <bpt/util/log.hpp>
+#include <bpt/util/string.hpp>
+#include <bpt/util/trace.hpp>
+
+#include <fmt/core.h>
+
+#include <functional>
+#include <set>
+
+using namespace bpt;
+
+namespace {
+
+/// Whether the compilation is of a C++ translation unit, which may use modules
+bool may_use_modules(const compile_file_plan& plan) {
+    auto& rules = plan.rules();
+    return !rules.syntax_only() && !rules.create_precompiled_header()
+        && plan.source_path().extension() != ".c";
+}
+
+/// The qualified names of the libraries whose modules may be imported by the given compilation
+std::set<std::string> visible_libraries(const compile_file_plan& plan, build_env_ref env) {
+    std::set<std::string>  ret{plan.qualifier()};
+    std::vector<lm::usage> pending = plan.rules().uses();
+    while (!pending.empty()) {
+        auto use = std::move(pending.back());
+        pending.pop_back();
+        if (!ret.insert(fmt::format("{}/{}", use.namespace_, use.name)).second) {
+            continue;
+        }
+        if (auto lib = env.ureqs.get(use)) {
+            extend(pending, lib->uses);
+        }
+    }
+    return ret;
+}
+
+struct scanned_unit {
+    const compile_file_plan& plan;
+    fs::path                 object_file;
+    module_deps_info         deps;
+};
+
+}  // namespace
+
+module_graph module_graph::scan(const ref_vector<const compile_file_plan>& compiles,
+                                build_env_ref                              env,
+                                int                                        njobs) {
+    trace::slice trace_slice{"phase", "Scan module dependencies"};
+
+    ref_vector<const compile_file_plan> scanned;
+    std::vector<compile_file_plan>      scan_plans;
+    for (const compile_file_plan& plan : compiles) {
+        if (may_use_modules(plan)) {
+            scanned.push_back(plan);
+            scan_plans.push_back(plan.module_scan_plan());
+        }
+    }
+
+    // Scans are executed (and recorded in the database) as any other compilation, so a file is
+    // only scanned again once it has changed.
+    if (!bpt::compile_all(scan_plans, env, njobs)) {
+        throw_user_error<errc::compile_failure>("Scanning for C++ module dependencies failed");
+    }
+
+    std::vector<scanned_unit> units;
+    units.reserve(scanned.size());
+    for (std::size_t idx = 0; idx < scanned.size(); ++idx) {
+        const compile_file_plan& plan = scanned[idx];
+        units.push_back(scanned_unit{
+            plan,
+            plan.calc_object_file_path(env),
+            parse_p1689_file(scan_plans[idx].calc_object_file_path(env), plan.source_path()),
+        });
+    }
+
+    // Find the unit that provides each module. Module implementation units do not generate a BMI,
+    // but module partitions always do.
+    std::map<std::string, const scanned_unit*> providers;
+    for (auto& unit : units) {
+        auto& name = unit.deps.provides;
+        if (!name || (!unit.deps.is_interface && name->find(':') == std::string::npos)) {
+            continue;
+        }
+        auto [it, added] = providers.emplace(*name, &unit);
+        if (!added) {
+            throw_user_error<errc::compile_failure>(
+                "C++ module '{}' is provided by both [{}] and [{}]",
+                *name,
+                it->second->plan.source_path().string(),
+                unit.plan.source_path().string());
+        }
+    }
+
+    const auto bmi_dir = env.output_root / "bmi";
+    fs::create_directories(bmi_dir);
+    auto bmi_of = [&](const std::string& name) {
+        return module_bmi{name, env.toolchain.module_bmi_file(name, bmi_dir)};
+    };
+
+    module_graph ret;
+    for (auto& unit : units) {
+        module_graph::unit mod_unit;
+        if (unit.deps.provides) {
+            auto found = providers.find(*unit.deps.provides);
+            if (found != providers.end() && found->second == &unit) {
+                mod_unit.output = bmi_of(*unit.deps.provides);
+                env.db.record_module_bmi(*unit.deps.provides,
+                                         mod_unit.output->bmi_path,
+                                         unit.plan.source_path());
+            }
+        }
+        std::optional<std::set<std::string>> visible;
+        for (auto& imp : unit.deps.imports) {
+            auto found = providers.find(imp);
+            if (found == providers.end()) {
+                // The provider may not be part of this build (e.g. when only compiling selected
+                // files), in which case we can use the BMI that was generated by a prior build.
+                auto recorded = env.db.module_bmi(imp);
+                if (!recorded || !fs::exists(recorded->bmi_path)) {
+                    throw_user_error<errc::compile_failure>(
+                        "[{}] imports C++ module '{}', but no library provides that module",
+                        unit.plan.source_path().string(),
+                        imp);
+                }
+                bpt_log(debug,
+                        "Using the BMI of module '{}' from a prior build: [{}]",
+                        imp,
+                        recorded->bmi_path.string());
+                mod_unit.imports.push_back(module_bmi{imp, recorded->bmi_path});
+                continue;
+            }
+            auto& provider = *found->second;
+            if (!visible) {
+                visible = visible_libraries(unit.plan, env);
+            }
+            if (!visible->contains(provider.plan.qualifier())) {
+                throw_user_error<errc::compile_failure>(
+                    "[{}] imports C++ module '{}', but the library that provides it ({}) is not "
+                    "used by {}",
+                    unit.plan.source_path().string(),
+                    imp,
+                    provider.plan.qualifier(),
+                    unit.plan.qualifier());
+            }
+            mod_unit.imports.push_back(bmi_of(imp));
+            mod_unit.providers.push_back(provider.object_file);
+        }
+        if (mod_unit.output || !mod_unit.imports.empty()) {
+            ret._units.emplace(unit.object_file, std::move(mod_unit));
+        }
+    }
+
+    // The BMIs must be generated in order, so the imports cannot form a cycle
+    std::map<fs::path, const scanned_unit*> unit_of_object;
+    for (auto& unit : units) {
+        unit_of_object.emplace(unit.object_file, &unit);
+    }
+    enum class visit_state { active, done };
+    std::map<fs::path, visit_state> states;
+    std::vector<std::string>        chain;
+    std::function<void(path_ref)>   visit = [&](path_ref object_file) {
+        auto [it, added] = states.emplace(object_file, visit_state::active);
+        auto& unit       = *unit_of_object.at(object_file);
+        chain.push_back(unit.deps.provides.value_or(unit.plan.source_path().string()));
+        if (!added) {
+            if (it->second == visit_state::active) {
+                throw_user_error<errc::compile_failure>("C++ module imports form a cycle: {}",
+                                                        bpt::joinstr(" -> ", chain));
+            }
+            chain.pop_back();
+            return;
+        }
+        if (auto mod_unit = ret.find(object_file)) {
+            for (auto& provider : mod_unit->providers) {
+                visit(provider);
+            }
+        }
+        it->second = visit_state::done;
+        chain.pop_back();
+    };
+    for (auto& unit : units) {
+        visit(unit.object_file);
+    }
+
+    bpt_log(debug, "Scanned {} files for C++ module dependencies", units.size());
+    return ret;
+}
+
+const module_graph::unit* module_graph::find(path_ref object_file) const noexcept {
+    auto found = _units.find(object_file);
+    if (found == _units.end()) {
+        return nullptr;
+    }
+    return &found->second;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <bpt/build/plan/base.hpp>
+#include <bpt/build/plan/compile_file.hpp>
+#include <bpt/util/algo.hpp>
+
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace bpt {
+
+/**
+ * The C++ module dependencies between the compilations of a build, as discovered by scanning each
+ * source file. Compilations are identified by the path of their object file.
+ */
+class module_graph {
+public:
+    /**
+     * The module dependencies of a single compilation
+     */
+    struct unit {
+        /// The module that the compilation exports, and the BMI that it will generate
+        std::optional<module_bmi> output;
+        /// The modules that the compilation imports, and the BMIs from which they are imported
+        std::vector<module_bmi> imports;
+        /// The object files of the compilations that generate the imported BMIs. Imports whose BMI
+        /// was generated by a prior build are not listed.
+        std::vector<fs::path> providers;
+    };
+
+private:
+    std::map<fs::path, unit> _units;
+
+public:
+    /**
+     * Scan the given compilations for their module dependencies, and resolve each import to the
+     * compilation that provides it. A compilation may only import the modules provided by its own
+     * library, or by the libraries that it (transitively) uses.
+     *
+     * Throws if a scan fails, if an import cannot be resolved, or if the imports form a cycle.
+     *
+     * @param compiles The compilations of the build
+     * @param env The build environment. The toolchain must support modules.
+     * @param njobs The maximum number of scans to execute in parallel
+     */
+    static module_graph
+    scan(const ref_vector<const compile_file_plan>& compiles, build_env_ref env, int njobs);
+
+    /**
+     * Obtain the module dependencies of the compilation that generates the given object file, if
+     * it uses modules.
+     */
+    const unit* find(path_ref object_file) const noexcept;
+};
+
+}  // namespace bpt
@@ -0,0 +1,102 @@
+#include "./report.hpp"
+
+#include <bpt/sdist/file.hpp>
+
+#include <algorithm>
+#include <map>
+
+using namespace bpt;
+
+namespace {
+
+/// The minimum number of compilations that must include a header for it to be a PCH candidate
+constexpr std::size_t pch_min_fan_in = 3;
+
+bool is_main_source(path_ref p) {
+    auto kind = infer_source_kind(p);
+    return kind.has_value() && !is_header(*kind);
+}
+
+/// Whether the given input of a compilation is a header that was included by the preprocessor
+bool is_header_input(path_ref p) {
+    auto kind = infer_source_kind(p);
+    if (kind.has_value()) {
+        return is_header(*kind);
+    }
+    // Standard library headers have no extension. Precompiled headers, module interfaces, and the
+    // inputs of archives and links all do.
+    return !p.has_extension();
+}
+
+/**
+ * Whether the given output was produced by a step that is not a compilation: a dependency scan or
+ * the creation of a precompiled header. (Archives and links are recognized by their lack of a main
+ * source input.)
+ */
+bool is_auxiliary_output(path_ref p) {
+    auto ext = p.extension();
+    return ext == ".ddi" || ext == ".gch" || ext == ".pch";
+}
+
+}  // namespace
+
+build_report build_report::generate(const database& db) {
+    build_report ret;
+
+    std::map<fs::path, header> headers;
+    std::size_t                n_full_compiles = 0;
+    for (auto& [output, rec] : db.all_compilations()) {
+        if (is_auxiliary_output(output)) {
+            continue;
+        }
+        translation_unit tu{
+            .source          = {},
+            .output          = output,
+            .is_header_check = false,
+            .duration        = rec.command.duration,
+            .usage           = rec.command.usage,
+        };
+        for (auto& input : rec.inputs) {
+            if (input.path.extension() == ".syncheck") {
+                // The checked header is the only file included by the syntax check file. We can't
+                // tell it apart from the headers that it includes, so use the check file itself.
+                tu.source          = input.path;
+                tu.is_header_check = true;
+            } else if (is_main_source(input.path) && tu.source.empty()) {
+                tu.source = input.path;
+            }
+        }
+        if (tu.source.empty()) {
+            // Archives and executables are recorded in the same tables, but have no main source
+            continue;
+        }
+        ret.total_compile_time += tu.duration;
+
+        if (!tu.is_header_check) {
+            ++n_full_compiles;
+            for (auto& input : rec.inputs) {
+                if (input.path == tu.source || !is_header_input(input.path)) {
+                    continue;
+                }
+                auto& hdr = headers[input.path];
+                hdr.path  = input.path;
+                ++hdr.fan_in;
+                hdr.includer_time += tu.duration;
+            }
+        }
+        ret.translation_units.push_back(std::move(tu));
+    }
+
+    std::ranges::stable_sort(ret.translation_units,
+                             std::ranges::greater{},
+                             &translation_unit::duration);
+
+    const auto pch_fan_in = (std::max)(pch_min_fan_in, (n_full_compiles + 3) / 4);
+    for (auto& [path, hdr] : headers) {
+        hdr.cost          = hdr.fan_in * static_cast<std::uint64_t>(hdr.includer_time.count());
+        hdr.pch_candidate = hdr.fan_in >= pch_fan_in;
+        ret.headers.push_back(std::move(hdr));
+    }
+    std::ranges::stable_sort(ret.headers, std::ranges::greater{}, &header::cost);
+    return ret;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <bpt/db/database.hpp>
+#include <bpt/util/fs/path.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace bpt {
+
+/**
+ * A summary of where build time is spent, generated from the compilations recorded in a build
+ * database.
+ */
+struct build_report {
+    /// A single recorded compilation
+    struct translation_unit {
+        /// The main source file of the compilation
+        fs::path source;
+        /// The output of the compilation
+        fs::path output;
+        /// Whether this compilation was a header syntax check
+        bool is_header_check = false;
+        /// The recorded average duration of the compilation
+        std::chrono::milliseconds duration{0};
+        /// The resources used by the most recent measured compilation
+        proc_resource_usage usage{};
+    };
+
+    /// A header file and the compilations that include it
+    struct header {
+        fs::path path;
+        /// The number of compilations that include this header
+        std::size_t fan_in = 0;
+        /// The summed duration of the compilations that include this header
+        std::chrono::milliseconds includer_time{0};
+        /// The estimated cost of this header to the build: `fan_in` times `includer_time`
+        std::uint64_t cost = 0;
+        /// Whether this header would be a good candidate for a precompiled header
+        bool pch_candidate = false;
+    };
+
+    /// Every recorded compilation, slowest first
+    std::vector<translation_unit> translation_units;
+    /// Every header included by a recorded compilation, costliest first
+    std::vector<header> headers;
+    /// The sum of the durations of every recorded compilation
+    std::chrono::milliseconds total_compile_time{0};
+
+    /**
+     * Generate a report from the compilations recorded in the given database.
+     *
+     * Only the recorded outputs that were compiled from a source file are reported. Archives,
+     * executables, module dependency scans, and precompiled headers are skipped, and only the
+     * header inputs of a compilation are counted as headers.
+     *
+     * Header syntax checks are ranked along with the other compilations, but do not contribute to
+     * the fan-in of headers. A header is considered a precompiled header candidate if it is
+     * included by at least a quarter of the compilations, and by at least three of them.
+     */
+    static build_report generate(const database& db);
+};
+
+}  // namespace bpt
@@ -0,0 +1,68 @@
+#include "./report.hpp"
+
+#include <catch2/catch.hpp>
+
+using namespace std::literals;
+
+namespace {
+
+void record(bpt::database&                          db,
+            const std::string&                      output,
+            int                                     ms,
+            std::initializer_list<std::string_view> inputs) {
+    db.record_compilation(output, {"compile", "", 0, std::chrono::milliseconds(ms)});
+    for (auto in : inputs) {
+        db.record_dep(in, output, {});
+    }
+}
+
+}  // namespace
+
+TEST_CASE("Generate a build report") {
+    auto db = bpt::database::open(":memory:"s);
+    record(db, "/out/a.o", 100, {"/src/a.cpp", "/src/common.hpp", "/src/a.hpp"});
+    record(db, "/out/b.o", 300, {"/src/b.cpp", "/src/common.hpp"});
+    record(db, "/out/c.o", 200, {"/src/c.cpp", "/src/common.hpp", "/src/a.hpp"});
+    record(db, "/out/a.hpp.o", 50, {"/out/a.hpp.syncheck", "/src/a.hpp"});
+    // None of these are compilations
+    record(db, "/out/liba.a", 40, {"/out/a.o", "/out/b.o", "/out/c.o"});
+    record(db, "/out/app", 70, {"/out/app.o", "/out/liba.a"});
+    record(db, "/out/a.o.ddi", 10, {"/src/a.cpp", "/src/common.hpp"});
+    record(db, "/out/pch.hpp.gch", 90, {"/src/pch.hpp", "/src/common.hpp"});
+    // Only headers count towards fan-in, not the precompiled header or the module interfaces
+    record(db,
+           "/out/d.o",
+           20,
+           {"/src/d.cpp", "/out/pch.hpp.gch", "/out/m.gcm", "/usr/include/vector"});
+
+    auto report = bpt::build_report::generate(db);
+    CHECK(report.total_compile_time == 670ms);
+
+    REQUIRE(report.translation_units.size() == 5);
+    CHECK(report.translation_units[0].source == "/src/b.cpp");
+    CHECK(report.translation_units[0].output == "/out/b.o");
+    CHECK(report.translation_units[1].source == "/src/c.cpp");
+    CHECK(report.translation_units[2].source == "/src/a.cpp");
+    CHECK(report.translation_units[3].is_header_check);
+    CHECK(report.translation_units[3].source == "/out/a.hpp.syncheck");
+    CHECK(report.translation_units[4].source == "/src/d.cpp");
+
+    // The syntax check does not contribute to the fan-in of a.hpp
+    REQUIRE(report.headers.size() == 3);
+    auto& common = report.headers[0];
+    CHECK(common.path == "/src/common.hpp");
+    CHECK(common.fan_in == 3);
+    CHECK(common.includer_time == 600ms);
+    CHECK(common.cost == 1800);
+    CHECK(common.pch_candidate);
+
+    auto& a_hpp = report.headers[1];
+    CHECK(a_hpp.path == "/src/a.hpp");
+    CHECK(a_hpp.fan_in == 2);
+    CHECK(a_hpp.includer_time == 300ms);
+    CHECK_FALSE(a_hpp.pch_candidate);
+
+    auto& vector = report.headers[2];
+    CHECK(vector.path == "/usr/include/vector");
+    CHECK(vector.fan_in == 1);
+}
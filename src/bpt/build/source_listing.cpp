@@ -0,0 +1,75 @@
+#include "./source_listing.hpp"
+
+#include <bpt/util/log.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace bpt;
+
+namespace {
+
+/**
+ * The coarsest granularity of the modification times of the supported filesystems (FAT records
+ * them in units of two seconds). A directory that is modified again within the same tick keeps the
+ * same modification time.
+ */
+constexpr auto mtime_granularity = std::chrono::seconds{2};
+
+std::optional<fs::file_time_type> dir_mtime(path_ref dir) noexcept {
+    std::error_code ec;
+    auto            mtime = fs::last_write_time(dir, ec);
+    if (ec) {
+        return std::nullopt;
+    }
+    return mtime;
+}
+
+bool listing_is_current(path_ref root, const recorded_source_listing& listing) {
+    return !listing.directories.empty()
+        && std::ranges::all_of(listing.directories, [&](const auto& dir) {
+               // If the directory was modified within a tick of the scan, it may have been modified
+               // again after it was scanned without its time changing
+               return dir.second + mtime_granularity < listing.scan_time
+                   && dir_mtime(root / dir.first) == dir.second;
+           });
+}
+
+}  // namespace
+
+std::vector<source_file> bpt::collect_sources_cached(database& db, const source_root& root) {
+    std::vector<source_file> ret;
+    if (auto prior = db.source_listing(root.path); prior && listing_is_current(root.path, *prior)) {
+        bpt_log(trace, "Using the recorded listing of [{}]", root.path.string());
+        for (auto& file : prior->files) {
+            if (auto sfile = source_file::from_path(root.path / file, root.path)) {
+                ret.push_back(std::move(*sfile));
+            }
+        }
+        return ret;
+    }
+
+    bpt_log(trace, "Scanning for source files in [{}]", root.path.string());
+    recorded_source_listing listing;
+    listing.scan_time = fs::file_time_type::clock::now();
+    auto root_mtime   = dir_mtime(root.path);
+    if (!root_mtime) {
+        return root.collect_sources();
+    }
+    // Directory times are read before their entries, so that a concurrent modification will
+    // invalidate the listing that we record.
+    listing.directories.emplace_back(".", *root_mtime);
+    for (auto& entry : fs::recursive_directory_iterator{root.path}) {
+        auto relpath = entry.path().lexically_relative(root.path);
+        if (entry.is_directory()) {
+            listing.directories.emplace_back(std::move(relpath), entry.last_write_time());
+        } else if (entry.is_regular_file()) {
+            if (auto sfile = source_file::from_path(entry.path(), root.path)) {
+                listing.files.push_back(std::move(relpath));
+                ret.push_back(std::move(*sfile));
+            }
+        }
+    }
+    db.record_source_listing(root.path, listing);
+    return ret;
+}
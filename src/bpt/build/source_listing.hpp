@@ -0,0 +1,22 @@
+#pragma once
+
+#include <bpt/db/database.hpp>
+#include <bpt/sdist/root.hpp>
+
+#include <vector>
+
+namespace bpt {
+
+/**
+ * Collect the source files within the given source root, as with `source_root::collect_sources()`.
+ *
+ * Adding, removing, or renaming a file changes the modification time of the directory that
+ * contains it. If no directory within the root has been modified since the listing that a prior
+ * build recorded in the database, the files of that listing are returned without scanning the root.
+ * Otherwise the root is scanned, and the new listing is recorded. A directory that was modified
+ * within the timestamp granularity of the filesystem before the scan is always scanned again, as a
+ * later change in the same tick would not have changed its time.
+ */
+std::vector<source_file> collect_sources_cached(database& db, const source_root& root);
+
+}  // namespace bpt
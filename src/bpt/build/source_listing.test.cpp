@@ -0,0 +1,42 @@
+#include "./source_listing.hpp"
+
+#include <bpt/temp.hpp>
+#include <bpt/util/fs/io.hpp>
+
+#include <catch2/catch.hpp>
+
+using namespace std::literals;
+
+TEST_CASE("Reuse the listing of an unmodified source root") {
+    auto tdir = bpt::temporary_dir::create();
+    auto db   = bpt::database::open(":memory:"s);
+    auto root = bpt::source_root{tdir.path()};
+    bpt::write_file(tdir.path() / "a.cpp", "");
+    auto old_mtime = bpt::fs::file_time_type::clock::now() - 1h;
+    bpt::fs::last_write_time(tdir.path(), old_mtime);
+    CHECK(bpt::collect_sources_cached(db, root).size() == 1);
+
+    // The recorded listing is used, so a file that was added without changing the time of its
+    // directory is not seen
+    bpt::write_file(tdir.path() / "b.cpp", "");
+    bpt::fs::last_write_time(tdir.path(), old_mtime);
+    CHECK(bpt::collect_sources_cached(db, root).size() == 1);
+
+    // Once the time of the directory changes, it is scanned again
+    bpt::fs::last_write_time(tdir.path(), old_mtime + 1s);
+    CHECK(bpt::collect_sources_cached(db, root).size() == 2);
+}
+
+TEST_CASE("Rescan a source root that was modified just before it was scanned") {
+    auto tdir = bpt::temporary_dir::create();
+    auto db   = bpt::database::open(":memory:"s);
+    auto root = bpt::source_root{tdir.path()};
+    bpt::write_file(tdir.path() / "a.cpp", "");
+    CHECK(bpt::collect_sources_cached(db, root).size() == 1);
+
+    // A file added within the same timestamp tick leaves the time of the directory unchanged
+    auto mtime = bpt::fs::last_write_time(tdir.path());
+    bpt::write_file(tdir.path() / "b.cpp", "");
+    bpt::fs::last_write_time(tdir.path(), mtime);
+    CHECK(bpt::collect_sources_cached(db, root).size() == 2);
+}
@@ -0,0 +1,63 @@
+#include "./test_schedule.hpp"
+
+#include <bpt/util/siphash.hpp>
+
+#include <algorithm>
+#include <charconv>
+
+using namespace bpt;
+using std::chrono::microseconds;
+
+namespace {
+
+/// Obtain the given percentile of the durations, using the nearest-rank method
+microseconds percentile(std::vector<microseconds> durations, int pct) noexcept {
+    std::ranges::sort(durations);
+    auto rank = (durations.size() * pct + 99) / 100;
+    return durations[std::max<std::size_t>(rank, 1) - 1];
+}
+
+}  // namespace
+
+std::optional<test_shard> test_shard::parse(std::string_view str) noexcept {
+    auto slash = str.find('/');
+    if (slash == str.npos) {
+        return std::nullopt;
+    }
+    auto parse_int = [](std::string_view s) -> std::optional<int> {
+        int  ret = 0;
+        auto res = std::from_chars(s.data(), s.data() + s.size(), ret);
+        if (res.ec != std::errc{} || res.ptr != s.data() + s.size()) {
+            return std::nullopt;
+        }
+        return ret;
+    };
+    auto index = parse_int(str.substr(0, slash));
+    auto count = parse_int(str.substr(slash + 1));
+    if (!index || !count || *count < 1 || *index < 1 || *index > *count) {
+        return std::nullopt;
+    }
+    return test_shard{*index, *count};
+}
+
+std::optional<microseconds>
+bpt::expected_test_duration(const std::vector<microseconds>& history) noexcept {
+    if (history.empty()) {
+        return std::nullopt;
+    }
+    // The median is not thrown off by the occasional run on a busy machine
+    return percentile(history, 50);
+}
+
+std::chrono::milliseconds bpt::test_timeout(const std::vector<microseconds>& history) noexcept {
+    if (history.empty()) {
+        return min_test_timeout;
+    }
+    auto timeout = std::chrono::ceil<std::chrono::milliseconds>(percentile(history, 95) * 5);
+    return std::max(timeout, min_test_timeout);
+}
+
+int bpt::assign_test_shard(std::string_view key, int count) noexcept {
+    auto hash = siphash64(42, 1729, neo::const_buffer(key)).digest();
+    return static_cast<int>(hash % static_cast<std::uint64_t>(count));
+}
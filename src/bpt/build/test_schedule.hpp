@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace bpt {
+
+/**
+ * Selects a subset of the tests of a build, so that the tests can be split between several
+ * machines. Shards are numbered from one.
+ */
+struct test_shard {
+    /// The shard to run, from one to `count`
+    int index = 1;
+    /// The number of shards
+    int count = 1;
+
+    /**
+     * Parse a string of the form `<index>/<count>`, e.g. `2/4`. Returns `nullopt` if the string is
+     * invalid, or if the index is not within the count.
+     */
+    static std::optional<test_shard> parse(std::string_view str) noexcept;
+};
+
+/**
+ * Estimate the duration of the next run of a test from the durations of its recent runs, or
+ * `nullopt` if the test has no recorded runs.
+ */
+std::optional<std::chrono::microseconds>
+expected_test_duration(const std::vector<std::chrono::microseconds>& history) noexcept;
+
+/**
+ * Calculate the timeout for the next run of a test from the durations of its recent runs: Five
+ * times the 95th percentile of the recorded durations, but never less than `min_test_timeout`.
+ */
+std::chrono::milliseconds
+test_timeout(const std::vector<std::chrono::microseconds>& history) noexcept;
+
+/// The timeout of a test that has no (or only short) recorded runs
+inline constexpr std::chrono::milliseconds min_test_timeout = std::chrono::seconds(10);
+
+/**
+ * Assign a test to one of `count` shards, using a stable hash of the given key. The key should be
+ * the path of the test executable relative to the build directory, with forward slashes.
+ *
+ * The assignment depends only on the key and the count, so every machine computes the same
+ * assignment, regardless of the test durations that it has recorded.
+ *
+ * @returns The zero-based shard of the test
+ */
+int assign_test_shard(std::string_view key, int count) noexcept;
+
+}  // namespace bpt
@@ -0,0 +1,57 @@
+#include <bpt/build/test_schedule.hpp>
+
+#include <catch2/catch.hpp>
+
+using namespace std::chrono_literals;
+using std::chrono::microseconds;
+
+TEST_CASE("Parse test shards") {
+    auto shard = bpt::test_shard::parse("2/4");
+    REQUIRE(shard);
+    CHECK(shard->index == 2);
+    CHECK(shard->count == 4);
+    CHECK(bpt::test_shard::parse("1/1"));
+
+    CHECK_FALSE(bpt::test_shard::parse(""));
+    CHECK_FALSE(bpt::test_shard::parse("2"));
+    CHECK_FALSE(bpt::test_shard::parse("0/4"));
+    CHECK_FALSE(bpt::test_shard::parse("5/4"));
+    CHECK_FALSE(bpt::test_shard::parse("1/0"));
+    CHECK_FALSE(bpt::test_shard::parse("1/4x"));
+    CHECK_FALSE(bpt::test_shard::parse("-1/4"));
+}
+
+TEST_CASE("Test timeouts adapt to recorded durations") {
+    CHECK(bpt::test_timeout({}) == bpt::min_test_timeout);
+    // Short tests still get the minimum timeout
+    CHECK(bpt::test_timeout({microseconds(1ms), microseconds(3ms)}) == bpt::min_test_timeout);
+    // Five times the 95th percentile. One outlier in twenty runs is ignored.
+    std::vector<microseconds> history(19, microseconds(8s));
+    history.push_back(microseconds(60s));
+    CHECK(bpt::test_timeout(history) == 40s);
+    history.push_back(microseconds(60s));
+    CHECK(bpt::test_timeout(history) == 300s);
+
+    CHECK_FALSE(bpt::expected_test_duration({}));
+    CHECK(bpt::expected_test_duration({microseconds(1s), microseconds(9s), microseconds(2s)})
+          == microseconds(2s));
+}
+
+TEST_CASE("Assign tests to shards") {
+    std::vector<int> counts(3);
+    for (auto i = 0; i < 300; ++i) {
+        auto key   = "test/test-" + std::to_string(i);
+        auto shard = bpt::assign_test_shard(key, 3);
+        REQUIRE(shard >= 0);
+        REQUIRE(shard < 3);
+        // The same test is always assigned to the same shard
+        CHECK(bpt::assign_test_shard(key, 3) == shard);
+        ++counts[static_cast<std::size_t>(shard)];
+    }
+    // The tests are spread over every shard
+    for (auto n : counts) {
+        CHECK(n > 50);
+    }
+
+    CHECK(bpt::assign_test_shard("test/only", 1) == 0);
+}
@@ -3,21 +3,60 @@
 #include "./build_common.hpp"
 
 #include <bpt/build/builder.hpp>
+#include <bpt/build/object_cache.hpp>
 #include <bpt/error/errors.hpp>
 #include <bpt/toolchain/from_json.hpp>
+#include <bpt/util/log.hpp>
+#include <bpt/util/trace.hpp>
+
+#include <neo/scope.hpp>
 
 using namespace bpt;
 
 namespace bpt::cli::cmd {
 
+/// Write the requested build trace, if any. Failing to write the trace does not fail the build.
+static void write_trace_file(const options& opts) noexcept {
+    if (!opts.build.trace_file) {
+        return;
+    }
+    try {
+        trace::write_file(*opts.build.trace_file);
+    } catch (const std::exception& e) {
+        bpt_log(warn,
+                "Failed to write the build trace to [{}]: {}",
+                opts.build.trace_file->string(),
+                e.what());
+    }
+}
+
 static int _build(const options& opts) {
+    if (opts.build.trace_file) {
+        trace::start_recording();
+    }
+    // Write the trace even if the build fails, as it may help to explain the failure
+    neo_defer { write_trace_file(opts); };
+
     auto builder = create_project_builder(opts);
+
+    std::optional<fs::path> object_cache_dir = opts.build.object_cache_dir;
+    if (opts.build.object_cache && !object_cache_dir) {
+        object_cache_dir = object_cache::default_path();
+    }
+
     builder.build({
-        .out_root        = opts.out_path.value_or(fs::current_path() / "_build"),
-        .emit_built_json = std::nullopt,
-        .tweaks_dir      = opts.build.tweaks_dir,
-        .toolchain       = opts.load_toolchain(),
-        .parallel_jobs   = opts.jobs,
+        .out_root              = opts.out_path.value_or(fs::current_path() / "_build"),
+        .emit_built_json       = std::nullopt,
+        .tweaks_dir            = opts.build.tweaks_dir,
+        .toolchain             = opts.load_toolchain(),
+        .parallel_jobs         = opts.jobs,
+        .content_hash          = opts.build.content_hash,
+        .object_cache_dir      = object_cache_dir,
+        .object_cache_max_size = std::uint64_t(opts.build.object_cache_max_mb) * 1024 * 1024,
+        .memory_budget         = std::uint64_t(opts.build.memory_budget_mb) * 1024 * 1024,
+        .unity_build           = opts.build.unity,
+        .rerun_tests           = opts.build.rerun_tests,
+        .test_shard            = opts.build.test_shard,
     });
 
     return 0;
@@ -15,6 +15,7 @@
 #include <bpt/util/algo.hpp>
 #include <bpt/util/fs/io.hpp>
 #include <bpt/util/tl.hpp>
+#include <bpt/util/trace.hpp>
 
 #include <boost/leaf/pred.hpp>
 #include <fansi/styled.hpp>
@@ -60,7 +61,10 @@ builder bpt::cli::create_project_builder(const bpt::cli::options& opts) {
                        | std::views::join);
         }
 
-        auto sln = bpt::solve(meta_db, crs_deps);
+        auto sln = [&] {
+            trace::slice trace_slice{"phase", "Solve dependencies"};
+            return bpt::solve(meta_db, crs_deps);
+        }();
         for (auto&& pkg : sln) {
             fetch_cache_load_dependency(cache,
                                         pkg,
@@ -82,7 +86,11 @@ crs::package_info bpt::cli::fetch_cache_load_dependency(crs::cache&        cache
                                                         bpt::builder&      builder,
                                                         path_ref           subdir_base) {
     bpt_log(debug, "Loading package '{}' for build", pkg.to_string());
-    auto local_dir        = cache.prefetch(pkg);
+    auto local_dir = [&] {
+        trace::slice trace_slice{"phase", "Prefetch package", pkg.to_string()};
+        return cache.prefetch(pkg);
+    }();
+
     auto pkg_json_path    = local_dir / "pkg.json";
     auto pkg_json_content = bpt::read_file(pkg_json_path);
     BPT_E_SCOPE(crs::e_pkg_json_path{pkg_json_path});
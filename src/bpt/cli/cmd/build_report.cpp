@@ -0,0 +1,87 @@
+#include "../options.hpp"
+
+#include <bpt/build/report.hpp>
+#include <bpt/util/log.hpp>
+
+#include <fansi/styled.hpp>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <ranges>
+
+using namespace fansi::literals;
+
+namespace bpt::cli::cmd {
+
+namespace {
+
+std::string display_path(path_ref p) { return p.lexically_proximate(fs::current_path()).string(); }
+
+void print_translation_units(const bpt::build_report& report, std::size_t limit) {
+    fmt::print("\n.bold[Slowest compilations:]\n"_styled);
+    auto n_shown = (std::min)(limit, report.translation_units.size());
+    for (auto& tu : report.translation_units | std::views::take(n_shown)) {
+        auto share = report.total_compile_time.count()
+            ? 100.0 * double(tu.duration.count()) / double(report.total_compile_time.count())
+            : 0.0;
+        fmt::print("  .cyan[{:>8}ms] {:>5.1f}%  {}{}\n"_styled,
+                   tu.duration.count(),
+                   share,
+                   display_path(tu.source),
+                   tu.is_header_check ? " (header check)" : "");
+        if (tu.usage.peak_rss) {
+            fmt::print("              peak memory: {} MiB\n", tu.usage.peak_rss / (1024 * 1024));
+        }
+    }
+}
+
+void print_headers(const bpt::build_report& report, std::size_t limit) {
+    fmt::print("\n.bold[Costliest headers:] (includers × their compile time)\n"_styled);
+    auto n_shown = (std::min)(limit, report.headers.size());
+    for (auto& hdr : report.headers | std::views::take(n_shown)) {
+        fmt::print("  .cyan[{:>4}] includers, .cyan[{:>8}ms] total  {}{}\n"_styled,
+                   hdr.fan_in,
+                   hdr.includer_time.count(),
+                   display_path(hdr.path),
+                   hdr.pch_candidate ? " (.bold.green[PCH candidate])"_styled : "");
+    }
+    auto n_candidates
+        = std::ranges::count_if(report.headers, &bpt::build_report::header::pch_candidate);
+    if (n_candidates) {
+        fmt::print(
+            "\n{} header(s) are included by a large share of the compilations. Including them in a "
+            "precompiled header may reduce build times.\n",
+            n_candidates);
+    }
+}
+
+}  // namespace
+
+int build_report(const options& opts) {
+    auto out_root = opts.out_path.value_or(fs::current_path() / "_build");
+    auto db_path  = out_root / ".bpt.db";
+    if (!fs::exists(db_path)) {
+        bpt_log(error,
+                "There is no build database in [.br.yellow[{}]]. Run 'bpt build' first, or pass "
+                "the build's output directory with '--out'."_styled,
+                out_root.string());
+        return 1;
+    }
+
+    auto db     = database::open(db_path);
+    auto report = bpt::build_report::generate(db);
+    if (report.translation_units.empty()) {
+        bpt_log(info, "No compilations have been recorded in [{}]", out_root.string());
+        return 0;
+    }
+
+    fmt::print(".bold[{}] compilations took a total of .bold.cyan[{}ms]\n"_styled,
+               report.translation_units.size(),
+               report.total_compile_time.count());
+    auto limit = static_cast<std::size_t>((std::max)(opts.build_report.limit, 0));
+    print_translation_units(report, limit);
+    print_headers(report, limit);
+    return 0;
+}
+
+}  // namespace bpt::cli::cmd
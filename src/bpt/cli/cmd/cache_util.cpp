@@ -12,6 +12,7 @@
 #include <bpt/util/http/error.hpp>
 #include <bpt/util/http/pool.hpp>
 #include <bpt/util/log.hpp>
+#include <bpt/util/trace.hpp>
 #include <bpt/util/url.hpp>
 
 #include <fansi/styled.hpp>
@@ -51,9 +52,11 @@ use_repo(bpt::crs::cache_db& meta_db, const cli::options& opts, std::string_view
         using m = cli::repo_sync_mode;
         switch (opts.repo_sync_mode) {
         case m::cached_okay:
-        case m::always:
+        case m::always: {
+            trace::slice trace_slice{"phase", "Sync repository", url.to_string()};
             meta_db.sync_remote(url);
             return;
+        }
         case m::never:
             return;
         }
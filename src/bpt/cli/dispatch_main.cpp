@@ -15,6 +15,7 @@ using command = int(const options&);
 
 command build_deps;
 command build;
+command build_report;
 command compile_file;
 command install_yourself;
 command pkg_create;
@@ -34,6 +35,8 @@ int dispatch_main(const options& opts) noexcept {
             return cmd::new_cmd(opts);
         case subcommand::build:
             return cmd::build(opts);
+        case subcommand::build_report:
+            return cmd::build_report(opts);
         case subcommand::pkg: {
             BPT_E_SCOPE(opts.pkg.subcommand);
             switch (opts.pkg.subcommand) {
@@ -157,6 +157,10 @@ struct setup {
             .name = "build",
             .help = "Build a project",
         }));
+        setup_build_report_cmd(group.add_parser({
+            .name = "build-report",
+            .help = "Show where time was spent in a previous build",
+        }));
         setup_compile_file_cmd(group.add_parser({
             .name = "compile-file",
             .help = "Compile individual files in the project",
@@ -210,6 +214,91 @@ struct setup {
 
         build_cmd.add_argument(jobs_arg.dup());
         build_cmd.add_argument(tweaks_dir_arg.dup());
+        build_cmd.add_argument({
+            .long_spellings = {"content-hash"},
+            .help = "Record a digest of the content of each compilation input. An input with a new "
+                    "modification time will not cause a recompile if its content is unchanged.",
+            .nargs  = 0,
+            .action = debate::store_true(opts.build.content_hash),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"object-cache"},
+            .help = "Restore unchanged object files from a local cache shared between builds, and "
+                    "store newly compiled object files in the cache. Copies of a project in "
+                    "different directories share the cached objects",
+            .nargs  = 0,
+            .action = debate::store_true(opts.build.object_cache),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"object-cache-dir"},
+            .help    = "Use the given directory for the object cache. Implies --object-cache",
+            .valname = "<dir>",
+            .action  = debate::put_into(opts.build.object_cache_dir),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"object-cache-max-size"},
+            .help    = "The maximum size of the object cache, in MiB. The least-recently used "
+                       "objects will be evicted to stay below this size.",
+            .valname = "<mib>",
+            .action  = debate::put_into(opts.build.object_cache_max_mb),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"memory-budget"},
+            .help    = "Limit the memory used by concurrently running compilations, in MiB. The "
+                       "memory usage of each file is estimated from prior compilations.",
+            .valname = "<mib>",
+            .action  = debate::put_into(opts.build.memory_budget_mb),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"trace-file"},
+            .help    = "Write a timeline of the build to the given file, in the Chrome trace event "
+                       "format. View it with chrome://tracing or https://ui.perfetto.dev",
+            .valname = "<path>",
+            .action  = debate::put_into(opts.build.trace_file),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"unity"},
+            .help = "Combine the sources of each library into a few larger compilations. This "
+                    "reduces the total time of a full build, but may break code that defines "
+                    "internal entities with the same name in different source files.",
+            .nargs  = 0,
+            .action = debate::store_true(opts.build.unity),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"rerun-tests"},
+            .help = "Run every test, including those that passed in a prior build with the same "
+                    "executable and environment",
+            .nargs  = 0,
+            .action = debate::store_true(opts.build.rerun_tests),
+        });
+        build_cmd.add_argument({
+            .long_spellings = {"shard"},
+            .help = "Only run one of <count> subsets of the project's tests, e.g. '--shard=2/4'. "
+                    "Every machine assigns the same tests to the same subset.",
+            .valname = "<index>/<count>",
+            .action  = [&dest = opts.build.test_shard](std::string_view value,
+                                                        std::string_view spelling) {
+                dest = test_shard::parse(value);
+                if (!dest) {
+                    throw boost::leaf::exception(debate::invalid_arguments(
+                                                     "Invalid test shard. Expected "
+                                                     "'<index>/<count>', with 1 <= index <= count"),
+                                                 debate::e_arg_spelling{std::string(spelling)},
+                                                 debate::e_invalid_arg_value{std::string(value)});
+                }
+            },
+        });
+    }
+
+    void setup_build_report_cmd(argument_parser& build_report_cmd) noexcept {
+        build_report_cmd.add_argument(out_arg.dup()).help
+            = "Directory where bpt wrote the results of the build to report on";
+        build_report_cmd.add_argument({
+            .long_spellings = {"limit"},
+            .help           = "The maximum number of entries to show in each section of the report",
+            .valname        = "<count>",
+            .action         = debate::put_into(opts.build_report.limit),
+        });
     }
 
     void setup_compile_file_cmd(argument_parser& compile_file_cmd) noexcept {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bpt/build/test_schedule.hpp>
 #include <bpt/util/log.hpp>
 #include <debate/argument_parser.hpp>
 
@@ -21,6 +22,7 @@ namespace cli {
 enum class subcommand {
     _none_,
     build,
+    build_report,
     compile_file,
     build_deps,
     pkg,
@@ -145,8 +147,34 @@ struct options {
         bool     want_apps  = true;
         opt_path built_json;
         opt_path tweaks_dir;
+        /// Whether to compare file content (rather than only mtimes) to detect modified inputs
+        bool content_hash = false;
+        /// Whether to use the local object cache
+        bool object_cache = default_from_env("BPT_OBJECT_CACHE", false);
+        /// An alternative directory for the object cache. Implies `object_cache`
+        opt_path object_cache_dir;
+        /// The maximum size of the object cache, in MiB
+        int object_cache_max_mb = default_from_env("BPT_OBJECT_CACHE_MAX_MB", 5 * 1024);
+        /// The memory that concurrently running compilations may use, in MiB. Zero for no limit.
+        int memory_budget_mb = default_from_env("BPT_MEMORY_BUDGET_MB", 0);
+        /// A file to which a trace of the build will be written
+        opt_path trace_file;
+        /// Whether to combine library sources into unity compilations
+        bool unity = false;
+        /// Whether to run tests that passed in a prior build and have not changed since
+        bool rerun_tests = false;
+        /// If set, only run the tests in this shard
+        std::optional<bpt::test_shard> test_shard;
     } build;
 
+    /**
+     * @brief Parameters specific to 'bpt build-report'
+     */
+    struct {
+        /// The maximum number of entries to show in each section of the report
+        int limit = 20;
+    } build_report;
+
     /**
      * @brief Parameters specific to 'bpt compile-file'
      */
@@ -62,6 +62,20 @@ library_info library_info::from_data(const json5::data& data) {
                               "'test-dependencies' must be an array of dependency objects"},
                           for_each{put_into{std::back_inserter(ret.test_dependencies),
                                             dependency::from_data}}},
+             if_key{"precompiled-header",
+                    require_str{"Library 'precompiled-header' must be a string"},
+                    put_into{ret.precompiled_header,
+                             [](std::string s) {
+                                 auto p = std::filesystem::path(s).lexically_normal();
+                                 if (p.has_root_path() || p.empty()
+                                     || (p.begin() != p.end() && *p.begin() == "..")) {
+                                     throw semester::walk_error{
+                                         neo::ufmt("Library precompiled header [{}] must be a "
+                                                   "relative path within the library directory",
+                                                   p.generic_string())};
+                                 }
+                                 return p;
+                             }}},
              if_key{"_comment", just_accept},
          });
     return ret;
@@ -7,6 +7,7 @@
 #include <json5/data.hpp>
 
 #include <filesystem>
+#include <optional>
 #include <vector>
 
 namespace bpt::crs {
@@ -18,6 +19,9 @@ struct library_info {
     std::vector<bpt::name>  intra_test_using;
     std::vector<dependency> dependencies;
     std::vector<dependency> test_dependencies;
+    /// A header to precompile and use for every C++ compilation in the library, relative to the
+    /// library's root directory
+    std::optional<std::filesystem::path> precompiled_header = std::nullopt;
 
     static library_info from_data(const json5::data& data);
 
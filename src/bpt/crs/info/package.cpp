@@ -95,14 +95,18 @@ std::string package_info::to_json(int indent) const noexcept {
     };
 
     for (auto&& lib : this->libraries) {
-        ret_libs.push_back(json::object({
+        auto lib_json = json::object({
             {"name", lib.name.str},
             {"path", lib.path.generic_string()},
             {"using", std::move(names_as_str_array(lib.intra_using))},
             {"test-using", std::move(names_as_str_array(lib.intra_test_using))},
             {"dependencies", deps_as_json_array(lib.dependencies)},
             {"test-dependencies", deps_as_json_array(lib.test_dependencies)},
-        }));
+        });
+        if (lib.precompiled_header) {
+            lib_json["precompiled-header"] = lib.precompiled_header->generic_string();
+        }
+        ret_libs.push_back(std::move(lib_json));
     }
     json data = json::object({
         {"name", id.name.str},
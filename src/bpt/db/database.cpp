@@ -3,6 +3,7 @@
 #include <bpt/error/errors.hpp>
 #include <bpt/util/fs/path.hpp>
 #include <bpt/util/log.hpp>
+#include <bpt/util/time.hpp>
 
 #include <neo/sqlite3/error.hpp>
 #include <neo/sqlite3/exec.hpp>
@@ -14,6 +15,8 @@
 #include <range/v3/range/conversion.hpp>
 #include <range/v3/view/transform.hpp>
 
+#include <algorithm>
+
 using namespace bpt;
 
 namespace nsql = neo::sqlite3;
@@ -28,6 +31,11 @@ void migrate_1(nsql::connection& db) {
         DROP TABLE IF EXISTS bpt_deps;
         DROP TABLE IF EXISTS bpt_file_commands;
         DROP TABLE IF EXISTS bpt_files;
+        DROP TABLE IF EXISTS bpt_module_bmis;
+        DROP TABLE IF EXISTS bpt_test_results;
+        DROP TABLE IF EXISTS bpt_test_durations;
+        DROP TABLE IF EXISTS bpt_source_listings;
+        DROP TABLE IF EXISTS bpt_generated_files;
         DROP TABLE IF EXISTS bpt_compile_deps;
         DROP TABLE IF EXISTS bpt_compilations;
         DROP TABLE IF EXISTS bpt_source_files;
@@ -44,7 +52,13 @@ void migrate_1(nsql::connection& db) {
             output TEXT NOT NULL,
             toolchain_hash INTEGER NOT NULL,
             n_compilations INTEGER NOT NULL DEFAULT 0,
-            avg_duration INTEGER NOT NULL DEFAULT 0
+            avg_duration INTEGER NOT NULL DEFAULT 0,
+            -- The resource usage of the most recent measured execution
+            max_rss INTEGER NOT NULL DEFAULT 0,
+            user_cpu_us INTEGER NOT NULL DEFAULT 0,
+            system_cpu_us INTEGER NOT NULL DEFAULT 0,
+            block_reads INTEGER NOT NULL DEFAULT 0,
+            block_writes INTEGER NOT NULL DEFAULT 0
         );
         CREATE TABLE bpt_compile_deps (
             input_file_id
@@ -54,8 +68,44 @@ void migrate_1(nsql::connection& db) {
                 INTEGER NOT NULL
                 REFERENCES bpt_source_files(file_id),
             input_mtime INTEGER NOT NULL,
+            -- A digest of the input's content, or zero if no digest was recorded
+            input_digest INTEGER NOT NULL DEFAULT 0,
             UNIQUE(input_file_id, output_file_id)
         );
+        CREATE TABLE bpt_module_bmis (
+            module_name TEXT NOT NULL UNIQUE,
+            bmi_path TEXT NOT NULL,
+            -- The source file that provides the module
+            provider TEXT NOT NULL
+        );
+        CREATE TABLE bpt_test_results (
+            executable TEXT NOT NULL UNIQUE,
+            -- The key with which the test last passed, or zero if it did not pass
+            pass_key INTEGER NOT NULL,
+            -- The resource usage of the most recent run
+            max_rss INTEGER NOT NULL DEFAULT 0,
+            user_cpu_us INTEGER NOT NULL DEFAULT 0,
+            system_cpu_us INTEGER NOT NULL DEFAULT 0,
+            block_reads INTEGER NOT NULL DEFAULT 0,
+            block_writes INTEGER NOT NULL DEFAULT 0
+        );
+        CREATE TABLE bpt_test_durations (
+            run_id INTEGER PRIMARY KEY,
+            executable TEXT NOT NULL,
+            duration_us INTEGER NOT NULL
+        );
+        CREATE INDEX idx_test_durations_executable ON bpt_test_durations(executable);
+        CREATE TABLE bpt_source_listings (
+            root TEXT NOT NULL UNIQUE,
+            -- A JSON object of the directories (with their modification times) and the files that
+            -- were found within the root
+            listing TEXT NOT NULL
+        );
+        CREATE TABLE bpt_generated_files (
+            path TEXT NOT NULL UNIQUE,
+            -- The key of the inputs from which the file was last generated
+            input_key INTEGER NOT NULL
+        );
     )")
         .throw_if_error();
 }
@@ -74,7 +124,7 @@ void ensure_migrated(nsql::connection& db) {
     auto version_st  = *db.prepare("SELECT version FROM bpt_meta_1");
     auto version_str = *nsql::one_cell<std::string>(version_st);
 
-    const auto cur_version = "alpha-5-dev1"sv;
+    const auto cur_version = "alpha-5-dev9"sv;
     if (cur_version != version_str) {
         if (!version_str.empty()) {
             bpt_log(info, "NOTE: A prior version of the project build database was found.");
@@ -116,124 +166,525 @@ database database::open(const std::string& db_path) {
 database::database(nsql::connection db)
     : _db(std::move(db)) {}
 
-std::int64_t database::_record_file(path_ref path_) {
-    auto path = bpt::normalize_path(path_);
+namespace {
+
+/// Obtain the key by which a path is stored in the database
+std::string path_key(path_ref p) {
+    if (p.is_absolute()) {
+        // Paths are recorded in normalized form, so we do not need to hit the filesystem
+        return bpt::normalize_path(p).generic_string();
+    }
+    return bpt::resolve_path_weak(p).generic_string();
+}
+
+}  // namespace
+
+std::size_t database::dep_graph::intern(std::string_view path) {
+    auto [it, added] = path_indices.try_emplace(std::string(path), paths.size());
+    if (added) {
+        paths.emplace_back(path);
+        file_ids.push_back(0);
+    }
+    return it->second;
+}
+
+std::optional<std::size_t> database::dep_graph::find(path_ref path) const {
+    auto it = path_indices.find(path_key(path));
+    if (it == path_indices.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+database::dep_graph::output_node& database::dep_graph::modify(path_ref output) {
+    auto  idx  = intern(path_key(output));
+    auto& node = outputs[idx];
+    if (!node.dirty) {
+        node.dirty = true;
+        dirty_outputs.push_back(idx);
+    }
+    return node;
+}
+
+database::dep_graph& database::_load_graph() const {
+    if (_graph) {
+        return *_graph;
+    }
+    bpt::stopwatch sw;
+    auto&          graph = _graph.emplace();
+
+    std::unordered_map<std::int64_t, std::size_t> index_of_id;
+    auto&                                         files_st = _stmt_cache(R"(
+        SELECT file_id, path FROM bpt_source_files
+    )"_sql);
+    files_st.reset();
+    for (auto [file_id, path] : nsql::iter_tuples<std::int64_t, std::string>(files_st)) {
+        auto idx              = graph.intern(path);
+        graph.file_ids[idx]   = file_id;
+        index_of_id[file_id] = idx;
+    }
+
+    auto& cmds_st = _stmt_cache(R"(
+        SELECT file_id, command, output, toolchain_hash, n_compilations, avg_duration,
+               max_rss, user_cpu_us, system_cpu_us, block_reads, block_writes
+          FROM bpt_compilations
+    )"_sql);
+    cmds_st.reset();
+    for (auto [file_id, cmd, out, tc_id, n_compilations, dur, rss, utime, stime, nread, nwrite] :
+         nsql::iter_tuples<std::int64_t,
+                           std::string,
+                           std::string,
+                           std::int64_t,
+                           std::int64_t,
+                           std::int64_t,
+                           std::int64_t,
+                           std::int64_t,
+                           std::int64_t,
+                           std::int64_t,
+                           std::int64_t>(cmds_st)) {
+        auto& node   = graph.outputs[index_of_id.at(file_id)];
+        node.command = completed_compilation{cmd,
+                                             out,
+                                             tc_id,
+                                             std::chrono::milliseconds(dur),
+                                             proc_resource_usage{
+                                                 .peak_rss     = std::uint64_t(rss),
+                                                 .user_cpu     = std::chrono::microseconds(utime),
+                                                 .system_cpu   = std::chrono::microseconds(stime),
+                                                 .block_reads  = std::uint64_t(nread),
+                                                 .block_writes = std::uint64_t(nwrite),
+                                             }};
+        node.n_compilations = n_compilations;
+    }
+
+    auto& deps_st = _stmt_cache(R"(
+        SELECT input_file_id, output_file_id, input_mtime, input_digest FROM bpt_compile_deps
+    )"_sql);
+    deps_st.reset();
+    std::size_t n_deps = 0;
+    for (auto [in_id, out_id, mtime, digest] :
+         nsql::iter_tuples<std::int64_t, std::int64_t, std::int64_t, std::int64_t>(deps_st)) {
+        graph.outputs[index_of_id.at(out_id)].inputs.push_back(
+            dep_graph::recorded_input{index_of_id.at(in_id),
+                                      mtime,
+                                      static_cast<std::uint64_t>(digest)});
+        ++n_deps;
+    }
+
+    bpt_log(debug,
+            "Loaded build database ({} files, {} outputs, {} dependencies) in {:L}ms",
+            graph.paths.size(),
+            graph.outputs.size(),
+            n_deps,
+            sw.elapsed_ms().count());
+    return graph;
+}
 
-    auto found = _stored_file_ids_cache.find(path);
-    if (found != _stored_file_ids_cache.end()) {
-        return found->second;
+std::int64_t database::_file_id_of(std::size_t path_index) {
+    auto& graph = _load_graph();
+    auto& fid   = graph.file_ids[path_index];
+    if (fid != 0) {
+        return fid;
     }
-    auto& st   = _stmt_cache(R"(
+    auto& st = _stmt_cache(R"(
         INSERT INTO bpt_source_files (path)
         VALUES (?1)
         ON CONFLICT (path) DO UPDATE SET path=path
         RETURNING file_id
     )"_sql);
-    auto [fid] = *nsql::one_row<std::int64_t>(st, path.generic_string());
-    _stored_file_ids_cache.emplace(path, fid);
+    auto [new_id] = *nsql::one_row<std::int64_t>(st, graph.paths[path_index]);
+    fid           = new_id;
     return fid;
 }
 
-void database::record_dep(path_ref input, path_ref output, fs::file_time_type input_mtime) {
-    auto  in_id  = _record_file(input);
-    auto  out_id = _record_file(output);
-    auto& st     = _stmt_cache(R"(
-        INSERT OR REPLACE INTO bpt_compile_deps (input_file_id, output_file_id, input_mtime)
-        VALUES (?, ?, ?)
-    )"_sql);
-    nsql::exec(st, in_id, out_id, input_mtime.time_since_epoch().count()).throw_if_error();
+void database::record_dep(path_ref                     input,
+                          path_ref                     output,
+                          fs::file_time_type           input_mtime,
+                          std::optional<std::uint64_t> input_digest) {
+    auto& graph  = _load_graph();
+    auto  in_idx = graph.intern(path_key(input));
+    auto  rec    = dep_graph::recorded_input{in_idx,
+                                             input_mtime.time_since_epoch().count(),
+                                             input_digest.value_or(0)};
+    auto& inputs = graph.modify(output).inputs;
+    // A compiler may list the same input more than once. Keep only one record per input, as the
+    // table has a uniqueness constraint on (input, output).
+    auto existing = std::ranges::find(inputs, in_idx, &dep_graph::recorded_input::path_index);
+    if (existing != inputs.end()) {
+        *existing = rec;
+    } else {
+        inputs.push_back(rec);
+    }
+}
+
+void database::refresh_dep(path_ref input, path_ref output, fs::file_time_type input_mtime) {
+    auto& graph  = _load_graph();
+    auto  in_idx = graph.find(input);
+    auto  out    = graph.find(output);
+    if (!in_idx || !out || !graph.outputs.contains(*out)) {
+        return;
+    }
+    auto& node = graph.modify(output);
+    for (auto& rec : node.inputs) {
+        if (rec.path_index == *in_idx) {
+            rec.mtime = input_mtime.time_since_epoch().count();
+        }
+    }
 }
 
 void database::record_compilation(path_ref file, const completed_compilation& cmd) {
-    auto file_id = _record_file(file);
+    auto& node = _load_graph().modify(file);
+
+    // Keep a running average of the duration of the command. Very short compilations are not
+    // counted, as their durations are dominated by noise.
+    auto duration = cmd.duration;
+    if (!node.command) {
+        node.n_compilations = 1;
+    } else if (cmd.duration.count() < 500) {
+        duration = node.command->duration;
+    } else {
+        node.n_compilations = (std::min)(std::int64_t(10), node.n_compilations + 1);
+        auto avg            = node.command->duration;
+        duration            = avg + ((cmd.duration - avg) / node.n_compilations);
+    }
+    // Remember the most recent measurement of resource usage. Results that were restored from a
+    // cache have no measurement.
+    auto usage = cmd.usage;
+    if (usage == proc_resource_usage{} && node.command) {
+        usage = node.command->usage;
+    }
+    node.command = completed_compilation{cmd.quoted_command,
+                                         cmd.output,
+                                         cmd.toolchain_hash,
+                                         duration,
+                                         usage};
+}
 
+void database::forget_inputs_of(path_ref file) { _load_graph().modify(file).inputs.clear(); }
+
+std::optional<std::vector<input_file_info>> database::inputs_of(path_ref file) const {
+    auto& graph = _load_graph();
+    auto  idx   = graph.find(file);
+    if (!idx) {
+        return std::nullopt;
+    }
+    auto found = graph.outputs.find(*idx);
+    if (found == graph.outputs.end() || found->second.inputs.empty()) {
+        return std::nullopt;
+    }
+    std::vector<input_file_info> ret;
+    ret.reserve(found->second.inputs.size());
+    for (auto& input : found->second.inputs) {
+        ret.emplace_back(
+            input_file_info{graph.paths[input.path_index],
+                            fs::file_time_type(fs::file_time_type::duration(input.mtime)),
+                            input.digest ? std::optional(input.digest) : std::nullopt});
+    }
+    return ret;
+}
+
+std::optional<completed_compilation> database::command_of(path_ref file) const {
+    auto& graph = _load_graph();
+    auto  idx   = graph.find(file);
+    if (!idx) {
+        return std::nullopt;
+    }
+    auto found = graph.outputs.find(*idx);
+    if (found == graph.outputs.end()) {
+        return std::nullopt;
+    }
+    return found->second.command;
+}
+
+std::map<fs::path, recorded_compilation>
+database::compilations_of(const std::vector<fs::path>& outputs) const {
+    std::map<fs::path, recorded_compilation> ret;
+    for (auto& out : outputs) {
+        auto cmd = command_of(out);
+        if (!cmd) {
+            continue;
+        }
+        auto inputs = inputs_of(out);
+        if (!inputs) {
+            continue;
+        }
+        ret.emplace(out, recorded_compilation{std::move(*cmd), std::move(*inputs)});
+    }
+    return ret;
+}
+
+std::map<fs::path, recorded_compilation> database::all_compilations() const {
+    auto&                 graph = _load_graph();
+    std::vector<fs::path> outputs;
+    outputs.reserve(graph.outputs.size());
+    for (auto& [idx, node] : graph.outputs) {
+        outputs.emplace_back(graph.paths[idx]);
+    }
+    return compilations_of(outputs);
+}
+
+void database::record_module_bmi(std::string_view module_name, path_ref bmi, path_ref provider) {
     auto& st = _stmt_cache(R"(
-        INSERT INTO bpt_compilations
-                (file_id, command, output, n_compilations, toolchain_hash, avg_duration)
-            VALUES
-                (:file_id, :command, :output, 1, :toolchain_hash, :duration)
-        ON CONFLICT(file_id) DO UPDATE SET
-            command = :command,
-            output = :output,
-            toolchain_hash = :toolchain_hash,
-            n_compilations = CASE
-                WHEN :duration < 500 THEN n_compilations
-                ELSE min(10, n_compilations + 1)
-            END,
-            avg_duration = CASE
-                WHEN :duration < 500 THEN avg_duration
-                ELSE avg_duration + ((:duration - avg_duration) / min(10, n_compilations + 1))
-            END
+        INSERT INTO bpt_module_bmis (module_name, bmi_path, provider)
+            VALUES (?1, ?2, ?3)
+        ON CONFLICT(module_name) DO UPDATE SET
+            bmi_path = ?2,
+            provider = ?3
+    )"_sql);
+    nsql::exec(st, module_name, path_key(bmi), path_key(provider)).throw_if_error();
+}
+
+std::optional<recorded_module_bmi> database::module_bmi(std::string_view module_name) const {
+    auto row = nsql::one_row<std::string, std::string>(  //
+        _stmt_cache(R"(
+            SELECT bmi_path, provider FROM bpt_module_bmis WHERE module_name = ?
+        )"_sql),
+        module_name);
+    if (row.has_value()) {
+        auto [bmi, provider] = *row;
+        return recorded_module_bmi{bmi, provider};
+    }
+    return std::nullopt;
+}
+
+void database::record_test_result(path_ref                                 executable,
+                                  std::uint64_t                            pass_key,
+                                  std::optional<std::chrono::microseconds> duration,
+                                  const proc_resource_usage&               usage) {
+    const auto exe_key = path_key(executable);
+    auto       tr      = transaction();
+
+    auto& result_st = _stmt_cache(R"(
+        INSERT INTO bpt_test_results
+            (executable, pass_key, max_rss, user_cpu_us, system_cpu_us, block_reads, block_writes)
+            VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7)
+        ON CONFLICT(executable) DO UPDATE SET
+            pass_key = ?2,
+            max_rss = ?3,
+            user_cpu_us = ?4,
+            system_cpu_us = ?5,
+            block_reads = ?6,
+            block_writes = ?7
     )"_sql);
-    nsql::exec(st,
-               file_id,
-               std::string_view(cmd.quoted_command),
-               std::string_view(cmd.output),
-               cmd.toolchain_hash,
-               cmd.duration.count())
+    nsql::exec(result_st,
+               exe_key,
+               static_cast<std::int64_t>(pass_key),
+               static_cast<std::int64_t>(usage.peak_rss),
+               static_cast<std::int64_t>(usage.user_cpu.count()),
+               static_cast<std::int64_t>(usage.system_cpu.count()),
+               static_cast<std::int64_t>(usage.block_reads),
+               static_cast<std::int64_t>(usage.block_writes))
         .throw_if_error();
+    if (!duration) {
+        return;
+    }
+
+    auto& duration_st = _stmt_cache(R"(
+        INSERT INTO bpt_test_durations (executable, duration_us) VALUES (?, ?)
+    )"_sql);
+    nsql::exec(duration_st, exe_key, static_cast<std::int64_t>(duration->count())).throw_if_error();
+
+    // Discard all but the most recent durations
+    auto& trim_st = _stmt_cache(R"(
+        DELETE FROM bpt_test_durations
+         WHERE executable = ?1
+           AND run_id NOT IN (
+               SELECT run_id FROM bpt_test_durations
+                WHERE executable = ?1
+                ORDER BY run_id DESC
+                LIMIT ?2)
+    )"_sql);
+    nsql::exec(trim_st, exe_key, max_test_history).throw_if_error();
 }
 
-void database::forget_inputs_of(path_ref file) {
+std::optional<recorded_test_result> database::test_result(path_ref executable) const {
+    const auto exe_key = path_key(executable);
+
+    auto row = nsql::one_row<std::int64_t,
+                             std::int64_t,
+                             std::int64_t,
+                             std::int64_t,
+                             std::int64_t,
+                             std::int64_t>(  //
+        _stmt_cache(R"(
+            SELECT pass_key, max_rss, user_cpu_us, system_cpu_us, block_reads, block_writes
+              FROM bpt_test_results
+             WHERE executable = ?
+        )"_sql),
+        exe_key);
+    if (!row.has_value()) {
+        return std::nullopt;
+    }
+    auto [pass_key, rss, utime, stime, nread, nwrite] = *row;
+    recorded_test_result ret;
+    ret.pass_key = static_cast<std::uint64_t>(pass_key);
+    ret.usage    = proc_resource_usage{
+        .peak_rss     = std::uint64_t(rss),
+        .user_cpu     = std::chrono::microseconds(utime),
+        .system_cpu   = std::chrono::microseconds(stime),
+        .block_reads  = std::uint64_t(nread),
+        .block_writes = std::uint64_t(nwrite),
+    };
     auto& st = _stmt_cache(R"(
-        WITH id_to_delete AS (
-            SELECT file_id
-            FROM bpt_source_files
-            WHERE path = ?
-        )
-        DELETE FROM bpt_compile_deps
-         WHERE output_file_id IN id_to_delete
-    )"_sql);
-    nsql::exec(st, fs::weakly_canonical(file).generic_string()).throw_if_error();
-}
-
-std::optional<std::vector<input_file_info>> database::inputs_of(path_ref file_) const {
-    auto  file = fs::weakly_canonical(file_);
-    auto& st   = _stmt_cache(R"(
-        WITH file AS (
-            SELECT file_id
-              FROM bpt_source_files
-             WHERE path = ?
-        )
-        SELECT path, input_mtime
-          FROM bpt_compile_deps
-          JOIN bpt_source_files ON input_file_id = file_id
-         WHERE output_file_id IN file
+        SELECT duration_us FROM bpt_test_durations WHERE executable = ? ORDER BY run_id
     )"_sql);
     st.reset();
-    st.bindings()[1] = file.generic_string();
-    auto tup_iter    = nsql::iter_tuples<std::string, std::int64_t>(st);
+    st.bindings()[1] = exe_key;
+    for (auto [duration_us] : nsql::iter_tuples<std::int64_t>(st)) {
+        ret.durations.emplace_back(duration_us);
+    }
+    return ret;
+}
 
-    std::vector<input_file_info> ret;
-    for (auto [path, mtime] : tup_iter) {
-        ret.emplace_back(
-            input_file_info{path, fs::file_time_type(fs::file_time_type::duration(mtime))});
+void database::flush() {
+    if (!_graph || _graph->dirty_outputs.empty()) {
+        return;
+    }
+    bpt::stopwatch sw;
+    auto&          graph = *_graph;
+    try {
+        auto tr = transaction();
+        _write_outputs(graph.dirty_outputs);
+    } catch (...) {
+        // File IDs that we assigned may have been rolled back. Discard the in-memory graph so that
+        // it will be reloaded from the database on next use.
+        _graph.reset();
+        throw;
+    }
+    for (auto out_idx : graph.dirty_outputs) {
+        graph.outputs[out_idx].dirty = false;
+    }
+    bpt_log(debug,
+            "Wrote {} modified outputs to the build database in {:L}ms",
+            graph.dirty_outputs.size(),
+            sw.elapsed_ms().count());
+    graph.dirty_outputs.clear();
+}
+
+void database::_write_outputs(const std::vector<std::size_t>& output_indices) {
+    auto& graph     = *_graph;
+    auto& cmd_st    = _stmt_cache(R"(
+        INSERT INTO bpt_compilations
+                (file_id, command, output, toolchain_hash, n_compilations, avg_duration,
+                 max_rss, user_cpu_us, system_cpu_us, block_reads, block_writes)
+            VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11)
+        ON CONFLICT(file_id) DO UPDATE SET
+            command = ?2,
+            output = ?3,
+            toolchain_hash = ?4,
+            n_compilations = ?5,
+            avg_duration = ?6,
+            max_rss = ?7,
+            user_cpu_us = ?8,
+            system_cpu_us = ?9,
+            block_reads = ?10,
+            block_writes = ?11
+    )"_sql);
+    auto& forget_st = _stmt_cache(R"(
+        DELETE FROM bpt_compile_deps WHERE output_file_id = ?
+    )"_sql);
+    auto& dep_st    = _stmt_cache(R"(
+        INSERT OR REPLACE INTO bpt_compile_deps
+            (input_file_id, output_file_id, input_mtime, input_digest)
+        VALUES (?, ?, ?, ?)
+    )"_sql);
+
+    for (auto out_idx : output_indices) {
+        auto& node   = graph.outputs[out_idx];
+        auto  out_id = _file_id_of(out_idx);
+        if (node.command) {
+            nsql::exec(cmd_st,
+                       out_id,
+                       std::string_view(node.command->quoted_command),
+                       std::string_view(node.command->output),
+                       node.command->toolchain_hash,
+                       node.n_compilations,
+                       node.command->duration.count(),
+                       static_cast<std::int64_t>(node.command->usage.peak_rss),
+                       static_cast<std::int64_t>(node.command->usage.user_cpu.count()),
+                       static_cast<std::int64_t>(node.command->usage.system_cpu.count()),
+                       static_cast<std::int64_t>(node.command->usage.block_reads),
+                       static_cast<std::int64_t>(node.command->usage.block_writes))
+                .throw_if_error();
+        }
+        nsql::exec(forget_st, out_id).throw_if_error();
+        for (auto& input : node.inputs) {
+            nsql::exec(dep_st,
+                       _file_id_of(input.path_index),
+                       out_id,
+                       input.mtime,
+                       static_cast<std::int64_t>(input.digest))
+                .throw_if_error();
+        }
     }
+}
 
-    if (ret.empty()) {
+void database::record_source_listing(path_ref root, const recorded_source_listing& listing) {
+    auto dirs = nlohmann::json::array();
+    for (auto& [dir, mtime] : listing.directories) {
+        dirs.push_back(nlohmann::json::array({dir.string(), mtime.time_since_epoch().count()}));
+    }
+    auto files = nlohmann::json::array();
+    for (auto& file : listing.files) {
+        files.push_back(file.string());
+    }
+    auto  doc = nlohmann::json::object({
+        {"dirs", std::move(dirs)},
+        {"files", std::move(files)},
+        {"scanned", listing.scan_time.time_since_epoch().count()},
+    });
+    auto& st = _stmt_cache(R"(
+        INSERT INTO bpt_source_listings (root, listing)
+            VALUES (?1, ?2)
+        ON CONFLICT(root) DO UPDATE SET listing = ?2
+    )"_sql);
+    nsql::exec(st, path_key(root), doc.dump()).throw_if_error();
+}
+
+std::optional<recorded_source_listing> database::source_listing(path_ref root) const {
+    auto listing = nsql::one_cell<std::string>(  //
+        _stmt_cache(R"(
+            SELECT listing FROM bpt_source_listings WHERE root = ?
+        )"_sql),
+        path_key(root));
+    if (!listing.has_value()) {
+        return std::nullopt;
+    }
+    auto doc = nlohmann::json::parse(*listing, nullptr, false);
+    if (doc.is_discarded()) {
+        bpt_log(warn, "Ignoring invalid source listing recorded for [{}]", root.string());
         return std::nullopt;
     }
+    recorded_source_listing ret;
+    for (auto& dir : doc["dirs"]) {
+        auto mtime = fs::file_time_type::duration(dir[1].get<std::int64_t>());
+        ret.directories.emplace_back(dir[0].get<std::string>(), fs::file_time_type(mtime));
+    }
+    for (auto& file : doc["files"]) {
+        ret.files.emplace_back(file.get<std::string>());
+    }
+    auto scanned  = fs::file_time_type::duration(doc.value("scanned", std::int64_t(0)));
+    ret.scan_time = fs::file_time_type(scanned);
     return ret;
 }
 
-std::optional<completed_compilation> database::command_of(path_ref file_) const {
-    auto  file = fs::weakly_canonical(file_);
-    auto& st   = _stmt_cache(R"(
-        WITH file AS (
-            SELECT file_id
-              FROM bpt_source_files
-             WHERE path = ?
-        )
-        SELECT command, output, avg_duration, toolchain_hash
-          FROM bpt_compilations
-         WHERE file_id IN file
+void database::record_generated_file(path_ref file, std::uint64_t input_key) {
+    auto& st = _stmt_cache(R"(
+        INSERT INTO bpt_generated_files (path, input_key)
+            VALUES (?1, ?2)
+        ON CONFLICT(path) DO UPDATE SET input_key = ?2
     )"_sql);
-    st.reset();
-    st.bindings()[1] = file.generic_string();
-    auto opt_res     = nsql::next<std::string, std::string, std::int64_t, std::int64_t>(st);
-    if (opt_res.errc() == nsql::errc::done) {
+    nsql::exec(st, path_key(file), static_cast<std::int64_t>(input_key)).throw_if_error();
+}
+
+std::optional<std::uint64_t> database::generated_file_key(path_ref file) const {
+    auto key = nsql::one_cell<std::int64_t>(  //
+        _stmt_cache(R"(
+            SELECT input_key FROM bpt_generated_files WHERE path = ?
+        )"_sql),
+        path_key(file));
+    if (!key.has_value()) {
         return std::nullopt;
     }
-    auto& [cmd, out, dur, tc_id] = *opt_res;
-    return completed_compilation{cmd, out, tc_id, std::chrono::milliseconds(dur)};
+    return static_cast<std::uint64_t>(*key);
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <bpt/util/fs/path.hpp>
+#include <bpt/util/proc.hpp>
 
 #include <neo/sqlite3/database.hpp>
 #include <neo/sqlite3/statement.hpp>
@@ -8,11 +9,16 @@
 #include <neo/sqlite3/transaction.hpp>
 
 #include <chrono>
+#include <cstdint>
 #include <map>
 #include <mutex>
 #include <optional>
 #include <shared_mutex>
+#include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace bpt {
 
@@ -22,23 +28,117 @@ struct completed_compilation {
     std::int64_t toolchain_hash;
     // The amount of time that the command took to run
     std::chrono::milliseconds duration;
+    // The resources consumed by the most recent measured execution of the command
+    proc_resource_usage usage{};
 };
 
 struct input_file_info {
     fs::path           path;
     fs::file_time_type prev_mtime;
+    // A digest of the content of the file, if one was recorded
+    std::optional<std::uint64_t> prev_digest = std::nullopt;
 };
 
+/**
+ * The compilation and inputs that were recorded for a single output file.
+ */
+struct recorded_compilation {
+    completed_compilation        command;
+    std::vector<input_file_info> inputs;
+};
+
+/**
+ * The binary module interface (BMI) that was most recently generated for a C++ module.
+ */
+struct recorded_module_bmi {
+    fs::path bmi_path;
+    /// The source file that provides the module
+    fs::path provider;
+};
+
+/**
+ * The recorded results of the executions of a test executable.
+ */
+struct recorded_test_result {
+    /// The key of the executable and the environment with which the most recent run of the test
+    /// passed, or zero if that run did not pass
+    std::uint64_t pass_key = 0;
+    /// The durations of the most recent runs of the test, oldest first
+    std::vector<std::chrono::microseconds> durations;
+    /// The resources used by the most recent run of the test
+    proc_resource_usage usage{};
+};
+
+/**
+ * The files and directories that were found by scanning a source root.
+ */
+struct recorded_source_listing {
+    /// Every directory within the root (including the root itself as "."), relative to the root,
+    /// with its modification time when the root was scanned
+    std::vector<std::pair<fs::path, fs::file_time_type>> directories;
+    /// The regular files within the root, relative to the root
+    std::vector<fs::path> files;
+    /// The time at which the scan of the root began
+    fs::file_time_type scan_time = {};
+};
+
+/**
+ * The build database records the commands that were used to produce each output file, and the
+ * input files (with their modification times) that each output was produced from.
+ *
+ * The recorded information is loaded into memory with a single scan of the database the first time
+ * that it is needed, and all queries are answered from memory. Modifications are applied in memory
+ * and only written back to the database (as a diff of the modified outputs) by `flush()`.
+ */
 class database {
+    /**
+     * The in-memory copy of the recorded dependency graph.
+     */
+    struct dep_graph {
+        struct recorded_input {
+            std::size_t  path_index;
+            std::int64_t mtime;
+            /// A digest of the input's content, or zero if none was recorded
+            std::uint64_t digest = 0;
+        };
+
+        struct output_node {
+            /// The most recent compilation. The duration is the running average duration.
+            std::optional<completed_compilation> command;
+            std::int64_t                         n_compilations = 0;
+            std::vector<recorded_input>          inputs;
+            /// Whether this output has been modified since the last flush
+            bool dirty = false;
+        };
+
+        /// Every path known to the database. Other members refer to paths by index in this vector.
+        std::vector<std::string> paths;
+        /// The file_id of each path in the database, or zero if it has not yet been stored.
+        std::vector<std::int64_t> file_ids;
+        std::unordered_map<std::string, std::size_t> path_indices;
+
+        std::unordered_map<std::size_t, output_node> outputs;
+        /// The indices of outputs that must be written by the next flush
+        std::vector<std::size_t> dirty_outputs;
+
+        std::size_t                intern(std::string_view path);
+        std::optional<std::size_t> find(path_ref path) const;
+        output_node&               modify(path_ref output);
+    };
+
     neo::sqlite3::connection              _db;
     mutable neo::sqlite3::statement_cache _stmt_cache{_db};
 
-    std::map<fs::path, std::int64_t> _stored_file_ids_cache;
+    mutable std::optional<dep_graph> _graph;
+
+    mutable std::mutex _mutex;
 
     explicit database(neo::sqlite3::connection db);
     database(const database&) = delete;
 
-    std::int64_t _record_file(path_ref p);
+    dep_graph&   _load_graph() const;
+    std::int64_t _file_id_of(std::size_t path_index);
+    void         _write_outputs(const std::vector<std::size_t>& output_indices);
 
 public:
     static database open(const std::string& db_path);
@@ -48,12 +148,92 @@ public:
         return neo::sqlite3::transaction_guard(_db);
     }
 
-    void record_dep(path_ref input, path_ref output, fs::file_time_type input_mtime);
+    /**
+     * Obtain exclusive access to the database. The database is not otherwise synchronized, so this
+     * must be held by every thread that uses the database while more than one thread may do so.
+     */
+    [[nodiscard]] std::unique_lock<std::mutex> lock() const { return std::unique_lock{_mutex}; }
+
+    void record_dep(path_ref                     input,
+                    path_ref                     output,
+                    fs::file_time_type           input_mtime,
+                    std::optional<std::uint64_t> input_digest = std::nullopt);
+    /**
+     * Update the modification time that is recorded for an existing input of the given output,
+     * e.g. after finding that the content of the input has not changed.
+     */
+    void refresh_dep(path_ref input, path_ref output, fs::file_time_type input_mtime);
     void record_compilation(path_ref file, const completed_compilation& cmd);
     void forget_inputs_of(path_ref file);
 
     std::optional<std::vector<input_file_info>> inputs_of(path_ref file) const;
     std::optional<completed_compilation>        command_of(path_ref file) const;
+
+    /**
+     * Obtain the recorded compilations of many output files at once. Outputs that have no recorded
+     * command or no recorded inputs are omitted from the result.
+     */
+    std::map<fs::path, recorded_compilation>
+    compilations_of(const std::vector<fs::path>& outputs) const;
+
+    /**
+     * Obtain every recorded compilation that has a recorded command and recorded inputs.
+     */
+    std::map<fs::path, recorded_compilation> all_compilations() const;
+
+    /**
+     * Record the BMI file that is generated for the named C++ module. Unlike the other
+     * modifications, this is written to the database immediately.
+     */
+    void record_module_bmi(std::string_view module_name, path_ref bmi, path_ref provider);
+    /**
+     * Obtain the BMI file that was recorded for the named C++ module, if any.
+     */
+    std::optional<recorded_module_bmi> module_bmi(std::string_view module_name) const;
+
+    /**
+     * Record the result of running the given test executable. Like `record_module_bmi`, this is
+     * written to the database immediately. Only the durations of the most recent
+     * `max_test_history` runs of each test are retained. If `duration` is `nullopt` (e.g. the
+     * test was killed after it timed out), only the pass key and resource usage are recorded.
+     */
+    void record_test_result(path_ref                                 executable,
+                            std::uint64_t                            pass_key,
+                            std::optional<std::chrono::microseconds> duration,
+                            const proc_resource_usage&               usage = {});
+    /**
+     * Obtain the recorded results of the given test executable, if it has been run before.
+     */
+    std::optional<recorded_test_result> test_result(path_ref executable) const;
+
+    /// The number of test durations that are retained for each test
+    static constexpr int max_test_history = 20;
+
+    /**
+     * Record the files and directories that were found by scanning the given source root. Like
+     * `record_module_bmi`, this is written to the database immediately.
+     */
+    void record_source_listing(path_ref root, const recorded_source_listing& listing);
+    /**
+     * Obtain the listing that was recorded for the given source root, if any.
+     */
+    std::optional<recorded_source_listing> source_listing(path_ref root) const;
+
+    /**
+     * Record the key of the inputs from which the given file was generated. Like
+     * `record_module_bmi`, this is written to the database immediately.
+     */
+    void record_generated_file(path_ref file, std::uint64_t input_key);
+    /**
+     * Obtain the key that was recorded when the given file was last generated, if any.
+     */
+    std::optional<std::uint64_t> generated_file_key(path_ref file) const;
+
+    /**
+     * Write every modification made since the last flush to the database, in a single
+     * transaction.
+     */
+    void flush();
 };
 
-}  // namespace bpt
\ No newline at end of file
+}  // namespace bpt
@@ -1,7 +1,138 @@
 #include <bpt/db/database.hpp>
+#include <bpt/temp.hpp>
 
 #include <catch2/catch.hpp>
 
 using namespace std::literals;
 
 TEST_CASE("Create a database") { auto db = bpt::database::open(":memory:"s); }
+
+TEST_CASE("Load many recorded compilations at once") {
+    auto db = bpt::database::open(":memory:"s);
+    db.record_compilation("/out/a.o", {"compile a", "", 0, std::chrono::milliseconds(600)});
+    db.record_dep("/src/a.cpp", "/out/a.o", {});
+    db.record_dep("/src/a.hpp", "/out/a.o", {});
+    // A compilation without any recorded inputs is not useful
+    db.record_compilation("/out/b.o", {"compile b", "", 0, std::chrono::milliseconds(600)});
+
+    auto found = db.compilations_of({"/out/a.o", "/out/b.o", "/out/c.o"});
+    REQUIRE(found.size() == 1);
+    auto& a = found.at("/out/a.o");
+    CHECK(a.command.quoted_command == "compile a");
+    CHECK(a.command.duration == std::chrono::milliseconds(600));
+    CHECK(a.inputs.size() == 2);
+}
+
+TEST_CASE("Modifications are written back to the database by flush()") {
+    auto tdir    = bpt::temporary_dir::create();
+    auto db_path = tdir.path() / "bpt.db";
+    {
+        auto db = bpt::database::open(db_path);
+        db.record_compilation(
+            "/out/a.o",
+            {"compile a", "", 0, std::chrono::milliseconds(600), {.peak_rss = 4096}});
+        db.record_dep("/src/a.cpp", "/out/a.o", {});
+        db.flush();
+        // Later modifications are not written without another flush
+        db.forget_inputs_of("/out/a.o");
+        CHECK_FALSE(db.inputs_of("/out/a.o"));
+    }
+    auto db     = bpt::database::open(db_path);
+    auto inputs = db.inputs_of("/out/a.o");
+    REQUIRE(inputs);
+    CHECK(inputs->size() == 1);
+    CHECK(db.command_of("/out/a.o")->quoted_command == "compile a");
+    CHECK(db.command_of("/out/a.o")->usage.peak_rss == 4096);
+}
+
+TEST_CASE("An input listed more than once is recorded once") {
+    auto tdir    = bpt::temporary_dir::create();
+    auto db_path = tdir.path() / "bpt.db";
+    {
+        auto db = bpt::database::open(db_path);
+        db.record_compilation("/out/a.o", {"compile a", "", 0, std::chrono::milliseconds(600)});
+        db.record_dep("/src/a.cpp", "/out/a.o", {});
+        db.record_dep("/src/a.hpp", "/out/a.o", {});
+        db.record_dep("/src/a.hpp", "/out/a.o", {});
+        db.flush();
+    }
+    auto db     = bpt::database::open(db_path);
+    auto inputs = db.inputs_of("/out/a.o");
+    REQUIRE(inputs);
+    CHECK(inputs->size() == 2);
+}
+
+TEST_CASE("Record the BMIs of C++ modules") {
+    auto db = bpt::database::open(":memory:"s);
+    CHECK_FALSE(db.module_bmi("foo"));
+    db.record_module_bmi("foo", "/out/bmi/foo.gcm", "/src/foo.cppm");
+    auto found = db.module_bmi("foo");
+    REQUIRE(found);
+    CHECK(found->bmi_path == "/out/bmi/foo.gcm");
+    CHECK(found->provider == "/src/foo.cppm");
+    // A module that moves to another file replaces the prior record
+    db.record_module_bmi("foo", "/out/bmi/foo.gcm", "/src/other.cppm");
+    CHECK(db.module_bmi("foo")->provider == "/src/other.cppm");
+}
+
+TEST_CASE("Record the results of tests") {
+    auto db = bpt::database::open(":memory:"s);
+    CHECK_FALSE(db.test_result("/out/test.exe"));
+    // Keys use the full 64 bits
+    db.record_test_result("/out/test.exe", 0xfedc'ba98'7654'3210, std::chrono::microseconds(42));
+    auto found = db.test_result("/out/test.exe");
+    REQUIRE(found);
+    CHECK(found->pass_key == 0xfedc'ba98'7654'3210);
+    CHECK(found->durations == std::vector{std::chrono::microseconds(42)});
+    db.record_test_result("/out/test.exe", 0, std::chrono::microseconds(7));
+    found = db.test_result("/out/test.exe");
+    CHECK(found->pass_key == 0);
+    CHECK(found->durations
+          == std::vector{std::chrono::microseconds(42), std::chrono::microseconds(7)});
+    // A run without a duration (e.g. one that timed out) does not add to the history
+    db.record_test_result("/out/test.exe", 0, std::nullopt);
+    found = db.test_result("/out/test.exe");
+    CHECK(found->durations.size() == 2);
+    // The resource usage of the most recent run is kept
+    db.record_test_result("/out/test.exe",
+                          0,
+                          std::chrono::microseconds(9),
+                          {.peak_rss = 8192, .user_cpu = std::chrono::microseconds(5)});
+    found = db.test_result("/out/test.exe");
+    CHECK(found->usage.peak_rss == 8192);
+    CHECK(found->usage.user_cpu == std::chrono::microseconds(5));
+    CHECK(found->durations.size() == 3);
+    // Only the most recent durations are retained
+    for (auto n = 0; n < bpt::database::max_test_history; ++n) {
+        db.record_test_result("/out/test.exe", 0, std::chrono::microseconds(n));
+    }
+    found = db.test_result("/out/test.exe");
+    CHECK(found->durations.size() == bpt::database::max_test_history);
+    CHECK(found->durations.front() == std::chrono::microseconds(0));
+}
+
+TEST_CASE("Record the listings of source directories") {
+    auto db = bpt::database::open(":memory:"s);
+    CHECK_FALSE(db.source_listing("/src"));
+    auto                         mtime = bpt::fs::file_time_type(std::chrono::seconds(1729));
+    bpt::recorded_source_listing listing{
+        .directories = {{".", mtime}, {"sub", mtime + std::chrono::seconds(1)}},
+        .files       = {"a.cpp", "sub/b.cpp"},
+        .scan_time   = mtime + std::chrono::seconds(60),
+    };
+    db.record_source_listing("/src", listing);
+    auto found = db.source_listing("/src");
+    REQUIRE(found);
+    CHECK(found->directories == listing.directories);
+    CHECK(found->files == listing.files);
+    CHECK(found->scan_time == listing.scan_time);
+}
+
+TEST_CASE("Record the keys of generated files") {
+    auto db = bpt::database::open(":memory:"s);
+    CHECK_FALSE(db.generated_file_key("/out/compile_commands.json"));
+    db.record_generated_file("/out/compile_commands.json", 0xfedc'ba98'7654'3210);
+    CHECK(db.generated_file_key("/out/compile_commands.json") == 0xfedc'ba98'7654'3210);
+    db.record_generated_file("/out/compile_commands.json", 42);
+    CHECK(db.generated_file_key("/out/compile_commands.json") == 42u);
+}
@@ -23,6 +23,8 @@ struct project_library {
     /// Dependencies for this specific library
     std::vector<project_dependency> lib_dependencies;
     std::vector<project_dependency> test_dependencies;
+    /// A header to precompile for the library, relative to the library's root directory
+    std::optional<std::filesystem::path> precompiled_header;
 
     static project_library from_json_data(const json5::data&);
 };
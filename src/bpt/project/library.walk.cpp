@@ -15,7 +15,8 @@ project_library project_library::from_json_data(const json5::data& data) {
                         put_into{std::back_inserter(into), name_from_string{}}};
     };
 
-    key_dym_tracker dym{{"name", "path", "using", "test-using", "dependencies"}};
+    key_dym_tracker dym{
+        {"name", "path", "using", "test-using", "dependencies", "precompiled-header"}};
 
     walk(data,
          require_mapping{"Library entries must be a mapping (JSON object)"},
@@ -49,6 +50,10 @@ project_library project_library::from_json_data(const json5::data& data) {
                     require_array{"Library 'test-dependencies' must be an array of dependencies"},
                     for_each{put_into(std::back_inserter(ret.test_dependencies),
                                       project_dependency::from_json_data)}},
+             if_key{"precompiled-header",
+                    require_str{"Library 'precompiled-header' must be a string"},
+                    put_into(ret.precompiled_header,
+                             [](std::string s) { return std::filesystem::path{s}; })},
              dym.rejecter<e_bad_bpt_yaml_key>(),
          });
 
@@ -56,23 +56,25 @@ crs::package_info project_manifest::as_crs_package_meta() const noexcept {
                     auto test_deps = lib.test_dependencies | deps_as_crs | neo::to_vector;
                     extend(test_deps, root_test_dependencies | deps_as_crs);
                     return crs::library_info{
-                        .name              = lib.name,
-                        .path              = lib.relpath,
-                        .intra_using       = lib.intra_using,
-                        .intra_test_using  = lib.intra_test_using,
-                        .dependencies      = std::move(deps),
-                        .test_dependencies = std::move(test_deps),
+                        .name               = lib.name,
+                        .path               = lib.relpath,
+                        .intra_using        = lib.intra_using,
+                        .intra_test_using   = lib.intra_test_using,
+                        .dependencies       = std::move(deps),
+                        .test_dependencies  = std::move(test_deps),
+                        .precompiled_header = lib.precompiled_header,
                     };
                 });
     ret.libraries = neo::to_vector(libs);
     if (ret.libraries.empty()) {
         ret.libraries.push_back(crs::library_info{
-            .name              = name,
-            .path              = ".",
-            .intra_using       = {},
-            .intra_test_using  = {},
-            .dependencies      = {},
-            .test_dependencies = {},
+            .name               = name,
+            .path               = ".",
+            .intra_using        = {},
+            .intra_test_using   = {},
+            .dependencies       = {},
+            .test_dependencies  = {},
+            .precompiled_header = std::nullopt,
         });
         extend(ret.libraries.back().dependencies,
                root_dependencies | std::views::transform(BPT_TL(_1.as_crs_dependency())));
@@ -30,7 +30,10 @@ std::optional<source_kind> bpt::infer_source_kind(path_ref p) noexcept {
         ".c++",
         ".cc",
         ".cpp",
+        ".cppm",
         ".cxx",
+        ".ixx",
+        ".mpp",
     };
     assert(std::is_sorted(header_exts.begin(), header_exts.end()));
     assert(std::is_sorted(header_impl_exts.begin(), header_impl_exts.end()));
@@ -69,6 +69,8 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
     optional<bool> do_optimize;
     optional<bool> runtime_static;
     optional<bool> runtime_debug;
+    optional<bool> cxx_modules;
+    opt_string     archive_mode_str;
 
     // Advanced-mode:
     opt_string     deps_mode_str;
@@ -78,6 +80,8 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
     opt_string     obj_suffix;
     opt_string     exe_prefix;
     opt_string     exe_suffix;
+    opt_string     pch_suffix;
+    opt_string     bmi_suffix;
     opt_string_seq base_warning_flags;
     opt_string_seq base_flags;
     opt_string_seq base_c_flags;
@@ -87,7 +91,14 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
     opt_string_seq define_template;
     opt_string_seq c_compile_file;
     opt_string_seq cxx_compile_file;
+    opt_string_seq create_precompiled_header;
+    opt_string_seq precompiled_header_template;
+    opt_string_seq scan_module_deps;
+    opt_string_seq module_flags;
+    opt_string_seq module_output_template;
+    opt_string_seq module_import_template;
     opt_string_seq create_archive;
+    opt_string_seq update_archive;
     opt_string_seq link_executable;
     opt_string_seq tty_flags;
     opt_string     lang_version_flag_template;
@@ -139,6 +150,8 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
         "debug",
         "optimize",
         "runtime",
+        "cxx_modules",
+        "archive_mode",
     }};
 
     key_dym_tracker adv_dym{{
@@ -152,7 +165,16 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
         "base_cxx_flags",
         "c_compile_file",
         "cxx_compile_file",
+        "create_precompiled_header",
+        "precompiled_header_template",
+        "pch_suffix",
+        "scan_module_deps",
+        "module_flags",
+        "module_output_template",
+        "module_import_template",
+        "bmi_suffix",
         "create_archive",
+        "update_archive",
         "link_executable",
         "obj_prefix",
         "obj_suffix",
@@ -191,6 +213,12 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
             if_key{"optimize",
                    require_type<bool>("`optimize` must be a boolean value"),
                    put_into{do_optimize}},
+            if_key{"cxx_modules",
+                   require_type<bool>("`cxx_modules` must be a boolean value"),
+                   put_into{cxx_modules}},
+            if_key{"archive_mode",
+                   require_type<string>("`archive_mode` must be a string"),
+                   put_into{archive_mode_str}},
             if_key{"flags", extend_flags("flags", common_flags)},
             if_key{"runtime",
                    require_type<json5::data::mapping_type>("'runtime' must be a JSON object"),
@@ -217,7 +245,14 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
                     KEY_EXTEND_FLAGS(base_cxx_flags),
                     KEY_EXTEND_FLAGS(c_compile_file),
                     KEY_EXTEND_FLAGS(cxx_compile_file),
+                    KEY_EXTEND_FLAGS(create_precompiled_header),
+                    KEY_EXTEND_FLAGS(precompiled_header_template),
+                    KEY_EXTEND_FLAGS(scan_module_deps),
+                    KEY_EXTEND_FLAGS(module_flags),
+                    KEY_EXTEND_FLAGS(module_output_template),
+                    KEY_EXTEND_FLAGS(module_import_template),
                     KEY_EXTEND_FLAGS(create_archive),
+                    KEY_EXTEND_FLAGS(update_archive),
                     KEY_EXTEND_FLAGS(link_executable),
                     KEY_EXTEND_FLAGS(tty_flags),
                     KEY_STRING(obj_prefix),
@@ -226,6 +261,8 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
                     KEY_STRING(archive_suffix),
                     KEY_STRING(exe_prefix),
                     KEY_STRING(exe_suffix),
+                    KEY_STRING(pch_suffix),
+                    KEY_STRING(bmi_suffix),
                     KEY_STRING(lang_version_flag_template),
                     KEY_EXTEND_FLAGS(c_source_type_flags),
                     KEY_EXTEND_FLAGS(cxx_source_type_flags),
@@ -295,6 +332,22 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
         }
     }();
 
+    enum class archive_mode_e {
+        recreate,
+        update,
+        thin,
+    } archive_mode = [&] {
+        if (!archive_mode_str.has_value() || archive_mode_str == "recreate") {
+            return archive_mode_e::recreate;
+        } else if (archive_mode_str == "update") {
+            return archive_mode_e::update;
+        } else if (archive_mode_str == "thin") {
+            return archive_mode_e::thin;
+        } else {
+            fail(context, "Invalid `archive_mode` value ‘{}’", *archive_mode_str);
+        }
+    }();
+
     // Now convert the flags we've been given into a real toolchain
     auto get_compiler_executable_path = [&](language lang) -> string {
         if (lang == language::cxx && cxx_compiler) {
@@ -522,6 +575,136 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
     });
     extend(tc.cxx_compile, get_flags(language::cxx));
 
+    tc.cxx_create_pch = read_opt(create_precompiled_header, [&]() -> string_seq {
+        if (!compiler_id) {
+            // No error. Precompiled headers will not be used.
+            return {};
+        }
+        string_seq cxx;
+        if (compiler_launcher) {
+            extend(cxx, *compiler_launcher);
+        }
+        cxx.push_back(get_compiler_executable_path(language::cxx));
+        if (is_msvc) {
+            // cl.exe creates the PCH while compiling a source file. Compile the header itself, and
+            // force-include it so that /Yc knows where the precompiled portion ends.
+            extend(cxx,
+                   {"[flags]", "/c", "/TP", "/Yc[in]", "/FI[in]", "/Fp[out]", "[in]", "/Fo[obj]"});
+        } else if (is_gnu_like) {
+            extend(cxx, {"[flags]", "-x", "c++-header", "-c", "[in]", "-o[out]"});
+        }
+        return cxx;
+    });
+    if (!tc.cxx_create_pch.empty()) {
+        extend(tc.cxx_create_pch, get_flags(language::cxx));
+    }
+
+    tc.pch_template = read_opt(precompiled_header_template, [&]() -> string_seq {
+        if (!compiler_id) {
+            return {};
+        }
+        if (is_msvc) {
+            return {"/Yu[header]", "/FI[header]", "/Fp[pch]"};
+        } else if (is_clang) {
+            return {"-include-pch", "[pch]"};
+        } else if (is_gnu) {
+            // GCC finds the precompiled header alongside the header that it is asked to include
+            return {"-include", "[header]"};
+        }
+        assert(false && "'precompiled_header_template' deduction failed");
+        std::terminate();
+    });
+
+    tc.pch_suffix = read_opt(pch_suffix, [&] {
+        if (is_gnu) {
+            return ".gch";
+        }
+        return ".pch";
+    });
+
+    // Module support is inferred only when requested, as scanning every file has a cost, and
+    // older compilers do not support scanning at all.
+    const bool infer_modules = cxx_modules.value_or(false) && compiler_id.has_value();
+    tc.scan_module_deps      = read_opt(scan_module_deps, [&]() -> string_seq {
+        if (!infer_modules) {
+            // No error. Modules will not be used.
+            return {};
+        }
+        string_seq cxx;
+        if (compiler_launcher) {
+            extend(cxx, *compiler_launcher);
+        }
+        if (is_msvc) {
+            cxx.push_back(get_compiler_executable_path(language::cxx));
+            extend(cxx, {"[flags]", "/TP", "/scanDependencies", "[out]", "[in]", "/Fo[obj]"});
+        } else if (is_clang) {
+            // clang-scan-deps prints the scan result, which will be written to the output file
+            extend(cxx, {"clang-scan-deps", "-format=p1689", "--"});
+            cxx.push_back(get_compiler_executable_path(language::cxx));
+            extend(cxx, {"[flags]", "-x", "c++", "-c", "[in]", "-o", "[obj]"});
+        } else if (is_gnu) {
+            cxx.push_back(get_compiler_executable_path(language::cxx));
+            extend(cxx,
+                   {"[flags]",
+                    "-fmodules-ts",
+                    "-E",
+                    "-x",
+                    "c++",
+                    "[in]",
+                    "-fdeps-format=p1689r5",
+                    "-fdeps-file=[out]",
+                    "-fdeps-target=[obj]",
+                    "-o",
+                    "[out].i"});
+        }
+        return cxx;
+    });
+    if (!tc.scan_module_deps.empty()) {
+        extend(tc.scan_module_deps, get_flags(language::cxx));
+    }
+
+    tc.module_flags = read_opt(module_flags, [&]() -> string_seq {
+        if (infer_modules && is_gnu) {
+            return {"-fmodules-ts", "-fmodule-mapper=[mapper]", "-x", "c++"};
+        }
+        return {};
+    });
+
+    tc.module_output_template = read_opt(module_output_template, [&]() -> string_seq {
+        if (!infer_modules) {
+            return {};
+        }
+        if (is_msvc) {
+            return {"/interface", "/TP", "/ifcOutput", "[bmi]"};
+        } else if (is_clang) {
+            return {"-x", "c++-module", "-fmodule-output=[bmi]"};
+        }
+        // GCC finds the output BMI using the module mapper
+        return {};
+    });
+
+    tc.module_import_template = read_opt(module_import_template, [&]() -> string_seq {
+        if (!infer_modules) {
+            return {};
+        }
+        if (is_msvc) {
+            return {"/reference", "[name]=[bmi]"};
+        } else if (is_clang) {
+            return {"-fmodule-file=[name]=[bmi]"};
+        }
+        // GCC finds imported BMIs using the module mapper
+        return {};
+    });
+
+    tc.bmi_suffix = read_opt(bmi_suffix, [&] {
+        if (is_msvc) {
+            return ".ifc";
+        } else if (is_clang) {
+            return ".pcm";
+        }
+        return ".gcm";
+    });
+
     tc.consider_envs = read_opt(consider_env, [&]() -> string_seq {
         if (is_msvc) {
             return {"CL", "_CL_", "INCLUDE", "LIBPATH", "LIB"};
@@ -633,14 +816,41 @@ toolchain bpt::parse_toolchain_json_data(const json5::data& dat, std::string_vie
             fail(context, "Unable to deduce archive creation rules without a 'compiler_id'");
         }
         if (is_msvc) {
+            if (archive_mode == archive_mode_e::thin) {
+                fail(context, "MSVC does not support thin archives");
+            }
             return {"lib", "/nologo", "/OUT:[out]", "[in]"};
         } else if (is_gnu_like) {
+            if (archive_mode == archive_mode_e::thin) {
+                // 'P' matches members by their full path, so that objects with the same filename
+                // in different directories are not replaced by each other
+                return {"ar", "rcsTP", "[out]", "[in]"};
+            }
             return {"ar", "rcs", "[out]", "[in]"};
         }
         assert(false && "No archive command");
         std::terminate();
     });
 
+    tc.update_archive = read_opt(update_archive, [&]() -> string_seq {
+        if (archive_mode == archive_mode_e::recreate) {
+            // Archives are always created from scratch
+            return {};
+        }
+        if (!compiler_id) {
+            fail(context, "Unable to deduce archive update rules without a 'compiler_id'");
+        }
+        if (is_msvc) {
+            // lib.exe reads the existing archive as an input, and replaces its matching members
+            return {"lib", "/nologo", "/OUT:[out]", "[out]", "[in]"};
+        } else if (is_gnu_like) {
+            // 'r' replaces the existing members. The archive command is the same.
+            return tc.link_archive;
+        }
+        assert(false && "No archive update command");
+        std::terminate();
+    });
+
     tc.link_exe = read_opt(link_executable, [&]() -> string_seq {
         if (!compiler_id) {
             fail(context, "Unable to deduce how to link executables without a 'compiler_id'");
@@ -1,5 +1,6 @@
 #include <bpt/toolchain/from_json.hpp>
 
+#include <bpt/util/fs/io.hpp>
 #include <bpt/util/proc.hpp>
 
 #include <catch2/catch.hpp>
@@ -311,3 +312,184 @@ TEST_CASE("Manipulate a toolchain and file compilation") {
                                       "-fPIC",
                                       "-pthread"});
 }
+
+TEST_CASE("Precompiled header commands") {
+    auto dir = bpt::fs::temp_directory_path() / "bpt-pch-command-test";
+    bpt::fs::remove_all(dir);
+    auto stub = dir / "pch.hpp";
+
+    auto tc = bpt::parse_toolchain_json5("{compiler_id: 'gnu'}");
+    CHECK(tc.supports_precompiled_headers());
+    CHECK(tc.precompiled_header_file(stub) == dir / "pch.hpp.gch");
+    CHECK_FALSE(tc.precompiled_header_object(dir / "pch.hpp.gch"));
+
+    bpt::compile_file_spec create;
+    create.source_path               = "src/pch.hpp";
+    create.out_path                  = dir / "pch.hpp.gch";
+    create.precompiled_header        = stub;
+    create.create_precompiled_header = true;
+    auto cmd = tc.create_compile_command(create, bpt::fs::current_path(), bpt::toolchain_knobs{});
+    CHECK(cmd.command
+          == std::vector<std::string>{"g++",
+                                      "-MD",
+                                      "-MF",
+                                      (dir / "pch.hpp.gch.d").string(),
+                                      "-MQ",
+                                      (dir / "pch.hpp.gch").string(),
+                                      "-x",
+                                      "c++-header",
+                                      "-c",
+                                      stub.string(),
+                                      "-o" + (dir / "pch.hpp.gch").string(),
+                                      "-fPIC",
+                                      "-pthread"});
+    // The stub header includes the real header
+    CHECK(bpt::fs::is_regular_file(stub));
+
+    bpt::compile_file_spec use;
+    use.source_path        = "foo.cpp";
+    use.out_path           = "foo.o";
+    use.precompiled_header = stub;
+    cmd = tc.create_compile_command(use, bpt::fs::current_path(), bpt::toolchain_knobs{});
+    CHECK(cmd.command
+          == std::vector<std::string>{"g++",
+                                      "-include",
+                                      stub.string(),
+                                      "-MD",
+                                      "-MF",
+                                      "foo.o.d",
+                                      "-MQ",
+                                      "foo.o",
+                                      "-c",
+                                      "foo.cpp",
+                                      "-ofoo.o",
+                                      "-fPIC",
+                                      "-pthread"});
+
+    // C files do not use the C++ precompiled header
+    use.source_path = "foo.c";
+    cmd = tc.create_compile_command(use, bpt::fs::current_path(), bpt::toolchain_knobs{});
+    CHECK(bpt::quote_command(cmd.command)
+          == "gcc -MD -MF foo.o.d -MQ foo.o -c foo.c -ofoo.o -fPIC -pthread");
+
+    tc = bpt::parse_toolchain_json5("{compiler_id: 'clang'}");
+    use.source_path = "foo.cpp";
+    cmd = tc.create_compile_command(use, bpt::fs::current_path(), bpt::toolchain_knobs{});
+    CHECK(cmd.command.at(1) == "-include-pch");
+    CHECK(cmd.command.at(2) == (dir / "pch.hpp.pch").string());
+
+    tc = bpt::parse_toolchain_json5("{compiler_id: 'msvc'}");
+    CHECK(tc.precompiled_header_object(dir / "pch.hpp.pch") == dir / "pch.hpp.pch.obj");
+    create.out_path = dir / "pch.hpp.pch";
+    cmd = tc.create_compile_command(create, bpt::fs::current_path(), bpt::toolchain_knobs{});
+    CHECK(bpt::quote_command(cmd.command)
+          == bpt::quote_command(std::vector<std::string>{
+              "cl.exe",
+              "/showIncludes",
+              "/c",
+              "/TP",
+              "/Yc" + stub.string(),
+              "/FI" + stub.string(),
+              "/Fp" + (dir / "pch.hpp.pch").string(),
+              stub.string(),
+              "/Fo" + (dir / "pch.hpp.pch.obj").string(),
+              "/MT",
+              "/nologo",
+              "/permissive-",
+              "/EHsc",
+          }));
+
+    bpt::fs::remove_all(dir);
+}
+
+TEST_CASE("C++ module commands") {
+    auto tc = bpt::parse_toolchain_json5("{compiler_id: 'gnu'}");
+    CHECK_FALSE(tc.supports_modules());
+
+    auto dir = bpt::fs::temp_directory_path() / "bpt-modules-command-test";
+    bpt::fs::remove_all(dir);
+
+    tc = bpt::parse_toolchain_json5("{compiler_id: 'gnu', cxx_modules: true}");
+    CHECK(tc.supports_modules());
+    CHECK(tc.module_bmi_file("mod:part", dir) == dir / "mod-part.gcm");
+
+    bpt::compile_file_spec scan;
+    scan.source_path      = "foo.cppm";
+    scan.out_path         = "foo.o.ddi";
+    scan.scan_module_deps = true;
+    auto cmd = tc.create_compile_command(scan, bpt::fs::current_path(), bpt::toolchain_knobs{});
+    CHECK(bpt::quote_command(cmd.command)
+          == "g++ -MD -MF foo.o.ddi.d -MQ foo.o.ddi -fmodules-ts -E -x c++ foo.cppm "
+             "-fdeps-format=p1689r5 -fdeps-file=foo.o.ddi -fdeps-target=foo.o -o foo.o.ddi.i "
+             "-fPIC -pthread");
+    CHECK_FALSE(cmd.output_from_stdout);
+
+    // GCC is given the BMIs using a module mapper file
+    bpt::compile_file_spec compile;
+    compile.source_path    = "foo.cppm";
+    compile.out_path       = dir / "foo.o";
+    compile.module_output  = bpt::module_bmi{"foo", dir / "foo.gcm"};
+    compile.module_imports = {bpt::module_bmi{"bar", dir / "bar.gcm"}};
+    cmd = tc.create_compile_command(compile, bpt::fs::current_path(), bpt::toolchain_knobs{});
+    CHECK(cmd.command.at(1) == "-fmodules-ts");
+    CHECK(cmd.command.at(2) == "-fmodule-mapper=" + (dir / "foo.o.modmap").string());
+    CHECK(cmd.imported_bmis == std::vector<bpt::fs::path>{dir / "bar.gcm"});
+    CHECK(bpt::read_file(dir / "foo.o.modmap")
+          == "foo " + (dir / "foo.gcm").string() + "\nbar " + (dir / "bar.gcm").string() + "\n");
+
+    // clang-scan-deps writes its result to stdout
+    tc  = bpt::parse_toolchain_json5("{compiler_id: 'clang', cxx_modules: true}");
+    cmd = tc.create_compile_command(scan, bpt::fs::current_path(), bpt::toolchain_knobs{});
+    CHECK(cmd.command.at(0) == "clang-scan-deps");
+    CHECK(cmd.output_from_stdout == bpt::fs::path("foo.o.ddi"));
+
+    compile.out_path = "foo.o";
+    cmd = tc.create_compile_command(compile, bpt::fs::current_path(), bpt::toolchain_knobs{});
+    CHECK(bpt::quote_command(cmd.command)
+          == bpt::quote_command(std::vector<std::string>{
+              "clang++",
+              "-x",
+              "c++-module",
+              "-fmodule-output=" + (dir / "foo.gcm").string(),
+              "-fmodule-file=bar=" + (dir / "bar.gcm").string(),
+              "-MD",
+              "-MF",
+              "foo.o.d",
+              "-MQ",
+              "foo.o",
+              "-c",
+              "foo.cppm",
+              "-ofoo.o",
+              "-fPIC",
+              "-pthread",
+          }));
+}
+
+TEST_CASE("Archive update commands") {
+    bpt::archive_spec ar;
+    ar.input_files = {"foo.o", "bar.o"};
+    ar.out_path    = "libfoo.a";
+
+    auto tc = bpt::parse_toolchain_json5("{compiler_id: 'gnu'}");
+    CHECK_FALSE(tc.supports_archive_update());
+
+    tc = bpt::parse_toolchain_json5("{compiler_id: 'gnu', archive_mode: 'update'}");
+    CHECK(tc.supports_archive_update());
+    auto cmd = tc.create_archive_update_command(ar, bpt::fs::current_path(), {});
+    CHECK(bpt::quote_command(cmd) == "ar rcs libfoo.a foo.o bar.o");
+
+    tc = bpt::parse_toolchain_json5("{compiler_id: 'clang', archive_mode: 'thin'}");
+    CHECK(tc.supports_archive_update());
+    cmd = tc.create_archive_command(ar, bpt::fs::current_path(), {});
+    CHECK(bpt::quote_command(cmd) == "ar rcsTP libfoo.a foo.o bar.o");
+    cmd = tc.create_archive_update_command(ar, bpt::fs::current_path(), {});
+    CHECK(bpt::quote_command(cmd) == "ar rcsTP libfoo.a foo.o bar.o");
+
+    tc = bpt::parse_toolchain_json5("{compiler_id: 'msvc', archive_mode: 'update'}");
+    ar.out_path = "foo.lib";
+    cmd         = tc.create_archive_update_command(ar, bpt::fs::current_path(), {});
+    CHECK(bpt::quote_command(cmd) == "lib /nologo /OUT:foo.lib foo.lib foo.o bar.o");
+
+    CHECK_THROWS(bpt::parse_toolchain_json5("{compiler_id: 'msvc', archive_mode: 'thin'}"));
+    CHECK_THROWS(bpt::parse_toolchain_json5("{compiler_id: 'gnu', archive_mode: 'append'}"));
+}
@@ -17,6 +17,7 @@ struct toolchain_prep {
     string_seq external_include_template;
     string_seq define_template;
     string_seq link_archive;
+    string_seq update_archive;
     string_seq link_exe;
     string_seq warning_flags;
     string_seq tty_flags;
@@ -27,6 +28,12 @@ struct toolchain_prep {
     string_seq c_source_type_flags;
     string_seq cxx_source_type_flags;
     string_seq syntax_only_flags;
+    string_seq cxx_create_pch;
+    string_seq pch_template;
+    string_seq scan_module_deps;
+    string_seq module_flags;
+    string_seq module_output_template;
+    string_seq module_import_template;
 
     std::string archive_prefix;
     std::string archive_suffix;
@@ -34,6 +41,8 @@ struct toolchain_prep {
     std::string object_suffix;
     std::string exe_prefix;
     std::string exe_suffix;
+    std::string pch_suffix;
+    std::string bmi_suffix;
 
     enum file_deps_mode deps_mode;
 
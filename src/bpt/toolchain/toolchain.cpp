@@ -21,6 +21,7 @@
 #include <range/v3/view/cartesian_product.hpp>
 #include <range/v3/view/transform.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <initializer_list>
 #include <optional>
@@ -43,6 +44,7 @@ toolchain toolchain::realize(const toolchain_prep& prep) {
     ret._extern_inc_template = prep.external_include_template;
     ret._def_template        = prep.define_template;
     ret._link_archive        = prep.link_archive;
+    ret._update_archive      = prep.update_archive;
     ret._link_exe            = prep.link_exe;
     ret._warning_flags       = prep.warning_flags;
     ret._archive_prefix      = prep.archive_prefix;
@@ -54,9 +56,17 @@ toolchain toolchain::realize(const toolchain_prep& prep) {
     ret._deps_mode           = prep.deps_mode;
     ret._tty_flags           = prep.tty_flags;
 
-    ret._c_source_type_flags   = prep.c_source_type_flags;
-    ret._cxx_source_type_flags = prep.cxx_source_type_flags;
-    ret._syntax_only_flags     = prep.syntax_only_flags;
+    ret._c_source_type_flags    = prep.c_source_type_flags;
+    ret._cxx_source_type_flags  = prep.cxx_source_type_flags;
+    ret._syntax_only_flags      = prep.syntax_only_flags;
+    ret._cxx_create_pch         = prep.cxx_create_pch;
+    ret._pch_template           = prep.pch_template;
+    ret._pch_suffix             = prep.pch_suffix;
+    ret._scan_module_deps       = prep.scan_module_deps;
+    ret._module_flags           = prep.module_flags;
+    ret._module_output_template = prep.module_output_template;
+    ret._module_import_template = prep.module_import_template;
+    ret._bmi_suffix             = prep.bmi_suffix;
 
     ret._hash = prep.compute_hash();
 
@@ -75,6 +85,31 @@ vector<string> toolchain::definition_args(std::string_view s) const noexcept {
     return replace(_def_template, "[def]", s);
 }
 
+fs::path toolchain::precompiled_header_file(path_ref header) const noexcept {
+    auto ret = header;
+    ret += _pch_suffix;
+    return ret;
+}
+
+std::optional<fs::path> toolchain::precompiled_header_object(path_ref pch_file) const noexcept {
+    // Only toolchains that name an [obj] in their PCH command will generate an object file
+    auto has_obj = std::ranges::any_of(_cxx_create_pch, [](const string& arg) {
+        return arg.find("[obj]") != arg.npos;
+    });
+    if (!has_obj) {
+        return std::nullopt;
+    }
+    auto ret = pch_file;
+    ret += _object_suffix;
+    return ret;
+}
+
+fs::path toolchain::module_bmi_file(std::string_view module_name, path_ref dir) const noexcept {
+    // Module partitions are named 'mod:part', but ':' is not valid in filenames on Windows
+    auto filename = replace(module_name, ":", "-");
+    return dir / (filename + _bmi_suffix);
+}
+
 static fs::path shortest_path_from(path_ref file, path_ref base) {
     auto relative = file.lexically_normal().lexically_proximate(base);
     auto abs      = file.lexically_normal();
@@ -140,6 +175,74 @@ compile_command_info toolchain::create_compile_command(const compile_file_spec&
         bpt::write_file(in_file, fmt::format("#include \"{}\"", abs_path.string()));
     }
 
+    const bool              create_pch = spec.create_precompiled_header && spec.precompiled_header;
+    std::optional<fs::path> used_pch_file;
+    if (create_pch) {
+        // Precompile a header that #includes the real one. The precompiled header file is placed
+        // alongside it, where compilers will look for it when the header is included.
+        in_file = *spec.precompiled_header;
+        bpt_log(trace, "Precompiled header stub file: {}", in_file);
+
+        // Don't touch an unchanged stub, as that would cause the header to be precompiled again
+        auto abs_path = bpt::resolve_path_weak(spec.source_path);
+        auto content  = fmt::format("#include \"{}\"\n", abs_path.string());
+        if (!fs::is_regular_file(in_file) || bpt::read_file(in_file) != content) {
+            fs::create_directories(in_file.parent_path());
+            bpt::write_file(in_file, content);
+        }
+    } else if (spec.precompiled_header && lang == language::cxx && !spec.syntax_only
+               && !spec.scan_module_deps && supports_precompiled_headers()) {
+        used_pch_file = precompiled_header_file(*spec.precompiled_header);
+        bpt_log(trace, "Using precompiled header: {}", *used_pch_file);
+        auto pch_args = replace(_pch_template, "[header]", spec.precompiled_header->string());
+        pch_args      = replace(pch_args, "[pch]", used_pch_file->string());
+        extend(flags, pch_args);
+    }
+
+    vector<fs::path> imported_bmis;
+    const bool       uses_modules = spec.module_output || !spec.module_imports.empty();
+    if (uses_modules && lang == language::cxx && !spec.syntax_only && !spec.scan_module_deps
+        && supports_modules()) {
+        // Some compilers (i.e. GCC) are told where to find BMIs with a module mapper file, rather
+        // than with command-line arguments. Write it alongside the output.
+        auto mapper_path = spec.out_path;
+        mapper_path += ".modmap";
+        auto uses_mapper = std::ranges::any_of(_module_flags, [](const string& arg) {
+            return arg.find("[mapper]") != arg.npos;
+        });
+        if (uses_mapper) {
+            std::string content;
+            if (spec.module_output) {
+                content += fmt::format("{} {}\n",
+                                       spec.module_output->name,
+                                       spec.module_output->bmi_path.string());
+            }
+            for (auto& imp : spec.module_imports) {
+                content += fmt::format("{} {}\n", imp.name, imp.bmi_path.string());
+            }
+            if (!fs::is_regular_file(mapper_path) || bpt::read_file(mapper_path) != content) {
+                fs::create_directories(mapper_path.parent_path());
+                bpt::write_file(mapper_path, content);
+            }
+        }
+        extend(flags, replace(_module_flags, "[mapper]", mapper_path.string()));
+
+        if (spec.module_output) {
+            bpt_log(trace,
+                    "Export module '{}' to [{}]",
+                    spec.module_output->name,
+                    spec.module_output->bmi_path.string());
+            auto args = replace(_module_output_template, "[name]", spec.module_output->name);
+            extend(flags, replace(args, "[bmi]", spec.module_output->bmi_path.string()));
+        }
+        for (auto& imp : spec.module_imports) {
+            bpt_log(trace, "Import module '{}' from [{}]", imp.name, imp.bmi_path.string());
+            auto args = replace(_module_import_template, "[name]", imp.name);
+            extend(flags, replace(args, "[bmi]", imp.bmi_path.string()));
+            imported_bmis.push_back(imp.bmi_path);
+        }
+    }
+
     bpt_log(trace, "#include search-dirs:");
     for (auto&& inc_dir : spec.include_dirs) {
         bpt_log(trace, "  - search: {}", inc_dir.string());
@@ -185,27 +288,51 @@ compile_command_info toolchain::create_compile_command(const compile_file_spec&
         flags.push_back("/showIncludes");
     }
 
-    vector<string> command;
-    auto&          cmd_template = lang == language::c ? _c_compile : _cxx_compile;
+    vector<string>          command;
+    std::optional<fs::path> obj_file;
+    std::optional<fs::path> output_from_stdout;
+    if (create_pch) {
+        obj_file = precompiled_header_object(spec.out_path);
+    } else if (spec.scan_module_deps) {
+        // The scan result is named for the object file that would be compiled from the source
+        obj_file = fs::path(spec.out_path).replace_extension();
+        // Some scanning tools (i.e. clang-scan-deps) can only print their result
+        auto names_output = std::ranges::any_of(_scan_module_deps, [](const string& arg) {
+            return arg.find("[out]") != arg.npos;
+        });
+        if (!names_output) {
+            output_from_stdout = spec.out_path;
+        }
+    }
+    auto& cmd_template = create_pch ? _cxx_create_pch
+        : spec.scan_module_deps     ? _scan_module_deps
+        : lang == language::c       ? _c_compile
+                                    : _cxx_compile;
     for (auto arg : cmd_template) {
         if (arg == "[flags]") {
             extend(command, flags);
         } else {
             arg = replace(arg, "[in]", in_file.string());
             arg = replace(arg, "[out]", spec.out_path.string());
+            if (obj_file) {
+                arg = replace(arg, "[obj]", obj_file->string());
+            }
             command.push_back(arg);
         }
     }
-    return {std::move(command), std::move(gnu_depfile_path)};
+    return {std::move(command),
+            std::move(gnu_depfile_path),
+            std::move(used_pch_file),
+            std::move(imported_bmis),
+            std::move(output_from_stdout)};
 }
 
-vector<string> toolchain::create_archive_command(const archive_spec& spec,
-                                                 path_ref            cwd,
-                                                 toolchain_knobs) const noexcept {
+static vector<string> expand_archive_template(const vector<string>& tmpl,
+                                              const archive_spec&   spec,
+                                              path_ref              cwd) noexcept {
     vector<string> cmd;
-    bpt_log(trace, "Creating archive command [output: {}]", spec.out_path.string());
-    auto out_arg = shortest_path_from(spec.out_path, cwd).string();
-    for (auto& arg : _link_archive) {
+    auto           out_arg = shortest_path_from(spec.out_path, cwd).string();
+    for (auto& arg : tmpl) {
         if (arg == "[in]") {
             bpt_log(trace, "Expand [in] placeholder:");
             for (auto&& in : spec.input_files) {
@@ -219,6 +346,20 @@ vector<string> toolchain::create_archive_command(const archive_spec& spec,
     return cmd;
 }
 
+vector<string> toolchain::create_archive_command(const archive_spec& spec,
+                                                 path_ref            cwd,
+                                                 toolchain_knobs) const noexcept {
+    bpt_log(trace, "Creating archive command [output: {}]", spec.out_path.string());
+    return expand_archive_template(_link_archive, spec, cwd);
+}
+
+vector<string> toolchain::create_archive_update_command(const archive_spec& spec,
+                                                        path_ref            cwd,
+                                                        toolchain_knobs) const noexcept {
+    bpt_log(trace, "Creating archive update command [output: {}]", spec.out_path.string());
+    return expand_archive_template(_update_archive, spec, cwd);
+}
+
 vector<string> toolchain::create_link_executable_command(const link_exe_spec& spec,
                                                          path_ref             cwd,
                                                          toolchain_knobs) const noexcept {
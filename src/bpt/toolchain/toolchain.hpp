@@ -23,6 +23,16 @@ struct toolchain_knobs {
     std::optional<std::string> cache_buster{};
 };
 
+/**
+ * A named C++ module and the path to its built module interface (BMI) file
+ */
+struct module_bmi {
+    std::string name;
+    fs::path    bmi_path;
+
+    auto operator<=>(const module_bmi&) const noexcept = default;
+};
+
 struct compile_file_spec {
     fs::path                 source_path;
     fs::path                 out_path;
@@ -32,11 +42,29 @@ struct compile_file_spec {
     language                 lang                  = language::automatic;
     bool                     enable_warnings       = false;
     bool                     syntax_only           = false;
+    /// The header that is precompiled by this compilation, or that this compilation should use
+    std::optional<fs::path> precompiled_header = std::nullopt;
+    /// If `true`, this compilation creates `precompiled_header` rather than using it
+    bool create_precompiled_header = false;
+    /// If `true`, scan the source for its module dependencies into `out_path` rather than compiling
+    bool scan_module_deps = false;
+    /// The named module that is exported by this compilation, and where its BMI will be written
+    std::optional<module_bmi> module_output = std::nullopt;
+    /// The named modules that are imported by this compilation
+    std::vector<module_bmi> module_imports = {};
 };
 
 struct compile_command_info {
     std::vector<std::string> command;
     std::optional<fs::path>  gnu_depfile_path;
+    /// The precompiled header file that the command uses, which compilers do not report as a
+    /// dependency of the compilation
+    std::optional<fs::path> precompiled_header_file = std::nullopt;
+    /// The BMI files that the command reads, which compilers do not report as dependencies either
+    std::vector<fs::path> imported_bmis = {};
+    /// If set, the command prints its result rather than writing it, and the output must be
+    /// written to this file
+    std::optional<fs::path> output_from_stdout = std::nullopt;
 };
 
 struct archive_spec {
@@ -60,12 +88,19 @@ class toolchain {
     string_seq _extern_inc_template;
     string_seq _def_template;
     string_seq _link_archive;
+    string_seq _update_archive;
     string_seq _link_exe;
     string_seq _warning_flags;
     string_seq _tty_flags;
     string_seq _c_source_type_flags;
     string_seq _cxx_source_type_flags;
     string_seq _syntax_only_flags;
+    string_seq _cxx_create_pch;
+    string_seq _pch_template;
+    string_seq _scan_module_deps;
+    string_seq _module_flags;
+    string_seq _module_output_template;
+    string_seq _module_import_template;
 
     std::string _archive_prefix;
     std::string _archive_suffix;
@@ -73,6 +108,8 @@ class toolchain {
     std::string _object_suffix;
     std::string _exe_prefix;
     std::string _exe_suffix;
+    std::string _pch_suffix;
+    std::string _bmi_suffix;
 
     enum file_deps_mode _deps_mode;
 
@@ -88,6 +125,32 @@ public:
     auto& executable_suffix() const noexcept { return _exe_suffix; }
     auto  deps_mode() const noexcept { return _deps_mode; }
 
+    /**
+     * Whether this toolchain knows how to create and use precompiled headers
+     */
+    bool supports_precompiled_headers() const noexcept {
+        return !_cxx_create_pch.empty() && !_pch_template.empty();
+    }
+    /**
+     * Get the path of the precompiled header file that will be generated for the given header
+     */
+    fs::path precompiled_header_file(path_ref header) const noexcept;
+    /**
+     * Get the path of the object file that is generated alongside the given precompiled header
+     * file, if the toolchain generates one. That object file must be linked into any executable
+     * that uses the precompiled header.
+     */
+    std::optional<fs::path> precompiled_header_object(path_ref pch_file) const noexcept;
+
+    /**
+     * Whether this toolchain knows how to scan for and build C++ named modules
+     */
+    bool supports_modules() const noexcept { return !_scan_module_deps.empty(); }
+    /**
+     * Get the path of the BMI file for the named module, within the given directory
+     */
+    fs::path module_bmi_file(std::string_view module_name, path_ref dir) const noexcept;
+
     std::vector<std::string> definition_args(std::string_view s) const noexcept;
     std::vector<std::string> include_args(const fs::path& p) const noexcept;
     std::vector<std::string> external_include_args(const fs::path& p) const noexcept;
@@ -98,6 +161,18 @@ public:
     std::vector<std::string>
     create_archive_command(const archive_spec&, path_ref cwd, toolchain_knobs) const noexcept;
 
+    /**
+     * Whether this toolchain knows how to add or replace members of an existing archive
+     */
+    bool supports_archive_update() const noexcept { return !_update_archive.empty(); }
+    /**
+     * Create a command that replaces the given input files within the existing archive, rather than
+     * creating the archive from scratch.
+     */
+    std::vector<std::string> create_archive_update_command(const archive_spec&,
+                                                           path_ref cwd,
+                                                           toolchain_knobs) const noexcept;
+
     std::vector<std::string> create_link_executable_command(const link_exe_spec&,
                                                             path_ref cwd,
                                                             toolchain_knobs) const noexcept;
@@ -11,7 +11,9 @@
 #include <fmt/ranges.h>
 #include <range/v3/view/transform.hpp>
 
+#include <algorithm>
 #include <map>
+#include <set>
 #include <stdexcept>
 #include <string_view>
 
@@ -44,37 +46,6 @@ usage_requirement_map usage_requirement_map::from_lm_index(const lm::index& idx)
     return ret;
 }
 
-std::vector<fs::path> usage_requirement_map::link_paths(const lm::usage& key) const {
-    auto req = get(key);
-    if (!req) {
-        BOOST_LEAF_THROW_EXCEPTION(e_nonesuch_library{key}, BPT_ERR_REF("unknown-usage"));
-    }
-    std::vector<fs::path> ret;
-    if (req->linkable_path) {
-        ret.push_back(*req->linkable_path);
-    }
-    for (const auto& dep : req->uses) {
-        extend(ret, link_paths(dep));
-    }
-    for (const auto& link : req->links) {
-        extend(ret, link_paths(link));
-    }
-    return ret;
-}
-
-std::vector<fs::path> usage_requirement_map::include_paths(const lm::usage& usage) const {
-    std::vector<fs::path> ret;
-    auto                  lib = get(usage);
-    if (!lib) {
-        BOOST_LEAF_THROW_EXCEPTION(e_nonesuch_library{usage}, BPT_ERR_REF("unknown-usage"));
-    }
-    extend(ret, lib->include_paths);
-    for (const auto& transitive : lib->uses) {
-        extend(ret, include_paths(transitive));
-    }
-    return ret;
-}
-
 namespace {
 // The DFS visited status for a vertex
 enum class vertex_status {
@@ -196,3 +167,148 @@ void usage_requirements::verify_acyclic() const {
                                    BPT_ERR_REF("cyclic-usage"));
     }
 }
+
+namespace {
+
+/**
+ * Remove duplicates from a sequence, keeping the last occurrence of each item. If the sequence is
+ * a concatenation of topologically ordered sequences, the result is also topologically ordered.
+ */
+template <typename T>
+void unique_keep_last(std::vector<T>& items) {
+    std::set<T>    seen;
+    std::vector<T> ret;
+    for (auto it = items.rbegin(); it != items.rend(); ++it) {
+        if (seen.insert(*it).second) {
+            ret.push_back(std::move(*it));
+        }
+    }
+    std::reverse(ret.begin(), ret.end());
+    items = std::move(ret);
+}
+
+/**
+ * Remove duplicates from a sequence, keeping the first occurrence of each item.
+ */
+template <typename T>
+void unique_keep_first(std::vector<T>& items) {
+    std::set<T> seen;
+    std::erase_if(items, [&](const T& item) { return !seen.insert(item).second; });
+}
+
+/**
+ * Computes the closures of libraries, memoizing the closure of each library so that shared
+ * dependencies are only visited once.
+ */
+struct closure_builder {
+    const usage_requirement_map&        reqs;
+    bool                                follow_links;
+    std::map<lm::usage, usage_closure>& memo;
+    std::set<lm::usage>                 active{};
+
+    const usage_closure& get(const lm::usage& usage) {
+        auto found = memo.find(usage);
+        if (found != memo.end()) {
+            return found->second;
+        }
+
+        usage_closure ret;
+        auto          lib = reqs.get(usage);
+        if (!lib) {
+            ret.missing = usage;
+            return memo.emplace(usage, std::move(ret)).first->second;
+        }
+
+        // `uses` cannot form a cycle, but `links` are not checked
+        active.insert(usage);
+        std::vector<lm::usage> deps;
+        auto                   add_dep = [&](const lm::usage& dep) {
+            if (active.contains(dep)) {
+                return;
+            }
+            auto& dep_closure = get(dep);
+            extend(deps, dep_closure.libraries);
+            if (!ret.missing) {
+                ret.missing = dep_closure.missing;
+            }
+        };
+        for (auto& dep : lib->uses) {
+            add_dep(dep);
+        }
+        if (follow_links) {
+            for (auto& dep : lib->links) {
+                add_dep(dep);
+            }
+        }
+        active.erase(usage);
+
+        unique_keep_last(deps);
+        ret.libraries.push_back(usage);
+        extend(ret.libraries, deps);
+        // Missing libraries never appear in a closure
+        for (auto& dep : ret.libraries) {
+            auto dep_lib = reqs.get(dep);
+            if (!follow_links) {
+                extend(ret.paths, dep_lib->include_paths);
+            } else if (dep_lib->linkable_path) {
+                ret.paths.push_back(*dep_lib->linkable_path);
+            }
+        }
+        if (follow_links) {
+            unique_keep_last(ret.paths);
+        } else {
+            unique_keep_first(ret.paths);
+        }
+        return memo.emplace(usage, std::move(ret)).first->second;
+    }
+};
+
+const usage_closure& find_closure(const std::map<lm::usage, usage_closure>& closures,
+                                  const lm::usage&                          usage) {
+    auto found = closures.find(usage);
+    if (found == closures.end()) {
+        BOOST_LEAF_THROW_EXCEPTION(e_nonesuch_library{usage}, BPT_ERR_REF("unknown-usage"));
+    }
+    if (found->second.missing) {
+        BOOST_LEAF_THROW_EXCEPTION(e_nonesuch_library{*found->second.missing},
+                                   BPT_ERR_REF("unknown-usage"));
+    }
+    return found->second;
+}
+
+}  // namespace
+
+void usage_requirements::compute_closures() {
+    closure_builder includes{_reqs, false, _include_closures};
+    closure_builder links{_reqs, true, _link_closures};
+    for (auto& [usage, lib] : _reqs) {
+        includes.get(usage);
+        links.get(usage);
+    }
+}
+
+const std::vector<fs::path>& usage_requirements::link_paths(const lm::usage& key) const {
+    return find_closure(_link_closures, key).paths;
+}
+
+std::vector<fs::path> usage_requirements::link_paths(const std::vector<lm::usage>& keys) const {
+    std::vector<fs::path> ret;
+    for (auto& key : keys) {
+        extend(ret, link_paths(key));
+    }
+    unique_keep_last(ret);
+    return ret;
+}
+
+const std::vector<fs::path>& usage_requirements::include_paths(const lm::usage& req) const {
+    return find_closure(_include_closures, req).paths;
+}
+
+std::vector<fs::path> usage_requirements::include_paths(const std::vector<lm::usage>& reqs) const {
+    std::vector<fs::path> ret;
+    for (auto& req : reqs) {
+        extend(ret, include_paths(req));
+    }
+    unique_keep_first(ret);
+    return ret;
+}
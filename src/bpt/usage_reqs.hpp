@@ -10,6 +10,7 @@
 #include <optional>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace bpt {
 
@@ -42,9 +43,6 @@ public:
     lm::library&       add(lm::usage u);
     void               add(lm::usage u, lm::library lib) { add(u) = lib; }
 
-    std::vector<fs::path> link_paths(const lm::usage&) const;
-    std::vector<fs::path> include_paths(const lm::usage& req) const;
-
     static usage_requirement_map from_lm_index(const lm::index&) noexcept;
 
     const_iterator begin() const { return _reqs.begin(); }
@@ -54,16 +52,35 @@ public:
     std::optional<std::vector<lm::usage>> find_usage_cycle() const;
 };
 
+/**
+ * The transitive closure of the libraries that are required by a library
+ */
+struct usage_closure {
+    /// The libraries in the closure, including the library itself. Every library appears before
+    /// the libraries that it requires.
+    std::vector<lm::usage> libraries;
+    /// The paths that are contributed by the libraries in the closure, without duplicates
+    std::vector<fs::path> paths;
+    /// If set, a library in the closure that does not exist
+    std::optional<lm::usage> missing;
+};
+
 // The actual usage requirements
 class usage_requirements {
     usage_requirement_map _reqs;
 
+    // The closures of every library, computed once when the requirements are created
+    std::map<lm::usage, usage_closure> _include_closures;
+    std::map<lm::usage, usage_closure> _link_closures;
+
     void verify_acyclic() const;
+    void compute_closures();
 
 public:
     explicit usage_requirements(usage_requirement_map reqs)
         : _reqs(std::move(reqs)) {
         verify_acyclic();
+        compute_closures();
     }
 
     const lm::library* get(const lm::usage& key) const noexcept { return _reqs.get(key); }
@@ -74,10 +91,18 @@ public:
     const usage_requirement_map& get_usage_map() const& { return _reqs; }
     usage_requirement_map&&      steal_usage_map() && { return std::move(_reqs); }
 
-    std::vector<fs::path> link_paths(const lm::usage& key) const { return _reqs.link_paths(key); }
-    std::vector<fs::path> include_paths(const lm::usage& req) const {
-        return _reqs.include_paths(req);
-    }
+    /**
+     * Get the libraries to link for the given usage, ordered such that each library appears
+     * before the libraries that it requires. Throws if any of them is missing.
+     */
+    const std::vector<fs::path>& link_paths(const lm::usage& key) const;
+    std::vector<fs::path>        link_paths(const std::vector<lm::usage>& keys) const;
+    /**
+     * Get the include directories for the given usage, starting with the library's own
+     * directories. Throws if any of the required libraries is missing.
+     */
+    const std::vector<fs::path>& include_paths(const lm::usage& req) const;
+    std::vector<fs::path>        include_paths(const std::vector<lm::usage>& reqs) const;
 
     static usage_requirements from_lm_index(const lm::index& index) noexcept {
         return usage_requirements(usage_requirement_map::from_lm_index(index));
@@ -114,4 +114,54 @@ TEST_CASE("Cyclic dependencies can be found - larger case") {
                IsRotation({lm::usage{"dep1", "dep1"},
                            lm::usage{"dep2", "dep2"},
                            lm::usage{"dep3", "dep3"}}));
-}
\ No newline at end of file
+}
+
+TEST_CASE("Usage closures are deduplicated and ordered") {
+    bpt::usage_requirement_map reqs;
+    // A diamond: `app` uses `left` and `right`, which both use `base`
+    reqs.add({"pkg", "base"},
+             lm::library{.name = "base", .linkable_path = "base.a", .include_paths = {"base/inc"}});
+    reqs.add({"pkg", "left"},
+             lm::library{.name          = "left",
+                         .linkable_path = "left.a",
+                         .include_paths = {"left/inc"},
+                         .uses          = {{"pkg", "base"}}});
+    reqs.add({"pkg", "right"},
+             lm::library{.name          = "right",
+                         .linkable_path = "right.a",
+                         .include_paths = {"right/inc", "base/inc"},
+                         .uses          = {{"pkg", "base"}}});
+    reqs.add({"pkg", "app"},
+             lm::library{.name          = "app",
+                         .linkable_path = "app.a",
+                         .include_paths = {"app/inc"},
+                         .uses          = {{"pkg", "left"}, {"pkg", "right"}},
+                         .links         = {{"pkg", "extra"}}});
+    reqs.add({"pkg", "extra"},
+             lm::library{.name = "extra", .linkable_path = "extra.a", .uses = {{"pkg", "base"}}});
+
+    bpt::usage_requirements ureqs{reqs};
+
+    // A library's own directories come first
+    CHECK(ureqs.include_paths(lm::usage{"pkg", "app"})
+          == std::vector<bpt::fs::path>{"app/inc", "left/inc", "right/inc", "base/inc"});
+    // Each library is linked once, before the libraries that it requires
+    CHECK(ureqs.link_paths(lm::usage{"pkg", "app"})
+          == std::vector<bpt::fs::path>{"app.a", "left.a", "right.a", "extra.a", "base.a"});
+
+    // Closures of several usages are merged
+    std::vector<lm::usage> uses = {{"pkg", "base"}, {"pkg", "left"}, {"pkg", "extra"}};
+    CHECK(ureqs.include_paths(uses) == std::vector<bpt::fs::path>{"base/inc", "left/inc"});
+    CHECK(ureqs.link_paths(uses) == std::vector<bpt::fs::path>{"left.a", "extra.a", "base.a"});
+}
+
+TEST_CASE("Usage closures with a missing library") {
+    bpt::usage_requirement_map reqs;
+    reqs.add({"pkg", "lib"},
+             lm::library{.name = "lib", .include_paths = {"inc"}, .links = {{"pkg", "nope"}}});
+    bpt::usage_requirements ureqs{reqs};
+    // The missing library is only required for linking
+    CHECK(ureqs.include_paths(lm::usage{"pkg", "lib"}) == std::vector<bpt::fs::path>{"inc"});
+    CHECK_THROWS(ureqs.link_paths(lm::usage{"pkg", "lib"}));
+    CHECK_THROWS(ureqs.include_paths(lm::usage{"pkg", "nope"}));
+}
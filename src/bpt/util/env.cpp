@@ -2,8 +2,15 @@
 
 #include <neo/utility.hpp>
 
+#include <algorithm>
 #include <cstdlib>
 
+#ifdef _WIN32
+#define environ _environ
+#else
+extern char** environ;
+#endif
+
 std::optional<std::string> bpt::getenv(const std::string& varname) noexcept {
     auto cptr = std::getenv(varname.data());
     if (cptr) {
@@ -17,6 +24,15 @@ bool bpt::getenv_bool(const std::string& varname) noexcept {
     return s.has_value() && is_truthy_string(*s);
 }
 
+std::vector<std::string> bpt::environment_entries() noexcept {
+    std::vector<std::string> ret;
+    for (auto var = environ; var && *var; ++var) {
+        ret.emplace_back(*var);
+    }
+    std::ranges::sort(ret);
+    return ret;
+}
+
 bool bpt::is_truthy_string(std::string_view s) noexcept {
     return s == neo::oper::any_of("1", "true", "on", "TRUE", "ON", "YES", "yes");
 }
@@ -4,6 +4,7 @@
 
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace bpt {
 
@@ -11,6 +12,12 @@ std::optional<std::string> getenv(const std::string& env) noexcept;
 
 bool getenv_bool(const std::string& env) noexcept;
 
+/**
+ * Obtain every variable in the environment of this process, as `NAME=value` strings, in sorted
+ * order.
+ */
+std::vector<std::string> environment_entries() noexcept;
+
 bool is_truthy_string(std::string_view s) noexcept;
 
 template <neo::invocable Func>
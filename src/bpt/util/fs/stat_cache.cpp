@@ -0,0 +1,96 @@
+#include "./stat_cache.hpp"
+
+#include <bpt/util/fs/io.hpp>
+#include <bpt/util/siphash.hpp>
+
+#include <mutex>
+
+using namespace bpt;
+
+stat_cache::file_stat stat_cache::stat(path_ref p) {
+    ++_n_lookups;
+    {
+        std::shared_lock lk{_mut};
+        auto             found = _stats.find(p.native());
+        if (found != _stats.end()) {
+            ++_n_hits;
+            return found->second;
+        }
+    }
+
+    // Get the status of the file in a single call. An error means that we cannot see the file.
+    file_stat       st;
+    std::error_code ec;
+    st.mtime  = fs::last_write_time(p, ec);
+    st.exists = !ec;
+
+    std::unique_lock lk{_mut};
+    // Another thread may have raced us to insert the same path. Both results are equally good.
+    return _stats.try_emplace(p.native(), st).first->second;
+}
+
+fs::file_time_type stat_cache::last_write_time(path_ref p) {
+    auto st = stat(p);
+    if (!st.exists) {
+        // Generate the appropriate error from the filesystem
+        return fs::last_write_time(p);
+    }
+    return st.mtime;
+}
+
+fs::path stat_cache::weakly_canonical(path_ref p) {
+    auto parent = p.parent_path();
+    if (parent.empty() || !p.has_filename() || p.filename() == "." || p.filename() == "..") {
+        // No directory to cache, or the filename is not a plain name
+        return fs::weakly_canonical(p);
+    }
+
+    ++_n_lookups;
+    {
+        std::shared_lock lk{_mut};
+        auto             found = _canonical_dirs.find(parent.native());
+        if (found != _canonical_dirs.end()) {
+            ++_n_hits;
+            return found->second / p.filename();
+        }
+    }
+
+    auto             dir = fs::weakly_canonical(parent);
+    std::unique_lock lk{_mut};
+    return _canonical_dirs.try_emplace(parent.native(), std::move(dir)).first->second
+        / p.filename();
+}
+
+std::optional<std::uint64_t> stat_cache::digest(path_ref p) {
+    ++_n_lookups;
+    {
+        std::shared_lock lk{_mut};
+        auto             found = _digests.find(p.native());
+        if (found != _digests.end()) {
+            ++_n_hits;
+            return found->second;
+        }
+    }
+
+    if (!stat(p).exists) {
+        return std::nullopt;
+    }
+    auto content = bpt::read_file(p);
+    auto hash    = bpt::siphash64(42, 1729, neo::const_buffer(content)).digest();
+
+    std::unique_lock lk{_mut};
+    return _digests.try_emplace(p.native(), hash).first->second;
+}
+
+void stat_cache::forget(path_ref p) {
+    std::unique_lock lk{_mut};
+    _stats.erase(p.native());
+    _digests.erase(p.native());
+}
+
+stat_cache::statistics stat_cache::get_statistics() const noexcept {
+    return statistics{
+        .n_lookups = _n_lookups.load(),
+        .n_hits    = _n_hits.load(),
+    };
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <bpt/util/fs/path.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace bpt {
+
+/**
+ * A thread-safe cache of filesystem metadata, intended to live for the duration of a single build.
+ *
+ * Many compilations share the same inputs (e.g. the standard library headers), and checking each
+ * compilation for staleness would otherwise query the same files over and over. The cache assumes
+ * that the files it is asked about are not modified during the build. If a file does change during
+ * the build, the cached (older) modification time will be recorded, and the next build will see the
+ * file as modified, which is the safe outcome.
+ */
+class stat_cache {
+public:
+    /**
+     * The cached status of a file
+     */
+    struct file_stat {
+        /// Whether the file exists
+        bool exists = false;
+        /// The modification time of the file, if it exists
+        fs::file_time_type mtime{};
+    };
+
+    /**
+     * Counters of the effectiveness of the cache.
+     */
+    struct statistics {
+        /// The total number of queries made against the cache
+        std::uint64_t n_lookups = 0;
+        /// The number of queries that were answered without touching the filesystem
+        std::uint64_t n_hits = 0;
+    };
+
+private:
+    mutable std::shared_mutex                                _mut;
+    std::unordered_map<fs::path::string_type, file_stat>     _stats;
+    std::unordered_map<fs::path::string_type, fs::path>      _canonical_dirs;
+    std::unordered_map<fs::path::string_type, std::uint64_t> _digests;
+    mutable std::atomic<std::uint64_t>                       _n_lookups{0};
+    mutable std::atomic<std::uint64_t>                       _n_hits{0};
+
+public:
+    /**
+     * Obtain the status of the given file. The filesystem is only queried the first time that a
+     * path is requested.
+     */
+    file_stat stat(path_ref p);
+
+    /// Determine whether the given file exists.
+    bool exists(path_ref p) { return stat(p).exists; }
+
+    /**
+     * Obtain the modification time of the given file. Throws `std::filesystem::filesystem_error`
+     * if the file does not exist.
+     */
+    fs::file_time_type last_write_time(path_ref p);
+
+    /**
+     * Equivalent to `fs::weakly_canonical()` for a path that names a regular file (or nothing at
+     * all). Only the parent directory of the path is resolved and cached, as many files share the
+     * same directory.
+     */
+    fs::path weakly_canonical(path_ref p);
+
+    /**
+     * Obtain a digest of the content of the given file, or `nullopt` if the file does not exist.
+     * The file is only read the first time that its digest is requested.
+     */
+    std::optional<std::uint64_t> digest(path_ref p);
+
+    /**
+     * Discard everything that is cached about the given file. This must be called when the build
+     * itself modifies a file that later compilations depend upon, such as a precompiled header.
+     */
+    void forget(path_ref p);
+
+    /**
+     * Obtain a snapshot of the cache's counters.
+     */
+    statistics get_statistics() const noexcept;
+};
+
+}  // namespace bpt
@@ -0,0 +1,44 @@
+#include "./stat_cache.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <fstream>
+
+TEST_CASE("Cache file status") {
+    bpt::stat_cache cache;
+    auto            this_file = bpt::fs::path(__FILE__);
+
+    auto st = cache.stat(this_file);
+    CHECK(st.exists);
+    CHECK(st.mtime == bpt::fs::last_write_time(this_file));
+    // The second lookup is served from the cache
+    CHECK(cache.exists(this_file));
+    CHECK_FALSE(cache.exists(this_file.parent_path() / "does-not-exist.txt"));
+
+    auto stats = cache.get_statistics();
+    CHECK(stats.n_lookups == 3);
+    CHECK(stats.n_hits == 1);
+}
+
+TEST_CASE("Cache canonical paths") {
+    bpt::stat_cache cache;
+    auto            dir = bpt::fs::path(__FILE__).parent_path() / "." / "..";
+    CHECK(cache.weakly_canonical(dir / "foo.o") == bpt::fs::weakly_canonical(dir / "foo.o"));
+    CHECK(cache.weakly_canonical(dir / "bar.o") == bpt::fs::weakly_canonical(dir / "bar.o"));
+    CHECK(cache.get_statistics().n_hits == 1);
+}
+
+TEST_CASE("Forget a file that was modified during the build") {
+    bpt::stat_cache cache;
+    auto            file = bpt::fs::temp_directory_path() / "bpt-stat-cache-forget-test.txt";
+    bpt::fs::remove(file);
+    CHECK_FALSE(cache.exists(file));
+
+    bpt::fs::create_directories(file.parent_path());
+    std::ofstream{file} << "content";
+    // The cache still remembers the file as missing until it is told otherwise
+    CHECK_FALSE(cache.exists(file));
+    cache.forget(file);
+    CHECK(cache.exists(file));
+    bpt::fs::remove(file);
+}
@@ -0,0 +1,88 @@
+#include "./jobserver.hpp"
+
+#include <bpt/util/env.hpp>
+#include <bpt/util/log.hpp>
+#include <bpt/util/string.hpp>
+
+#include <charconv>
+#include <mutex>
+
+using namespace bpt;
+
+namespace {
+
+std::optional<int> parse_fd(std::string_view s) noexcept {
+    int  ret = 0;
+    auto res = std::from_chars(s.data(), s.data() + s.size(), ret);
+    if (res.ec != std::errc{} || res.ptr != s.data() + s.size() || ret < 0) {
+        return std::nullopt;
+    }
+    return ret;
+}
+
+}  // namespace
+
+std::optional<jobserver_auth> bpt::parse_jobserver_makeflags(std::string_view makeflags) noexcept {
+    std::optional<jobserver_auth> ret;
+    for (auto word : split_view(makeflags, " ")) {
+        std::string_view value;
+        if (starts_with(word, "--jobserver-auth=")) {
+            value = word.substr(std::string_view("--jobserver-auth=").size());
+        } else if (starts_with(word, "--jobserver-fds=")) {
+            value = word.substr(std::string_view("--jobserver-fds=").size());
+        } else {
+            continue;
+        }
+
+        if (starts_with(value, "fifo:")) {
+            ret = jobserver_auth{
+                .fds  = std::nullopt,
+                .fifo = std::filesystem::path(value.substr(5)),
+            };
+            continue;
+        }
+        auto comma = value.find(',');
+        if (comma == value.npos) {
+            // Other forms (e.g. Windows semaphore names) are not supported
+            ret.reset();
+            continue;
+        }
+        auto read_fd  = parse_fd(value.substr(0, comma));
+        auto write_fd = parse_fd(value.substr(comma + 1));
+        if (!read_fd || !write_fd) {
+            ret.reset();
+            continue;
+        }
+        ret = jobserver_auth{.fds = std::pair{*read_fd, *write_fd}, .fifo = std::nullopt};
+    }
+    return ret;
+}
+
+jobserver& jobserver::global() {
+    static jobserver      inst;
+    static std::once_flag once;
+    std::call_once(once, [] {
+        auto makeflags = bpt::getenv("MAKEFLAGS");
+        if (!makeflags) {
+            return;
+        }
+        auto auth = parse_jobserver_makeflags(*makeflags);
+        if (!auth) {
+            return;
+        }
+        if (inst.connect(*auth)) {
+            bpt_log(debug, "Using the jobserver provided by the parent process");
+        } else {
+            bpt_log(debug,
+                    "MAKEFLAGS names a jobserver, but it is not available to bpt. (If bpt is "
+                    "executed by make, prefix the recipe line with '+'.)");
+        }
+    });
+    return inst;
+}
+
+void jobserver::token::release() noexcept {
+    if (_owner) {
+        std::exchange(_owner, nullptr)->_put(_byte);
+    }
+}
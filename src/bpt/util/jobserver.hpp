@@ -0,0 +1,139 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace bpt {
+
+/**
+ * The jobserver connection details advertised in a `MAKEFLAGS` string.
+ */
+struct jobserver_auth {
+    /// The read and write file descriptors of an inherited pipe (`--jobserver-auth=R,W`)
+    std::optional<std::pair<int, int>> fds;
+    /// The path to a named pipe (`--jobserver-auth=fifo:PATH`)
+    std::optional<std::filesystem::path> fifo;
+};
+
+/**
+ * Find the jobserver advertised in the given `MAKEFLAGS` string, if any. Both the
+ * `--jobserver-auth` and the older `--jobserver-fds` spellings are recognized. If more than one
+ * is present, the last one wins, as with GNU make.
+ */
+std::optional<jobserver_auth> parse_jobserver_makeflags(std::string_view makeflags) noexcept;
+
+/**
+ * A participant in the GNU make jobserver protocol.
+ *
+ * A jobserver is a pool of tokens shared by a tree of processes. Every process implicitly owns one
+ * token, and must obtain another token from the pool before starting each additional parallel job.
+ *
+ * If bpt is executed by `make -jN` (or another tool that provides a jobserver), the global
+ * jobserver connects to that pool, and bpt's parallelism is limited by the tokens that are
+ * available. Otherwise, bpt can `serve()` its own pool, which is advertised to child processes via
+ * `MAKEFLAGS`. This allows tools such as GCC's `-flto=jobserver` to share bpt's job limit rather
+ * than oversubscribing the machine.
+ *
+ * `parallel_run` and `task_graph` acquire a token for each job beyond the first.
+ */
+class jobserver {
+public:
+    /**
+     * A token obtained from a jobserver. The token is returned to the pool when destroyed.
+     */
+    class token {
+        jobserver* _owner = nullptr;
+        char       _byte  = 0;
+
+        friend class jobserver;
+        token(jobserver* owner, char byte) noexcept
+            : _owner(owner)
+            , _byte(byte) {}
+
+    public:
+        token() = default;
+        token(token&& o) noexcept
+            : _owner(std::exchange(o._owner, nullptr))
+            , _byte(o._byte) {}
+        token& operator=(token&& o) noexcept {
+            if (this != &o) {
+                release();
+                _owner = std::exchange(o._owner, nullptr);
+                _byte  = o._byte;
+            }
+            return *this;
+        }
+        ~token() { release(); }
+
+        /// Return the token to the pool early.
+        void release() noexcept;
+    };
+
+private:
+    /// The descriptor from which we read tokens. Non-blocking, if the platform allows it.
+    int _read_fd = -1;
+    /// The descriptor to which we return tokens.
+    int _write_fd = -1;
+    /// Whether we are a client of another process' jobserver
+    bool _is_client = false;
+    /// Whether we created the pool ourselves (and must close it)
+    bool _is_server = false;
+    /// The descriptors given to child processes, if we are the server
+    int _child_read_fd  = -1;
+    int _child_write_fd = -1;
+
+    void _put(char byte) noexcept;
+    void _close() noexcept;
+
+public:
+    /// Create an inactive jobserver. Every call to `acquire` will succeed immediately.
+    jobserver() = default;
+    ~jobserver() { _close(); }
+
+    jobserver(const jobserver&) = delete;
+    jobserver& operator=(const jobserver&) = delete;
+
+    /**
+     * Obtain the process-wide jobserver. On first access, it will connect to the jobserver
+     * advertised in the `MAKEFLAGS` environment variable, if one is present and usable.
+     */
+    static jobserver& global();
+
+    /**
+     * Become a client of the given jobserver. Returns `false` if the jobserver is not usable
+     * (e.g. the parent did not let us inherit its pipe), in which case this object is unchanged.
+     */
+    bool connect(const jobserver_auth& auth);
+
+    /**
+     * If this object is not yet active, create a pool of tokens that allows `n_jobs` jobs to run in
+     * parallel, and advertise it to child processes by updating the `MAKEFLAGS` environment
+     * variable. If `n_jobs` is less than one, a default based on the hardware concurrency is used.
+     *
+     * Because this modifies the environment, it must be called before starting any threads that
+     * may spawn child processes.
+     */
+    void serve(int n_jobs);
+
+    /// Whether tokens are taken from a pool (as either a client or a server)
+    bool is_active() const noexcept { return _is_client || _is_server; }
+    /// Whether we are using the pool of a parent process
+    bool is_client() const noexcept { return _is_client; }
+    /// Whether we are providing a pool for our child processes
+    bool is_server() const noexcept { return _is_server; }
+
+    /**
+     * Obtain a token for an additional parallel job, waiting until one becomes available. If this
+     * jobserver is inactive, a token is returned immediately.
+     *
+     * While waiting, `give_up` is periodically invoked. If it returns `true` (e.g. because there is
+     * no more work to be done), or if the user has requested cancellation, returns `nullopt`.
+     */
+    std::optional<token> acquire(const std::function<bool()>& give_up);
+};
+
+}  // namespace bpt
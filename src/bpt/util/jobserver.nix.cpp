@@ -0,0 +1,174 @@
+#include "./jobserver.hpp"
+
+#ifndef _WIN32
+
+#include <bpt/util/env.hpp>
+#include <bpt/util/log.hpp>
+#include <bpt/util/signal.hpp>
+
+#include <fmt/core.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <thread>
+
+using namespace bpt;
+
+namespace {
+
+/// How often a waiting `acquire()` will check whether it should give up
+constexpr int poll_interval_ms = 50;
+
+void check_rc(bool b, std::string_view s) {
+    if (!b) {
+        throw std::system_error(std::error_code(errno, std::system_category()), std::string(s));
+    }
+}
+
+/**
+ * Open a new, non-blocking description of the pipe referred to by `fd`. The non-blocking flag is
+ * shared by every process that uses a pipe description, so we cannot set it on the descriptor
+ * that we inherited (or gave to our children) without confusing them. Instead, we reopen the pipe
+ * through /proc. If that is not possible, returns a duplicate of the original (blocking)
+ * descriptor, in which case a token taken by another process between poll() and read() will block
+ * the reader until a token is returned.
+ */
+int reopen_nonblocking(int fd) {
+    auto proc_path = fmt::format("/proc/self/fd/{}", fd);
+    int  ret       = ::open(proc_path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (ret >= 0) {
+        return ret;
+    }
+    ret = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    check_rc(ret >= 0, "Failed to duplicate jobserver file descriptor");
+    return ret;
+}
+
+}  // namespace
+
+bool jobserver::connect(const jobserver_auth& auth) {
+    if (is_active()) {
+        return false;
+    }
+    if (auth.fifo) {
+        int fd = ::open(auth.fifo->c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            bpt_log(debug,
+                    "Failed to open jobserver fifo [{}]: {}",
+                    auth.fifo->string(),
+                    std::strerror(errno));
+            return false;
+        }
+        _read_fd   = fd;
+        _write_fd  = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        _is_client = true;
+        return true;
+    }
+    if (!auth.fds) {
+        return false;
+    }
+    auto [read_fd, write_fd] = *auth.fds;
+    if (::fcntl(read_fd, F_GETFD) == -1 || ::fcntl(write_fd, F_GETFD) == -1) {
+        // The parent advertised a jobserver but did not let us inherit it
+        return false;
+    }
+    _read_fd   = reopen_nonblocking(read_fd);
+    _write_fd  = ::fcntl(write_fd, F_DUPFD_CLOEXEC, 0);
+    _is_client = true;
+    return true;
+}
+
+void jobserver::serve(int n_jobs) {
+    if (is_active()) {
+        return;
+    }
+    if (n_jobs < 1) {
+        n_jobs = static_cast<int>(std::thread::hardware_concurrency()) + 2;
+    }
+
+    // The pipe is inherited by child processes, so it must not be close-on-exec.
+    int  fds[2] = {};
+    auto rc     = ::pipe(fds);
+    check_rc(rc == 0, "Failed to create jobserver pipe");
+    _child_read_fd  = fds[0];
+    _child_write_fd = fds[1];
+    _is_server      = true;
+    _read_fd        = reopen_nonblocking(_child_read_fd);
+    _write_fd       = ::fcntl(_child_write_fd, F_DUPFD_CLOEXEC, 0);
+    check_rc(_write_fd >= 0, "Failed to duplicate jobserver file descriptor");
+
+    // We hold one implicit token. The pool holds the rest.
+    const std::string tokens(static_cast<std::size_t>(n_jobs - 1), '+');
+    if (!tokens.empty()) {
+        auto nwritten = ::write(_write_fd, tokens.data(), tokens.size());
+        check_rc(nwritten == static_cast<ssize_t>(tokens.size()),
+                 "Failed to fill the jobserver pipe");
+    }
+
+    auto makeflags = bpt::getenv("MAKEFLAGS").value_or("");
+    makeflags += fmt::format(" -j{} --jobserver-auth={},{}", n_jobs, fds[0], fds[1]);
+    ::setenv("MAKEFLAGS", makeflags.c_str(), 1);
+    bpt_log(debug, "Serving a jobserver with {} tokens to child processes", n_jobs);
+}
+
+std::optional<jobserver::token> jobserver::acquire(const std::function<bool()>& give_up) {
+    if (!is_active()) {
+        return token{};
+    }
+    while (true) {
+        if (give_up() || is_cancelled()) {
+            return std::nullopt;
+        }
+        pollfd pfd;
+        pfd.fd     = _read_fd;
+        pfd.events = POLLIN;
+        auto rc    = ::poll(&pfd, 1, poll_interval_ms);
+        if (rc <= 0) {
+            // Timed out or interrupted. Check whether we should keep waiting.
+            continue;
+        }
+        char byte  = 0;
+        auto nread = ::read(_read_fd, &byte, 1);
+        if (nread == 1) {
+            return token{this, byte};
+        }
+        if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            // Another process took the token before we could
+            continue;
+        }
+        check_rc(nread >= 0, "Failed to read from jobserver");
+        // The writing end was closed. This should never happen with a well-behaved jobserver.
+        bpt_log(warn, "The jobserver was closed unexpectedly. Running without it.");
+        _close();
+        return token{};
+    }
+}
+
+void jobserver::_put(char byte) noexcept {
+    if (_write_fd < 0) {
+        return;
+    }
+    while (::write(_write_fd, &byte, 1) < 0 && errno == EINTR) {
+        // Try again
+    }
+}
+
+void jobserver::_close() noexcept {
+    for (int* fd : {&_read_fd, &_write_fd, &_child_read_fd, &_child_write_fd}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+    _is_client = false;
+    _is_server = false;
+}
+
+#endif  // _WIN32
@@ -0,0 +1,73 @@
+#include "./jobserver.hpp"
+
+#include <bpt/util/env.hpp>
+
+#include <catch2/catch.hpp>
+#include <neo/scope.hpp>
+
+#include <cstdlib>
+
+TEST_CASE("Parse jobserver details from MAKEFLAGS") {
+    CHECK_FALSE(bpt::parse_jobserver_makeflags(""));
+    CHECK_FALSE(bpt::parse_jobserver_makeflags("-j8"));
+    CHECK_FALSE(bpt::parse_jobserver_makeflags(" -j8 --jobserver-auth=foo"));
+
+    auto auth = bpt::parse_jobserver_makeflags("kw -j8 --jobserver-auth=3,4");
+    REQUIRE(auth);
+    REQUIRE(auth->fds);
+    CHECK(auth->fds->first == 3);
+    CHECK(auth->fds->second == 4);
+    CHECK_FALSE(auth->fifo);
+
+    // The older spelling is also accepted
+    auth = bpt::parse_jobserver_makeflags("-j4 --jobserver-fds=5,6");
+    REQUIRE(auth);
+    CHECK(auth->fds == std::pair{5, 6});
+
+    auth = bpt::parse_jobserver_makeflags("-j4 --jobserver-auth=fifo:/tmp/GMfifo123");
+    REQUIRE(auth);
+    CHECK_FALSE(auth->fds);
+    CHECK(auth->fifo == "/tmp/GMfifo123");
+
+    // The last one wins
+    auth = bpt::parse_jobserver_makeflags("--jobserver-auth=3,4 --jobserver-auth=fifo:/tmp/f");
+    REQUIRE(auth);
+    CHECK(auth->fifo == "/tmp/f");
+}
+
+TEST_CASE("An inactive jobserver hands out tokens freely") {
+    bpt::jobserver js;
+    CHECK_FALSE(js.is_active());
+    auto tok = js.acquire([] { return true; });
+    CHECK(tok);
+}
+
+#ifndef _WIN32
+TEST_CASE("Serve a pool of tokens") {
+    // Serving advertises the jobserver in MAKEFLAGS. Do not leak it into other test cases.
+    auto prev_makeflags = bpt::getenv("MAKEFLAGS");
+    neo_defer {
+        if (prev_makeflags) {
+            ::setenv("MAKEFLAGS", prev_makeflags->c_str(), 1);
+        } else {
+            ::unsetenv("MAKEFLAGS");
+        }
+    };
+
+    bpt::jobserver js;
+    js.serve(3);
+    CHECK(js.is_server());
+    // We implicitly own one token, so only two more are available
+    auto tok1 = js.acquire([] { return false; });
+    auto tok2 = js.acquire([] { return false; });
+    REQUIRE(tok1);
+    REQUIRE(tok2);
+    // The pool is empty: Wait on it once, then give up
+    int n_checks = 0;
+    CHECK_FALSE(js.acquire([&] { return n_checks++ > 0; }));
+    CHECK(n_checks == 2);
+    // Once a token is returned, it can be acquired again
+    tok1.reset();
+    CHECK(js.acquire([] { return false; }));
+}
+#endif
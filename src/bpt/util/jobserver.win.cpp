@@ -0,0 +1,27 @@
+#include "./jobserver.hpp"
+
+#ifdef _WIN32
+
+#include <bpt/util/log.hpp>
+
+using namespace bpt;
+
+// The Windows jobserver uses named semaphores rather than pipes. It is not yet supported, so the
+// jobserver is always inactive and parallelism is limited only by the requested number of jobs.
+
+bool jobserver::connect(const jobserver_auth&) {
+    bpt_log(debug, "Connecting to a jobserver is not supported on Windows");
+    return false;
+}
+
+void jobserver::serve(int) {}
+
+std::optional<jobserver::token> jobserver::acquire(const std::function<bool()>&) {
+    return token{};
+}
+
+void jobserver::_put(char) noexcept {}
+
+void jobserver::_close() noexcept {}
+
+#endif  // _WIN32
@@ -1,12 +1,16 @@
 #pragma once
 
+#include <bpt/util/jobserver.hpp>
 #include <bpt/util/log.hpp>
+#include <bpt/util/signal.hpp>
+#include <bpt/util/thread_pool.hpp>
 
 #include <neo/event.hpp>
 
 #include <algorithm>
 #include <iterator>
 #include <mutex>
+#include <optional>
 #include <stdexcept>
 #include <thread>
 #include <vector>
@@ -17,8 +21,8 @@ void log_exception(std::exception_ptr) noexcept;
 
 template <typename Range, typename Func>
 bool parallel_run(Range&& rng, int n_jobs, Func&& fn) {
-    // We don't bother with a nice thread pool, as the overhead of most build
-    // tasks dwarf the cost of interlocking.
+    // Items are handed out from a single shared iterator, as the overhead of most build tasks dwarf
+    // the cost of interlocking. The threads themselves come from the persistent global pool.
     std::mutex mut;
 
     auto       iter = rng.begin();
@@ -26,10 +30,26 @@ bool parallel_run(Range&& rng, int n_jobs, Func&& fn) {
 
     std::vector<std::exception_ptr> exceptions;
 
+    // The calling thread already occupies a job slot. Every other thread must take a token from
+    // the jobserver for each item that it runs.
+    auto&      js     = jobserver::global();
+    const auto caller = std::this_thread::get_id();
+
     auto run_one = [&]() mutable {
         neo::listener log_listen = &log::ev_log::print;
 
+        const bool needs_token = std::this_thread::get_id() != caller;
         while (true) {
+            std::optional<jobserver::token> token;
+            if (needs_token) {
+                token = js.acquire([&] {
+                    std::unique_lock lk{mut};
+                    return !exceptions.empty() || iter == stop;
+                });
+                if (!token) {
+                    break;
+                }
+            }
             std::unique_lock lk{mut};
             if (!exceptions.empty()) {
                 break;
@@ -41,6 +61,7 @@ bool parallel_run(Range&& rng, int n_jobs, Func&& fn) {
             ++iter;
             lk.unlock();
             try {
+                cancellation_point();
                 fn(item);
             } catch (...) {
                 lk.lock();
@@ -50,16 +71,10 @@ bool parallel_run(Range&& rng, int n_jobs, Func&& fn) {
         }
     };
 
-    std::unique_lock         lk{mut};
-    std::vector<std::thread> threads;
     if (n_jobs < 1) {
         n_jobs = std::thread::hardware_concurrency() + 2;
     }
-    std::generate_n(std::back_inserter(threads), n_jobs, [&] { return std::thread(run_one); });
-    lk.unlock();
-    for (auto& t : threads) {
-        t.join();
-    }
+    thread_pool::global().fan_out(n_jobs, run_one);
     for (auto eptr : exceptions) {
         log_exception(eptr);
     }
@@ -2,6 +2,8 @@
 
 #include <bpt/util/string.hpp>
 
+#include <fmt/core.h>
+
 #include <algorithm>
 #include <cctype>
 
@@ -23,3 +25,15 @@ std::string bpt::quote_argument(std::string_view s) {
     new_s      = replace(s, "\"", "\\\"");
     return "\"" + new_s + "\"";
 }
+
+std::string bpt::describe_resource_usage(const proc_resource_usage& usage) {
+    using std::chrono::duration_cast;
+    using std::chrono::milliseconds;
+    return fmt::format("user {:L}ms, sys {:L}ms, peak memory {:L}KiB, {:L} block reads, {:L} "
+                       "block writes",
+                       duration_cast<milliseconds>(usage.user_cpu).count(),
+                       duration_cast<milliseconds>(usage.system_cpu).count(),
+                       usage.peak_rss / 1024,
+                       usage.block_reads,
+                       usage.block_writes);
+}
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
+#include <exception>
 #include <filesystem>
+#include <functional>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -25,11 +28,36 @@ std::string quote_command(const Container& c) {
     return acc;
 }
 
+/**
+ * The resources consumed by a child process. Values that could not be measured are zero.
+ */
+struct proc_resource_usage {
+    /// The peak resident memory of the process, in bytes
+    std::uint64_t peak_rss = 0;
+    /// CPU time spent executing in user mode
+    std::chrono::microseconds user_cpu{0};
+    /// CPU time spent executing in the kernel on behalf of the process
+    std::chrono::microseconds system_cpu{0};
+    /// The number of block input operations (on Windows: read operations) performed
+    std::uint64_t block_reads = 0;
+    /// The number of block output operations (on Windows: write operations) performed
+    std::uint64_t block_writes = 0;
+
+    bool operator==(const proc_resource_usage&) const noexcept = default;
+};
+
+/**
+ * Summarize resource usage as a short human-readable string for the logs.
+ */
+std::string describe_resource_usage(const proc_resource_usage&);
+
 struct proc_result {
     int         signal    = 0;
     int         retc      = 0;
     bool        timed_out = false;
     std::string output;
+    /// The resources consumed by the process
+    proc_resource_usage usage;
 
     bool okay() const noexcept { return retc == 0 && signal == 0; }
 };
@@ -47,6 +75,22 @@ struct proc_options {
 
 proc_result run_proc(const proc_options& opts);
 
+/**
+ * Receives the result of a subprocess started by `run_proc_async`. If the process could not be
+ * spawned or supervised, `error` is set and `result` is empty.
+ */
+using proc_callback = std::function<void(std::exception_ptr error, proc_result result)>;
+
+/**
+ * Spawn a subprocess without waiting for it to exit. Once the process has exited and all of its
+ * output has been collected, `on_exit` is called with the result.
+ *
+ * `on_exit` is called exactly once, from the thread that supervises the child processes, so it
+ * must return promptly and must not throw. If the process cannot be spawned, `on_exit` receives the
+ * error, and may be called before this function returns.
+ */
+void run_proc_async(const proc_options& opts, proc_callback on_exit);
+
 inline proc_result run_proc(std::vector<std::string> args) {
     return run_proc(proc_options{.command = std::move(args)});
 }
@@ -8,16 +8,28 @@
 
 #include <neo/scope.hpp>
 
+#include <fcntl.h>
 #include <poll.h>
 #include <signal.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <cassert>
 #include <cerrno>
-#include <deque>
-#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <system_error>
+#include <thread>
+#include <vector>
+
+extern char** environ;
 
 using namespace bpt;
 
@@ -29,7 +41,44 @@ void check_rc(bool b, std::string_view s) {
     }
 }
 
-::pid_t spawn_child(const proc_options& opts, int stdout_pipe, int close_me) noexcept {
+void set_cloexec(int fd) {
+    auto rc = ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    check_rc(rc != -1, "Failed to set FD_CLOEXEC");
+}
+
+/**
+ * Create a pipe that is not inherited by child processes. Other children that are spawned
+ * concurrently must not hold the write end of a child's output pipe, or it would not reach EOF
+ * until they have exited as well.
+ */
+void make_cloexec_pipe(int (&fds)[2], std::string_view what) {
+#ifdef __linux__
+    auto rc = ::pipe2(fds, O_CLOEXEC);
+    check_rc(rc == 0, what);
+#else
+    auto rc = ::pipe(fds);
+    check_rc(rc == 0, what);
+    set_cloexec(fds[0]);
+    set_cloexec(fds[1]);
+#endif
+}
+
+std::string not_found_message(const proc_options& opts) {
+    return fmt::format("[bpt child executor] The requested executable [{}] could not be found.",
+                       opts.command.front());
+}
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define BPT_SPAWN_HAS_CHDIR 1
+#else
+#define BPT_SPAWN_HAS_CHDIR 0
+#endif
+
+/**
+ * Spawn the child with fork() and execvp(). This copies the page tables of our (large) process,
+ * so it is only used if posix_spawn() cannot change the working directory of the child.
+ */
+::pid_t fork_child(const proc_options& opts, int stdout_pipe, int close_me) noexcept {
     // We must allocate BEFORE fork(), since the CRT might stumble with malloc()-related locks that
     // are held during the fork().
     std::vector<const char*> strings;
@@ -40,9 +89,7 @@ void check_rc(bool b, std::string_view s) {
     strings.push_back(nullptr);
 
     std::string workdir = opts.cwd.value_or(fs::current_path()).string();
-    auto        not_found_err
-        = fmt::format("[bpt child executor] The requested executable [{}] could not be found.",
-                      strings[0]);
+    auto        not_found_err = not_found_message(opts);
 
     auto child_pid = ::fork();
     if (child_pid != 0) {
@@ -70,72 +117,382 @@ void check_rc(bool b, std::string_view s) {
     std::_Exit(-1);
 }
 
-}  // namespace
+/**
+ * Spawn the child with posix_spawnp(), which uses vfork() or an equivalent on the supported
+ * platforms, and so does not copy the address space of the parent. Returns -1 and sets errno if the
+ * child could not be spawned, including if the executable could not be found.
+ */
+::pid_t posix_spawn_child(const proc_options& opts, int stdout_pipe) {
+    std::vector<char*> strings;
+    strings.reserve(opts.command.size() + 1);
+    for (auto& s : opts.command) {
+        strings.push_back(const_cast<char*>(s.data()));
+    }
+    strings.push_back(nullptr);
 
-proc_result bpt::run_proc(const proc_options& opts) {
-    bpt_log(debug, "Spawning subprocess: {}", quote_command(opts.command));
-    int  stdio_pipe[2] = {};
-    auto rc            = ::pipe(stdio_pipe);
-    check_rc(rc == 0, "Create stdio pipe for subprocess");
+    ::posix_spawn_file_actions_t actions;
+    auto                         rc = ::posix_spawn_file_actions_init(&actions);
+    check_rc(rc == 0, "Failed to initialize posix_spawn() file actions");
+    neo_defer { ::posix_spawn_file_actions_destroy(&actions); };
 
-    int read_pipe  = stdio_pipe[0];
-    int write_pipe = stdio_pipe[1];
+    // The pipe is close-on-exec, but the duplicated descriptors are not
+    rc = ::posix_spawn_file_actions_adddup2(&actions, stdout_pipe, STDOUT_FILENO);
+    check_rc(rc == 0, "Failed to dup2 stdout");
+    rc = ::posix_spawn_file_actions_adddup2(&actions, stdout_pipe, STDERR_FILENO);
+    check_rc(rc == 0, "Failed to dup2 stderr");
+#if BPT_SPAWN_HAS_CHDIR
+    std::string workdir;
+    if (opts.cwd) {
+        workdir = opts.cwd->string();
+        rc      = ::posix_spawn_file_actions_addchdir_np(&actions, workdir.data());
+        check_rc(rc == 0, "Failed to chdir() for subprocess");
+    }
+#else
+    assert(!opts.cwd && "posix_spawn() cannot set the working directory on this platform");
+#endif
 
-    neo_defer { ::close(read_pipe); };
+    ::pid_t pid = -1;
+    rc          = ::posix_spawnp(&pid, strings[0], &actions, nullptr, strings.data(), environ);
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    return pid;
+}
 
-    auto child = spawn_child(opts, write_pipe, read_pipe);
+/**
+ * Spawn a child process for the given options, with its stdout and stderr connected to the given
+ * pipe. Returns -1 and sets errno if the child could not be spawned.
+ */
+::pid_t spawn_child(const proc_options& opts, int stdout_pipe, int close_me) {
+    if (BPT_SPAWN_HAS_CHDIR || !opts.cwd) {
+        return posix_spawn_child(opts, stdout_pipe);
+    }
+    return fork_child(opts, stdout_pipe, close_me);
+}
 
-    ::close(write_pipe);
+/**
+ * A child process that is supervised by the `proc_reactor`
+ */
+struct running_proc {
+    ::pid_t pid;
+    /// The read end of the child's stdout/stderr pipe, or -1 once it has reached EOF
+    int out_fd;
+    /// A file descriptor that becomes readable when the child exits, or -1 if not supported
+    int pid_fd = -1;
+    /// The time at which the child will be interrupted, if it has a timeout
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    /// Whether the child has been interrupted because the user cancelled the build
+    bool cancelled = false;
+    /// Whether the child has exited and been reaped
+    bool exited = false;
+    /// The command that was spawned, for the logs
+    std::string command;
+    /// The result that is being accumulated
+    proc_result result;
+    /// Receives the result once the child has exited and all of its output has been read
+    proc_callback on_exit;
+};
 
-    pollfd stdio_fd;
-    stdio_fd.fd     = read_pipe;
-    stdio_fd.events = POLLIN;
+/**
+ * Open a file descriptor that becomes readable when the given child process exits, or -1 if the
+ * system does not support it.
+ */
+int open_pid_fd([[maybe_unused]] ::pid_t pid) noexcept {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+    return -1;
+#endif
+}
 
-    proc_result res;
+/**
+ * Supervises every running child process from a single thread: Output is read into a reusable
+ * buffer as it becomes available, timeouts and cancellation are enforced, and exited children are
+ * reaped. Completions are reported by callback, so no thread needs to wait on a running child, and
+ * the user's cancellation interrupts every child promptly.
+ */
+class proc_reactor {
+    std::mutex                                 _mutex;
+    std::vector<std::unique_ptr<running_proc>> _incoming;
+    /// Written to wake the reactor thread when a new child is added
+    int _wake_read  = -1;
+    int _wake_write = -1;
 
-    using namespace std::chrono_literals;
+    /// Owned by the reactor thread:
+    std::vector<std::unique_ptr<running_proc>> _running;
+    std::vector<pollfd>                        _pollfds;
+    std::vector<char>                          _read_buffer = std::vector<char>(64 * 1024);
 
-    /// Quirk: We _could_ just use opts.timeout.value_or, but it seems like something
-    /// is weird in GCC 9's data flow analysis and it will warn that `timeout` is
-    /// used uninitialized when its value is passed to poll() ??
-    auto timeout = -1ms;
-    if (opts.timeout) {
-        timeout = *opts.timeout;
+    proc_reactor() {
+        int fds[2] = {};
+        make_cloexec_pipe(fds, "Failed to create the subprocess reactor pipe");
+        _wake_read  = fds[0];
+        _wake_write = fds[1];
+        std::thread([this] { _run(); }).detach();
     }
-    while (true) {
-        rc = ::poll(&stdio_fd, 1, static_cast<int>(timeout.count()));
-        if (rc && errno == EINTR) {
-            errno = 0;
-            continue;
+
+    /// Wait for the next event, and return the number of milliseconds to wait for
+    int _poll_timeout() const noexcept {
+        using namespace std::chrono;
+        // While children are running, wake periodically to notice when the user cancels the
+        // build, or when a child whose exit cannot be polled has been reaped.
+        auto timeout = _running.empty() ? milliseconds(-1) : milliseconds(100);
+        auto now     = steady_clock::now();
+        for (auto& proc : _running) {
+            if (proc->out_fd == -1 && proc->pid_fd == -1) {
+                timeout = std::min(timeout, milliseconds(5));
+            }
+            if (proc->deadline) {
+                auto remaining = ceil<milliseconds>(*proc->deadline - now);
+                timeout        = std::max(milliseconds(0), std::min(timeout, remaining));
+            }
         }
-        if (rc == 0) {
-            // Timeout!
-            ::kill(child, SIGINT);
-            timeout       = -1ms;
-            res.timed_out = true;
-            bpt_log(debug, "Subprocess [{}] timed out", quote_command(opts.command));
-            continue;
-        }
-        std::string buffer;
-        buffer.resize(1024);
-        auto nread = ::read(stdio_fd.fd, buffer.data(), buffer.size());
+        return static_cast<int>(timeout.count());
+    }
+
+    void _read_output(running_proc& proc) {
+        auto nread = ::read(proc.out_fd, _read_buffer.data(), _read_buffer.size());
+        if (nread < 0 && errno == EINTR) {
+            return;
+        }
+        check_rc(nread >= 0, "Failed in read()");
         if (nread == 0) {
-            break;
+            ::close(proc.out_fd);
+            proc.out_fd = -1;
+            return;
         }
-        check_rc(nread > 0, "Failed in read()");
-        res.output.append(buffer.begin(), buffer.begin() + nread);
+        proc.result.output.append(_read_buffer.data(), static_cast<std::size_t>(nread));
     }
 
-    int status = 0;
-    rc         = ::waitpid(child, &status, 0);
-    check_rc(rc >= 0, "Failed in waitpid()");
+    void _try_reap(running_proc& proc) {
+        int           status = 0;
+        struct rusage usage  = {};
+        auto          rc     = ::wait4(proc.pid, &status, WNOHANG, &usage);
+        check_rc(rc >= 0, "Failed in wait4()");
+        if (rc == 0) {
+            return;
+        }
+        proc.exited = true;
+        if (proc.pid_fd != -1) {
+            ::close(proc.pid_fd);
+            proc.pid_fd = -1;
+        }
+        auto& res = proc.result;
+#ifdef __APPLE__
+        // macOS reports ru_maxrss in bytes
+        res.usage.peak_rss = static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+        // Linux and the BSDs report ru_maxrss in kibibytes
+        res.usage.peak_rss = static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+        auto to_us = [](const ::timeval& tv) {
+            return std::chrono::seconds(tv.tv_sec) + std::chrono::microseconds(tv.tv_usec);
+        };
+        res.usage.user_cpu     = to_us(usage.ru_utime);
+        res.usage.system_cpu   = to_us(usage.ru_stime);
+        res.usage.block_reads  = static_cast<std::uint64_t>(usage.ru_inblock);
+        res.usage.block_writes = static_cast<std::uint64_t>(usage.ru_oublock);
+
+        if (WIFEXITED(status)) {
+            res.retc = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            res.signal = WTERMSIG(status);
+        }
+    }
 
-    if (WIFEXITED(status)) {
-        res.retc = WEXITSTATUS(status);
-    } else if (WIFSIGNALED(status)) {
-        res.signal = WTERMSIG(status);
+    /**
+     * Stop supervising a child after an error: Kill it, reap it so that it does not linger as a
+     * zombie, and close its descriptors.
+     */
+    static void _abandon(running_proc& proc) noexcept {
+        if (!proc.exited) {
+            ::kill(proc.pid, SIGKILL);
+            while (::waitpid(proc.pid, nullptr, 0) == -1 && errno == EINTR) {
+            }
+            proc.exited = true;
+        }
+        if (proc.out_fd != -1) {
+            ::close(proc.out_fd);
+            proc.out_fd = -1;
+        }
+        if (proc.pid_fd != -1) {
+            ::close(proc.pid_fd);
+            proc.pid_fd = -1;
+        }
     }
 
+    /// Check the timeout and cancellation of the child, and handle any events that were polled
+    void _update(running_proc& proc, short out_events, short pid_events) {
+        if (out_events & (POLLIN | POLLHUP | POLLERR)) {
+            _read_output(proc);
+        }
+        if (proc.exited) {
+            return;
+        }
+        // Without a pid_fd, the child is only reaped once its output is complete
+        if ((pid_events & POLLIN) || (proc.pid_fd == -1 && proc.out_fd == -1)) {
+            _try_reap(proc);
+        }
+        if (proc.exited) {
+            return;
+        }
+        if (proc.deadline && std::chrono::steady_clock::now() >= *proc.deadline) {
+            ::kill(proc.pid, SIGINT);
+            proc.deadline         = std::nullopt;
+            proc.result.timed_out = true;
+            bpt_log(debug, "Subprocess [{}] timed out", proc.command);
+        }
+        if (!proc.cancelled && is_cancelled()) {
+            ::kill(proc.pid, SIGINT);
+            proc.cancelled = true;
+        }
+    }
+
+    void _run() {
+        while (true) {
+            _pollfds.clear();
+            _pollfds.push_back(pollfd{.fd = _wake_read, .events = POLLIN, .revents = 0});
+            for (auto& proc : _running) {
+                _pollfds.push_back(pollfd{.fd = proc->out_fd, .events = POLLIN, .revents = 0});
+                _pollfds.push_back(pollfd{.fd = proc->pid_fd, .events = POLLIN, .revents = 0});
+            }
+            // poll() ignores the negative file descriptors of closed pipes and missing pid_fds
+            auto rc = ::poll(_pollfds.data(), _pollfds.size(), _poll_timeout());
+            if (rc < 0 && errno != EINTR) {
+                bpt_log(critical, "Subprocess reactor failed in poll(): {}", std::strerror(errno));
+                std::terminate();
+            }
+
+            for (std::size_t idx = 0; idx < _running.size(); ++idx) {
+                auto& proc = *_running[idx];
+                try {
+                    _update(proc,
+                            rc > 0 ? _pollfds[idx * 2 + 1].revents : 0,
+                            rc > 0 ? _pollfds[idx * 2 + 2].revents : 0);
+                } catch (...) {
+                    _abandon(proc);
+                    proc.on_exit(std::current_exception(), {});
+                    continue;
+                }
+                if (proc.exited && proc.out_fd == -1) {
+                    proc.on_exit(nullptr, std::move(proc.result));
+                }
+            }
+            std::erase_if(_running, [](auto& proc) { return proc->exited && proc->out_fd == -1; });
+
+            if (rc > 0 && (_pollfds[0].revents & POLLIN)) {
+                char drain[64];
+                [[maybe_unused]] auto n = ::read(_wake_read, drain, sizeof drain);
+                std::scoped_lock      lk{_mutex};
+                for (auto& proc : _incoming) {
+                    _running.push_back(std::move(proc));
+                }
+                _incoming.clear();
+            }
+        }
+    }
+
+public:
+    static proc_reactor& instance() {
+        // Never destroyed, as the reactor thread runs until the program exits
+        static proc_reactor& inst = *new proc_reactor;
+        return inst;
+    }
+
+    /**
+     * Begin supervising the given child process.
+     */
+    void add(std::unique_ptr<running_proc> proc) noexcept {
+        {
+            std::scoped_lock lk{_mutex};
+            _incoming.push_back(std::move(proc));
+        }
+        char wake = 0;
+        auto rc   = ::write(_wake_write, &wake, 1);
+        while (rc == -1 && errno == EINTR) {
+            rc = ::write(_wake_write, &wake, 1);
+        }
+        if (rc != 1) {
+            // The child could never be reported as finished
+            bpt_log(critical, "Failed to wake the subprocess reactor: {}", std::strerror(errno));
+            std::terminate();
+        }
+    }
+};
+
+}  // namespace
+
+namespace {
+
+/**
+ * Spawn the child process and hand it to the reactor. Throws if the child cannot be spawned.
+ */
+void spawn_supervised(const proc_options& opts, proc_callback& on_exit) {
+    bpt_log(debug, "Spawning subprocess: {}", quote_command(opts.command));
+    int stdio_pipe[2] = {};
+    make_cloexec_pipe(stdio_pipe, "Create stdio pipe for subprocess");
+
+    int read_pipe  = stdio_pipe[0];
+    int write_pipe = stdio_pipe[1];
+
+    auto child = spawn_child(opts, write_pipe, read_pipe);
+    auto error = errno;
+
+    ::close(write_pipe);
+    if (child == -1) {
+        ::close(read_pipe);
+        if (error == ENOENT) {
+            // Report a missing executable the same way that a forked child does
+            proc_result res;
+            res.retc   = 255;
+            res.output = not_found_message(opts);
+            on_exit(nullptr, std::move(res));
+            return;
+        }
+        errno = error;
+        check_rc(false, "Failed to spawn subprocess");
+    }
+
+    auto proc     = std::make_unique<running_proc>();
+    proc->pid     = child;
+    proc->out_fd  = read_pipe;
+    proc->pid_fd  = open_pid_fd(child);
+    proc->command = quote_command(opts.command);
+    proc->on_exit = std::move(on_exit);
+    if (proc->pid_fd != -1) {
+        set_cloexec(proc->pid_fd);
+    }
+    if (opts.timeout) {
+        proc->deadline = std::chrono::steady_clock::now() + *opts.timeout;
+    }
+    proc_reactor::instance().add(std::move(proc));
+}
+
+}  // namespace
+
+void bpt::run_proc_async(const proc_options& opts, proc_callback on_exit) {
+    try {
+        spawn_supervised(opts, on_exit);
+    } catch (...) {
+        on_exit(std::current_exception(), {});
+    }
+}
+
+proc_result bpt::run_proc(const proc_options& opts) {
+    // The promise is shared with the callback, as the reactor thread may still be returning from
+    // set_value() when this thread wakes
+    auto promise = std::make_shared<std::promise<proc_result>>();
+    auto fut     = promise->get_future();
+    run_proc_async(opts, [promise](std::exception_ptr error, proc_result res) {
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(std::move(res));
+        }
+    });
+    // The calling thread sleeps until the reactor has collected the result
+    auto res = fut.get();
     cancellation_point();
     return res;
 }
@@ -0,0 +1,128 @@
+#include "./proc.hpp"
+
+#include <catch2/catch.hpp>
+
+#ifndef _WIN32
+
+#include <fmt/core.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Run a subprocess") {
+    auto res = bpt::run_proc(bpt::proc_options{
+        .command = {"sh", "-c", "echo out; echo err >&2; exit 4"},
+    });
+    CHECK(res.retc == 4);
+    CHECK(res.signal == 0);
+    CHECK_FALSE(res.timed_out);
+    // stdout and stderr are collected together
+    CHECK(res.output == "out\nerr\n");
+}
+
+TEST_CASE("Run a subprocess in another directory") {
+    auto res = bpt::run_proc(bpt::proc_options{.command = {"pwd"}, .cwd = "/"});
+    CHECK(res.okay());
+    CHECK(res.output == "/\n");
+}
+
+TEST_CASE("Run a subprocess that does not exist") {
+    auto res = bpt::run_proc({"bpt-this-executable-does-not-exist"});
+    CHECK_FALSE(res.okay());
+    CHECK(res.output.find("could not be found") != std::string::npos);
+}
+
+TEST_CASE("Interrupt a subprocess that times out") {
+    auto res = bpt::run_proc(bpt::proc_options{.command = {"sleep", "10"}, .timeout = 100ms});
+    CHECK(res.timed_out);
+    CHECK_FALSE(res.okay());
+}
+
+TEST_CASE("Run subprocesses asynchronously") {
+    std::mutex               mut;
+    std::condition_variable  cv;
+    std::vector<std::string> outputs;
+    int                      n_errors = 0;
+    // Catch assertions are not thread-safe, so the results are checked on this thread
+    auto on_exit = [&](std::exception_ptr error, bpt::proc_result res) {
+        std::scoped_lock lk{mut};
+        n_errors += error || !res.okay();
+        outputs.push_back(std::move(res.output));
+        cv.notify_all();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = 0; i < 4; ++i) {
+        bpt::run_proc_async({.command = {"sh", "-c", fmt::format("sleep 0.3; echo {}", i)}},
+                            on_exit);
+    }
+    std::unique_lock lk{mut};
+    cv.wait(lk, [&] { return outputs.size() == 4; });
+    // The children ran concurrently, though no thread waited on any of them
+    CHECK(std::chrono::steady_clock::now() - start < 1200ms);
+    CHECK(n_errors == 0);
+    std::ranges::sort(outputs);
+    CHECK(outputs == std::vector<std::string>{"0\n", "1\n", "2\n", "3\n"});
+
+    // A missing executable is reported to the callback, possibly on this thread
+    lk.unlock();
+    bpt::run_proc_async({.command = {"bpt-this-executable-does-not-exist"}}, on_exit);
+    lk.lock();
+    cv.wait(lk, [&] { return outputs.size() == 5; });
+    CHECK(n_errors == 1);
+    CHECK(outputs.back().find("could not be found") != std::string::npos);
+}
+
+namespace {
+
+/// Spawn the executable with a plain fork() and execvp(), as run_proc() formerly did
+void fork_exec_wait(const char* exe) {
+    auto pid = ::fork();
+    REQUIRE(pid != -1);
+    if (pid == 0) {
+        const char* argv[] = {exe, nullptr};
+        ::execvp(exe, const_cast<char* const*>(argv));
+        std::_Exit(127);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+}
+
+template <typename Func>
+std::chrono::microseconds mean_latency(int n, Func&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = 0; i < n; ++i) {
+        fn();
+    }
+    auto total = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration_cast<std::chrono::microseconds>(total / n);
+}
+
+}  // namespace
+
+TEST_CASE("Benchmark subprocess spawn latency", "[.][benchmark]") {
+    // Make the address space large, as it is during a build, where the cost of fork() is in
+    // copying the page tables.
+    std::vector<char> ballast(512 * 1024 * 1024);
+    std::memset(ballast.data(), 1, ballast.size());
+
+    const int n       = 200;
+    auto      forked  = mean_latency(n, [] { fork_exec_wait("true"); });
+    auto      spawned = mean_latency(n, [] { bpt::run_proc({"true"}); });
+    fmt::print("Mean spawn latency over {} runs with {} MiB resident:\n",
+               n,
+               ballast.size() / (1024 * 1024));
+    fmt::print("  fork()+execvp(): {:>7}μs\n", forked.count());
+    fmt::print("  run_proc():      {:>7}μs\n", spawned.count());
+}
+
+#endif
@@ -10,11 +10,14 @@
 #include <wil/resource.h>
 
 #include <windows.h>
+// Must come after windows.h
+#include <psapi.h>
 
 #include <cassert>
 #include <iomanip>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 
 using namespace bpt;
 using namespace std::chrono_literals;
@@ -126,9 +129,43 @@ proc_result bpt::run_proc(const proc_options& opts) {
         throw_system_error("Failed reading exit code of process");
     }
 
+    PROCESS_MEMORY_COUNTERS mem_counters = {};
+    if (::K32GetProcessMemoryInfo(proc_info.hProcess, &mem_counters, sizeof mem_counters)) {
+        res.usage.peak_rss = mem_counters.PeakWorkingSetSize;
+    }
+    FILETIME create_time, exit_time, kernel_time, user_time;
+    if (::GetProcessTimes(proc_info.hProcess, &create_time, &exit_time, &kernel_time, &user_time)) {
+        // FILETIME values count 100ns intervals
+        auto to_us = [](const FILETIME& ft) {
+            auto ticks = (std::uint64_t(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+            return std::chrono::microseconds(ticks / 10);
+        };
+        res.usage.user_cpu   = to_us(user_time);
+        res.usage.system_cpu = to_us(kernel_time);
+    }
+    IO_COUNTERS io_counters = {};
+    if (::GetProcessIoCounters(proc_info.hProcess, &io_counters)) {
+        res.usage.block_reads  = io_counters.ReadOperationCount;
+        res.usage.block_writes = io_counters.WriteOperationCount;
+    }
+
     res.retc   = rc;
     res.output = std::move(output);
     return res;
 }
 
+void bpt::run_proc_async(const proc_options& opts, proc_callback on_exit) {
+    // There is no shared supervisor on Windows, so each child is waited upon by a thread of its own
+    std::thread([opts, on_exit = std::move(on_exit)] {
+        proc_result res;
+        try {
+            res = run_proc(opts);
+        } catch (...) {
+            on_exit(std::current_exception(), {});
+            return;
+        }
+        on_exit(nullptr, std::move(res));
+    }).detach();
+}
+
 #endif  // _WIN32
\ No newline at end of file
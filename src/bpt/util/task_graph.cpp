@@ -0,0 +1,274 @@
+#include "./task_graph.hpp"
+
+#include <bpt/util/jobserver.hpp>
+#include <bpt/util/log.hpp>
+#include <bpt/util/parallel.hpp>
+#include <bpt/util/signal.hpp>
+#include <bpt/util/thread_pool.hpp>
+
+#include <neo/assert.hpp>
+#include <neo/event.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+using namespace bpt;
+
+task_graph::task_id
+task_graph::add(std::function<void()> fn, std::chrono::milliseconds cost, std::uint64_t memory) {
+    _tasks.push_back(task{std::move(fn), {}, cost, memory, {}, 0});
+    return _tasks.size() - 1;
+}
+
+task_graph::task_id task_graph::add_async(std::function<void(resume_fn)> start,
+                                          std::chrono::milliseconds      cost,
+                                          std::uint64_t                  memory) {
+    _tasks.push_back(task{{}, std::move(start), cost, memory, {}, 0});
+    return _tasks.size() - 1;
+}
+
+void task_graph::add_dependency(task_id task_, task_id dependency) {
+    neo_assert(expects,
+               task_ < _tasks.size() && dependency < _tasks.size(),
+               "Invalid task ID given for task_graph dependency",
+               task_,
+               dependency,
+               _tasks.size());
+    _tasks[dependency].dependents.push_back(task_);
+    ++_tasks[task_].n_dependencies;
+}
+
+std::vector<std::chrono::milliseconds> task_graph::critical_path_costs() const {
+    // Generate a topological ordering of the tasks
+    std::vector<std::size_t> n_pending;
+    std::vector<task_id>     order;
+    n_pending.reserve(_tasks.size());
+    order.reserve(_tasks.size());
+    for (auto i = 0u; i < _tasks.size(); ++i) {
+        n_pending.push_back(_tasks[i].n_dependencies);
+        if (_tasks[i].n_dependencies == 0) {
+            order.push_back(i);
+        }
+    }
+    for (auto i = 0u; i < order.size(); ++i) {
+        for (auto dependent : _tasks[order[i]].dependents) {
+            if (--n_pending[dependent] == 0) {
+                order.push_back(dependent);
+            }
+        }
+    }
+
+    // Walk backwards from the leaves to accumulate the costs of the downstream paths
+    std::vector<std::chrono::milliseconds> ret;
+    ret.reserve(_tasks.size());
+    for (auto& t : _tasks) {
+        ret.push_back(t.cost);
+    }
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        std::chrono::milliseconds downstream{0};
+        for (auto dependent : _tasks[*it].dependents) {
+            downstream = (std::max)(downstream, ret[dependent]);
+        }
+        ret[*it] = _tasks[*it].cost + downstream;
+    }
+    return ret;
+}
+
+bool task_graph::run(int n_jobs, std::uint64_t memory_budget) const {
+    std::mutex              mut;
+    std::condition_variable cv;
+
+    // Ready tasks are kept in a heap, with the longest critical path at the top. Ties are broken by
+    // the order in which tasks were added.
+    const auto priority = critical_path_costs();
+    auto cmp_priority = [&](task_id lhs, task_id rhs) {
+        if (priority[lhs] != priority[rhs]) {
+            return priority[lhs] < priority[rhs];
+        }
+        return lhs > rhs;
+    };
+
+    // The number of dependencies of each task that have yet to complete
+    std::vector<std::size_t> n_pending;
+    n_pending.reserve(_tasks.size());
+    // Tasks that are ready to execute
+    std::vector<task_id> ready;
+    for (auto i = 0u; i < _tasks.size(); ++i) {
+        n_pending.push_back(_tasks[i].n_dependencies);
+        if (_tasks[i].n_dependencies == 0) {
+            ready.push_back(i);
+        }
+    }
+    std::make_heap(ready.begin(), ready.end(), cmp_priority);
+
+    std::size_t                     n_running  = 0;
+    std::size_t                     n_finished = 0;
+    std::vector<std::exception_ptr> exceptions;
+    // The expected memory usage of the running tasks
+    std::uint64_t reserved_memory = 0;
+    // Asynchronous tasks whose work has completed, with the functions that will finish them
+    std::deque<std::pair<task_id, std::function<void()>>> resumed;
+
+    const int default_jobs = static_cast<int>(std::thread::hardware_concurrency()) + 2;
+    if (n_jobs < 1) {
+        n_jobs = default_jobs;
+    }
+    n_jobs = static_cast<int>((std::min)(static_cast<std::size_t>(n_jobs), _tasks.size()));
+
+    // Whether the highest-priority ready task can start without exceeding the memory budget. A
+    // task is always admitted if nothing else is running, so that a task that is larger than the
+    // whole budget can still make progress. Lower-priority tasks are never started in its place:
+    // they would take the memory that it is waiting for, and a large task could wait forever.
+    auto head_fits = [&] {
+        return memory_budget == 0 || n_running == 0
+            || reserved_memory + _tasks[ready.front()].memory <= memory_budget;
+    };
+    auto can_start = [&] {
+        return exceptions.empty() && !ready.empty()
+            && n_running < static_cast<std::size_t>(n_jobs) && head_fits();
+    };
+
+    // Every process implicitly holds one job slot, which is used by one running task at a time.
+    // Every other running task must hold a token from the jobserver until it finishes.
+    auto&                                        js                 = jobserver::global();
+    bool                                         implicit_slot_free = true;
+    std::vector<std::optional<jobserver::token>> tokens(_tasks.size());
+
+    // Record the outcome of a task, and release its job slot and memory. Requires the lock.
+    auto finish = [&](task_id id, std::exception_ptr error) {
+        reserved_memory -= _tasks[id].memory;
+        --n_running;
+        if (tokens[id]) {
+            tokens[id].reset();
+        } else {
+            implicit_slot_free = true;
+        }
+        if (error) {
+            exceptions.push_back(error);
+        } else {
+            ++n_finished;
+            // Unblock the tasks that were waiting on this one
+            for (auto dependent : _tasks[id].dependents) {
+                if (--n_pending[dependent] == 0) {
+                    ready.push_back(dependent);
+                    std::push_heap(ready.begin(), ready.end(), cmp_priority);
+                }
+            }
+        }
+        cv.notify_all();
+    };
+
+    auto resume_task = [&](task_id id) -> resume_fn {
+        return [&, id](std::function<void()> fn) {
+            std::unique_lock lk{mut};
+            resumed.emplace_back(id, std::move(fn));
+            cv.notify_all();
+        };
+    };
+
+    auto run_tasks = [&] {
+        neo::listener log_listen = &log::ev_log::print;
+
+        std::unique_lock lk{mut};
+        while (true) {
+            if (!resumed.empty()) {
+                // Finish an asynchronous task, which still holds its job slot
+                auto [id, fn] = std::move(resumed.front());
+                resumed.pop_front();
+                lk.unlock();
+                std::exception_ptr error;
+                try {
+                    fn();
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                lk.lock();
+                finish(id, error);
+                continue;
+            }
+            if (n_running == 0 && (!exceptions.empty() || ready.empty())) {
+                // There will never be more work
+                break;
+            }
+            if (!can_start()) {
+                // Wait for a running task to finish or be resumed, which may unblock more tasks or
+                // free memory
+                cv.wait(lk);
+                continue;
+            }
+            std::optional<jobserver::token> token;
+            if (!implicit_slot_free) {
+                // Wait for a job slot without holding the lock. Other threads may take the ready
+                // tasks in the meantime, in which case we go back to waiting for work.
+                lk.unlock();
+                token = js.acquire([&] {
+                    std::unique_lock lk2{mut};
+                    return !resumed.empty() || implicit_slot_free || !can_start();
+                });
+                lk.lock();
+                if (!token) {
+                    if (is_cancelled() && resumed.empty() && !implicit_slot_free) {
+                        // No more tokens will be given. Wait for the implicit slot.
+                        cv.wait(lk);
+                    }
+                    continue;
+                }
+                if (!can_start()) {
+                    continue;
+                }
+            }
+            std::pop_heap(ready.begin(), ready.end(), cmp_priority);
+            const auto id = ready.back();
+            ready.pop_back();
+            reserved_memory += _tasks[id].memory;
+            ++n_running;
+            if (token) {
+                tokens[id] = std::move(token);
+            } else {
+                implicit_slot_free = false;
+            }
+            auto& t = _tasks[id];
+            lk.unlock();
+            std::exception_ptr error;
+            try {
+                if (t.start) {
+                    t.start(resume_task(id));
+                } else {
+                    t.fn();
+                }
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lk.lock();
+            // An asynchronous task that has started is finished once it has been resumed
+            if (error || !t.start) {
+                finish(id, error);
+            }
+        }
+    };
+
+    // Asynchronous tasks do not occupy a worker while they wait, so more workers than the default
+    // number of jobs would only add threads
+    auto n_workers = n_jobs;
+    if (std::ranges::any_of(_tasks, [](const task& t) { return static_cast<bool>(t.start); })) {
+        n_workers = (std::min)(n_workers, default_jobs);
+    }
+    if (n_workers > 0) {
+        thread_pool::global().fan_out(n_workers, run_tasks);
+    }
+    for (auto eptr : exceptions) {
+        log_exception(eptr);
+    }
+    if (exceptions.empty()) {
+        neo_assert(invariant,
+                   n_finished == _tasks.size(),
+                   "Not every task in a task_graph was executed. Is there a dependency cycle?",
+                   n_finished,
+                   _tasks.size());
+    }
+    return exceptions.empty();
+}
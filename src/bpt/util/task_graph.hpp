@@ -0,0 +1,121 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace bpt {
+
+/**
+ * A collection of tasks with "must-run-before" relationships between them.
+ *
+ * Unlike `parallel_run`, which executes a flat range of homogeneous work items, a `task_graph` can
+ * mix different kinds of work (compiles, archives, links, tests) and will start each task as soon
+ * as every task that it depends upon has completed. This avoids the idle time that would be spent
+ * waiting on the slowest item of a preceding phase.
+ *
+ * Each task may be given an expected cost. When more tasks are ready than there are available
+ * jobs, the task with the longest remaining critical path (its own cost plus the most expensive
+ * chain of tasks that depend upon it) is started first. This prevents a long task from starting
+ * last and becoming the tail of the whole graph.
+ *
+ * Each task may also be given an expected peak memory usage. If the graph is run with a memory
+ * budget, a task will not start while the tasks that are already running would cause the budget to
+ * be exceeded. Lower-priority tasks do not start in its place, so that the memory it is waiting for
+ * is not taken by smaller tasks.
+ *
+ * A task that waits on work which does not need a thread, such as a child process, may be added
+ * with `add_async`. It holds its job slot while it waits, but not a worker thread, so a graph of
+ * such tasks can keep `n_jobs` jobs running with only as many workers as there are processors.
+ */
+class task_graph {
+public:
+    /// An opaque handle to a task within a graph.
+    using task_id = std::size_t;
+
+    /**
+     * Given to an asynchronous task, to be called once its work has completed. The function that
+     * it is given finishes the task, and is executed by one of the graph's workers.
+     */
+    using resume_fn = std::function<void(std::function<void()>)>;
+
+private:
+    struct task {
+        /// The work to perform
+        std::function<void()> fn;
+        /// For an asynchronous task, begins the work to perform
+        std::function<void(resume_fn)> start;
+        /// The expected duration of the task
+        std::chrono::milliseconds cost;
+        /// The expected peak memory usage of the task, in bytes
+        std::uint64_t memory;
+        /// The tasks that depend on this task
+        std::vector<task_id> dependents;
+        /// The number of tasks that must complete before this task can start
+        std::size_t n_dependencies = 0;
+    };
+
+    std::vector<task> _tasks;
+
+public:
+    /**
+     * Add a new task to the graph. The task will not start until all of its dependencies (added
+     * via `add_dependency`) have completed successfully.
+     * @param fn The work to perform
+     * @param cost The expected duration of the task, used to prioritize ready tasks
+     * @param memory The expected peak memory usage of the task in bytes, used to admit tasks
+     * against the memory budget given to `run()`
+     */
+    task_id
+    add(std::function<void()> fn, std::chrono::milliseconds cost = {}, std::uint64_t memory = 0);
+
+    /**
+     * Add a new asynchronous task to the graph. `start` should begin the work of the task and
+     * return without waiting for it. Once the work has completed, the `resume_fn` that was given to
+     * `start` must be called exactly once, from any thread, with a function that finishes the task.
+     * The task is complete once that function returns. If either function throws, the task fails.
+     * If `start` throws, it must not call `resume_fn`.
+     * @param start Begins the work to perform
+     * @param cost The expected duration of the task, used to prioritize ready tasks
+     * @param memory The expected peak memory usage of the task in bytes, used to admit tasks
+     * against the memory budget given to `run()`
+     */
+    task_id add_async(std::function<void(resume_fn)> start,
+                      std::chrono::milliseconds      cost   = {},
+                      std::uint64_t                  memory = 0);
+
+    /**
+     * Declare that `task` must not start until `dependency` has completed.
+     */
+    void add_dependency(task_id task, task_id dependency);
+
+    /**
+     * The number of tasks in the graph
+     */
+    std::size_t size() const noexcept { return _tasks.size(); }
+
+    /**
+     * Calculate the critical path cost of each task: The cost of the task plus the greatest
+     * critical path cost of any task that depends on it.
+     */
+    std::vector<std::chrono::milliseconds> critical_path_costs() const;
+
+    /**
+     * Execute every task in the graph, running up to `n_jobs` tasks in parallel. If `n_jobs` is
+     * less than one, a default based on the hardware concurrency will be used. If the graph has any
+     * asynchronous tasks, no more worker threads are used than that default.
+     *
+     * If `memory_budget` is non-zero, the expected memory usage of the running tasks will be kept
+     * within that many bytes. A task that exceeds the budget by itself will run once no other task
+     * is running.
+     *
+     * If any task throws an exception, no further tasks will be started. The exceptions will be
+     * logged and `false` will be returned once all running tasks (including asynchronous tasks that
+     * are waiting to be resumed) have finished.
+     */
+    bool run(int n_jobs, std::uint64_t memory_budget = 0) const;
+};
+
+}  // namespace bpt
@@ -0,0 +1,174 @@
+#include "./task_graph.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Run an empty task graph") {
+    bpt::task_graph graph;
+    CHECK(graph.run(4));
+}
+
+TEST_CASE("Tasks run after their dependencies") {
+    bpt::task_graph  graph;
+    std::mutex       mut;
+    std::vector<int> order;
+    auto             push = [&](int n) {
+        return [&, n] {
+            std::scoped_lock lk{mut};
+            order.push_back(n);
+        };
+    };
+
+    auto a = graph.add(push(1));
+    auto b = graph.add(push(2));
+    auto c = graph.add(push(3));
+    auto d = graph.add(push(4));
+    // d <- c <- {a, b}
+    graph.add_dependency(c, a);
+    graph.add_dependency(c, b);
+    graph.add_dependency(d, c);
+
+    CHECK(graph.run(8));
+    REQUIRE(order.size() == 4);
+    CHECK(order[2] == 3);
+    CHECK(order[3] == 4);
+}
+
+TEST_CASE("A failed task prevents its dependents from running") {
+    bpt::task_graph graph;
+    bool            ran_dependent = false;
+
+    auto bad = graph.add([] { throw std::runtime_error("Task failure"); });
+    auto dep = graph.add([&] { ran_dependent = true; });
+    graph.add_dependency(dep, bad);
+
+    CHECK_FALSE(graph.run(2));
+    CHECK_FALSE(ran_dependent);
+}
+
+TEST_CASE("Ready tasks are started longest critical path first") {
+    using namespace std::chrono_literals;
+    bpt::task_graph  graph;
+    std::vector<int> order;
+    auto             push = [&](int n) { return [&, n] { order.push_back(n); }; };
+
+    // A cheap task that is depended upon by an expensive one
+    auto cheap = graph.add(push(1), 1ms);
+    auto after = graph.add(push(2), 100ms);
+    graph.add_dependency(after, cheap);
+    // A medium-cost task with no dependents
+    graph.add(push(3), 50ms);
+    // A task with unknown cost
+    graph.add(push(4));
+
+    auto costs = graph.critical_path_costs();
+    CHECK(costs[cheap] == 101ms);
+    CHECK(costs[after] == 100ms);
+
+    // With a single job, the order is deterministic
+    CHECK(graph.run(1));
+    CHECK(order == std::vector<int>{1, 2, 3, 4});
+}
+
+TEST_CASE("Tasks are admitted against a memory budget") {
+    bpt::task_graph graph;
+    std::mutex      mut;
+    int             n_running = 0;
+    int             peak      = 0;
+    auto            track     = [&] {
+        {
+            std::scoped_lock lk{mut};
+            peak = (std::max)(peak, ++n_running);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::scoped_lock lk{mut};
+        --n_running;
+    };
+    for (auto i = 0; i < 6; ++i) {
+        graph.add(track, {}, 60);
+    }
+    // A task larger than the whole budget will still run
+    graph.add(track, {}, 500);
+
+    CHECK(graph.run(8, 100));
+    CHECK(peak == 1);
+}
+
+TEST_CASE("Smaller tasks do not take the memory that a higher-priority task is waiting for") {
+    using namespace std::chrono_literals;
+    bpt::task_graph  graph;
+    std::mutex       mut;
+    std::vector<int> order;
+    auto             start = [&](int n) {
+        return [&, n] {
+            {
+                std::scoped_lock lk{mut};
+                order.push_back(n);
+            }
+            std::this_thread::sleep_for(10ms);
+        };
+    };
+    graph.add(start(1), 300ms, 60);
+    // Cannot start alongside the first task
+    graph.add(start(2), 200ms, 80);
+    // Would fit alongside the first task, but must wait for the second (and cannot run with it)
+    graph.add(start(3), 1ms, 30);
+
+    CHECK(graph.run(2, 100));
+    CHECK(order == std::vector<int>{1, 2, 3});
+}
+
+TEST_CASE("Asynchronous tasks hold a job slot until they are resumed") {
+    using namespace std::chrono_literals;
+    bpt::task_graph          graph;
+    std::mutex               mut;
+    std::vector<std::thread> background;
+    int                      n_in_flight   = 0;
+    int                      max_in_flight = 0;
+    int                      n_finished    = 0;
+    // Each task finishes from a background thread, as a child process would
+    auto start = [&](bool fail) {
+        return [&, fail](bpt::task_graph::resume_fn resume) {
+            std::scoped_lock lk{mut};
+            max_in_flight = (std::max)(max_in_flight, ++n_in_flight);
+            background.emplace_back([&, fail, resume] {
+                std::this_thread::sleep_for(10ms);
+                resume([&, fail] {
+                    std::scoped_lock lk{mut};
+                    --n_in_flight;
+                    if (fail) {
+                        throw std::runtime_error("Task failure");
+                    }
+                    ++n_finished;
+                });
+            });
+        };
+    };
+
+    bool ran_dependent = false;
+    auto dependent     = graph.add([&] { ran_dependent = n_finished == 8; });
+    for (auto i = 0; i < 8; ++i) {
+        graph.add_dependency(dependent, graph.add_async(start(false)));
+    }
+    CHECK(graph.run(3));
+    CHECK(max_in_flight <= 3);
+    CHECK(ran_dependent);
+
+    SECTION("A failure while finishing prevents the dependents from running") {
+        bpt::task_graph failing;
+        ran_dependent = false;
+        auto after    = failing.add([&] { ran_dependent = true; });
+        failing.add_dependency(after, failing.add_async(start(true)));
+        CHECK_FALSE(failing.run(2));
+        CHECK_FALSE(ran_dependent);
+    }
+
+    for (auto& thr : background) {
+        thr.join();
+    }
+}
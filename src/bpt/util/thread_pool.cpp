@@ -0,0 +1,213 @@
+#include "./thread_pool.hpp"
+
+#include <bpt/util/parallel.hpp>
+#include <bpt/util/signal.hpp>
+
+#include <neo/scope.hpp>
+
+#include <algorithm>
+
+using namespace bpt;
+
+namespace {
+
+/// The pool that owns the current thread, if any
+thread_local thread_pool* tl_current_pool = nullptr;
+/// The index of the current thread's worker within `tl_current_pool`
+thread_local std::size_t tl_worker_index = 0;
+
+template <typename Queued>
+bool cmp_queued_priority(const Queued& lhs, const Queued& rhs) noexcept {
+    if (lhs.priority != rhs.priority) {
+        return lhs.priority < rhs.priority;
+    }
+    // Older tasks first
+    return lhs.sequence > rhs.sequence;
+}
+
+}  // namespace
+
+thread_pool::thread_pool(std::size_t n_workers) { ensure_workers(n_workers); }
+
+thread_pool::~thread_pool() {
+    {
+        std::unique_lock lk{_mut};
+        _stop = true;
+    }
+    _cv.notify_all();
+    for (auto& w : _workers) {
+        w->thread.join();
+    }
+}
+
+thread_pool& thread_pool::global() {
+    static thread_pool pool{std::thread::hardware_concurrency() + 2};
+    return pool;
+}
+
+void thread_pool::ensure_workers(std::size_t n) {
+    std::unique_lock lk{_mut};
+    while (_workers.size() < n) {
+        auto& w  = *_workers.emplace_back(std::make_unique<worker>());
+        w.thread = std::thread([this, idx = _workers.size() - 1] { _worker_main(idx); });
+    }
+}
+
+void thread_pool::_note_enqueued() noexcept {
+    auto depth = ++_queue_depth;
+    auto peak  = _peak_queue_depth.load();
+    while (depth > peak && !_peak_queue_depth.compare_exchange_weak(peak, depth)) {
+        // Retry
+    }
+}
+
+void thread_pool::submit(std::function<void()> fn, priority_type priority) {
+    std::unique_lock lk{_mut};
+    if (tl_current_pool == this && priority == 0) {
+        // Submitted from one of our own workers: Push onto its local queue
+        auto&            w = *_workers[tl_worker_index];
+        std::unique_lock w_lk{w.mut};
+        w.local.push_back(std::move(fn));
+    } else {
+        _shared.push_back(queued_task{std::move(fn), priority, _sequence++});
+        std::push_heap(_shared.begin(), _shared.end(), cmp_queued_priority<queued_task>);
+    }
+    _note_enqueued();
+    lk.unlock();
+    _cv.notify_one();
+}
+
+std::function<void()> thread_pool::_take(worker& self, std::size_t index) {
+    // Fast path: Take the most recent task from our own queue
+    {
+        std::unique_lock lk{self.mut};
+        if (!self.local.empty()) {
+            auto fn = std::move(self.local.back());
+            self.local.pop_back();
+            --_queue_depth;
+            return fn;
+        }
+    }
+
+    std::unique_lock lk{_mut};
+    while (true) {
+        {
+            std::unique_lock self_lk{self.mut};
+            if (!self.local.empty()) {
+                auto fn = std::move(self.local.back());
+                self.local.pop_back();
+                --_queue_depth;
+                return fn;
+            }
+        }
+        if (!_shared.empty()) {
+            std::pop_heap(_shared.begin(), _shared.end(), cmp_queued_priority<queued_task>);
+            auto fn = std::move(_shared.back().fn);
+            _shared.pop_back();
+            --_queue_depth;
+            return fn;
+        }
+        // Steal the oldest task from another worker
+        for (auto i = 1u; i < _workers.size(); ++i) {
+            auto&            victim = *_workers[(index + i) % _workers.size()];
+            std::unique_lock victim_lk{victim.mut};
+            if (!victim.local.empty()) {
+                auto fn = std::move(victim.local.front());
+                victim.local.pop_front();
+                --_queue_depth;
+                ++_n_stolen;
+                return fn;
+            }
+        }
+        if (_stop) {
+            return nullptr;
+        }
+        auto idle_start = std::chrono::steady_clock::now();
+        _cv.wait(lk);
+        _idle_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - idle_start)
+                        .count();
+    }
+}
+
+void thread_pool::_worker_main(std::size_t index) noexcept {
+    tl_current_pool = this;
+    tl_worker_index = index;
+    worker* self    = nullptr;
+    {
+        std::unique_lock lk{_mut};
+        self = _workers[index].get();
+    }
+    while (auto fn = _take(*self, index)) {
+        if (is_cancelled()) {
+            ++_n_cancelled;
+            continue;
+        }
+        try {
+            fn();
+        } catch (...) {
+            log_exception(std::current_exception());
+        }
+        ++_n_executed;
+    }
+}
+
+void thread_pool::fan_out(int n_jobs, const std::function<void()>& fn) {
+    // The state shared with the tasks that we submit. It is held by shared_ptr, as a task may not
+    // start until after we have returned.
+    struct fan_state {
+        std::mutex              mut;
+        std::condition_variable cv;
+        bool                    closed   = false;
+        int                     n_active = 0;
+    };
+    auto state = std::make_shared<fan_state>();
+
+    const auto n_helpers = static_cast<std::size_t>((std::max)(n_jobs, 1) - 1);
+    ensure_workers(n_helpers);
+    for (auto i = 0u; i < n_helpers; ++i) {
+        submit([state, &fn] {
+            {
+                std::unique_lock lk{state->mut};
+                if (state->closed) {
+                    // The caller has already finished. `fn` may no longer be valid.
+                    return;
+                }
+                ++state->n_active;
+            }
+            try {
+                fn();
+            } catch (...) {
+                log_exception(std::current_exception());
+            }
+            std::unique_lock lk{state->mut};
+            --state->n_active;
+            state->cv.notify_all();
+        });
+    }
+
+    neo_defer {
+        // Wait only for the helpers that actually started. Those that haven't will see `closed`.
+        std::unique_lock lk{state->mut};
+        state->closed = true;
+        state->cv.wait(lk, [&] { return state->n_active == 0; });
+    };
+
+    // Participate in the work ourselves. This also guarantees progress if every worker is busy.
+    fn();
+}
+
+thread_pool::statistics thread_pool::get_statistics() const noexcept {
+    statistics ret;
+    {
+        std::unique_lock lk{_mut};
+        ret.n_workers = _workers.size();
+    }
+    ret.queue_depth      = _queue_depth.load();
+    ret.peak_queue_depth = _peak_queue_depth.load();
+    ret.n_executed       = _n_executed.load();
+    ret.n_stolen         = _n_stolen.load();
+    ret.n_cancelled      = _n_cancelled.load();
+    ret.idle_time        = std::chrono::nanoseconds(_idle_ns.load());
+    return ret;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bpt {
+
+/**
+ * A persistent pool of worker threads that executes submitted tasks.
+ *
+ * Each worker has a local deque of tasks. Tasks submitted from a worker thread are placed on that
+ * worker's own deque, and idle workers will steal tasks from the deques of busy workers. Tasks
+ * submitted from outside the pool (or with a non-zero priority) are placed on a shared queue that
+ * is ordered by priority.
+ *
+ * Cancellation is cooperative: A task that has not yet started when `bpt::is_cancelled()` becomes
+ * true will be discarded. Tasks that are already running should call `bpt::cancellation_point()`
+ * as appropriate.
+ *
+ * Most code should not use the pool directly, but should use `parallel_run` or `task_graph`, which
+ * execute on the global pool.
+ */
+class thread_pool {
+public:
+    /// Tasks with a higher priority are started before tasks with a lower priority
+    using priority_type = std::int64_t;
+
+    /**
+     * Counters that describe the behavior of the pool.
+     */
+    struct statistics {
+        /// The number of worker threads in the pool
+        std::size_t n_workers = 0;
+        /// The number of tasks that are currently waiting to be executed
+        std::size_t queue_depth = 0;
+        /// The greatest number of tasks that have been waiting at once
+        std::size_t peak_queue_depth = 0;
+        /// The number of tasks that have been executed
+        std::uint64_t n_executed = 0;
+        /// The number of tasks that were stolen from another worker's queue
+        std::uint64_t n_stolen = 0;
+        /// The number of tasks that were discarded because of cancellation
+        std::uint64_t n_cancelled = 0;
+        /// The total amount of time that workers have spent waiting for tasks
+        std::chrono::nanoseconds idle_time{0};
+    };
+
+private:
+    struct queued_task {
+        std::function<void()> fn;
+        priority_type         priority;
+        std::uint64_t         sequence;
+    };
+
+    struct worker {
+        std::mutex                        mut;
+        std::deque<std::function<void()>> local;
+        std::thread                       thread;
+    };
+
+    /// Guards the shared queue, the set of workers, and the stop flag
+    mutable std::mutex      _mut;
+    std::condition_variable _cv;
+
+    /// The shared queue, stored as a heap
+    std::vector<queued_task> _shared;
+    std::uint64_t            _sequence = 0;
+    /// The workers. Held by pointer so that their addresses are stable as the pool grows.
+    std::vector<std::unique_ptr<worker>> _workers;
+    bool                                 _stop = false;
+
+    std::atomic<std::size_t>   _queue_depth{0};
+    std::atomic<std::size_t>   _peak_queue_depth{0};
+    std::atomic<std::uint64_t> _n_executed{0};
+    std::atomic<std::uint64_t> _n_stolen{0};
+    std::atomic<std::uint64_t> _n_cancelled{0};
+    std::atomic<std::int64_t>  _idle_ns{0};
+
+    void                  _worker_main(std::size_t index) noexcept;
+    std::function<void()> _take(worker& self, std::size_t index);
+    void                  _note_enqueued() noexcept;
+
+public:
+    /**
+     * Create a new pool with the given number of worker threads.
+     */
+    explicit thread_pool(std::size_t n_workers);
+    /**
+     * Waits for every queued task to complete, then joins all worker threads.
+     */
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    /**
+     * Obtain the process-wide thread pool.
+     */
+    static thread_pool& global();
+
+    /**
+     * Grow the pool, if necessary, such that it has at least `n` worker threads.
+     */
+    void ensure_workers(std::size_t n);
+
+    /**
+     * Enqueue a task for execution. If the task throws, the exception will be logged and
+     * discarded.
+     */
+    void submit(std::function<void()> fn, priority_type priority = 0);
+
+    /**
+     * Execute `fn` concurrently on up to `n_jobs` threads, and wait for every execution to return.
+     * The calling thread participates as one of the threads, so this may be safely called from a
+     * task that is running within the pool. `fn` should not throw.
+     */
+    void fan_out(int n_jobs, const std::function<void()>& fn);
+
+    /**
+     * Obtain a snapshot of the pool's counters.
+     */
+    statistics get_statistics() const noexcept;
+};
+
+}  // namespace bpt
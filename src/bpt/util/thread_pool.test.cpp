@@ -0,0 +1,35 @@
+#include "./thread_pool.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+
+TEST_CASE("Submit tasks to a pool") {
+    std::atomic_int n_run = 0;
+    {
+        bpt::thread_pool pool{4};
+        for (auto i = 0; i < 100; ++i) {
+            pool.submit([&] { ++n_run; });
+        }
+        // Destroying the pool waits for queued tasks
+    }
+    CHECK(n_run == 100);
+}
+
+TEST_CASE("Fan out work across threads") {
+    bpt::thread_pool pool{2};
+    std::atomic_int  n_run = 0;
+    pool.fan_out(8, [&] { ++n_run; });
+    // The caller always participates, and helpers that start late will not run the function
+    CHECK(n_run >= 1);
+    CHECK(n_run <= 8);
+    // The pool will have grown to accommodate the requested parallelism
+    CHECK(pool.get_statistics().n_workers == 7);
+}
+
+TEST_CASE("Nested fan-out does not deadlock") {
+    bpt::thread_pool pool{1};
+    std::atomic_int  n_inner = 0;
+    pool.fan_out(4, [&] { pool.fan_out(4, [&] { ++n_inner; }); });
+    CHECK(n_inner >= 1);
+}
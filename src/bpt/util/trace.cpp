@@ -0,0 +1,188 @@
+#include "./trace.hpp"
+
+#include <bpt/util/fs/io.hpp>
+#include <bpt/util/log.hpp>
+
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace bpt;
+using json = nlohmann::json;
+
+namespace {
+
+struct trace_event {
+    std::string  category;
+    std::string  name;
+    std::string  detail;
+    std::int64_t start_us;
+    std::int64_t duration_us;
+    int          lane;
+};
+
+struct trace_state {
+    std::atomic_bool                      recording{false};
+    std::chrono::steady_clock::time_point start_time;
+    std::atomic_int                       next_lane{0};
+
+    std::mutex               mut;
+    std::vector<trace_event> events;
+    /// The lanes that have been created for async slices, and those that are not in use
+    std::vector<int> async_lanes;
+    std::vector<int> free_async_lanes;
+};
+
+trace_state& state() noexcept {
+    static trace_state inst;
+    return inst;
+}
+
+/// Obtain the lane of the calling thread, assigning a new one on first use
+int this_thread_lane() noexcept {
+    thread_local int lane = state().next_lane.fetch_add(1);
+    return lane;
+}
+
+/// Obtain a lane for an async slice, reusing one whose slice has ended if possible
+int acquire_async_lane() {
+    auto&            st = state();
+    std::unique_lock lk{st.mut};
+    if (st.free_async_lanes.empty()) {
+        auto lane = st.next_lane.fetch_add(1);
+        st.async_lanes.push_back(lane);
+        return lane;
+    }
+    auto lane = st.free_async_lanes.back();
+    st.free_async_lanes.pop_back();
+    return lane;
+}
+
+std::int64_t us_since_start(std::chrono::steady_clock::time_point tp) noexcept {
+    return std::chrono::duration_cast<std::chrono::microseconds>(tp - state().start_time).count();
+}
+
+}  // namespace
+
+void trace::start_recording() noexcept {
+    auto& st      = state();
+    st.start_time = std::chrono::steady_clock::now();
+    // Claim the first lane for the calling thread
+    this_thread_lane();
+    st.recording = true;
+}
+
+bool trace::is_recording() noexcept { return state().recording.load(); }
+
+void trace::write_file(path_ref filepath) {
+    auto& st          = state();
+    auto  events      = json::array();
+    int   n_lanes;
+    auto  async_lanes = std::vector<int>{};
+    {
+        std::unique_lock lk{st.mut};
+        for (auto& ev : st.events) {
+            auto js = json::object({
+                {"name", ev.name},
+                {"cat", ev.category},
+                {"ph", "X"},
+                {"ts", ev.start_us},
+                {"dur", ev.duration_us},
+                {"pid", 1},
+                {"tid", ev.lane},
+            });
+            if (!ev.detail.empty()) {
+                js["args"] = json::object({{"detail", ev.detail}});
+            }
+            events.push_back(std::move(js));
+        }
+        n_lanes     = st.next_lane.load();
+        async_lanes = st.async_lanes;
+    }
+    // Give names to the process and the lanes
+    events.push_back(json::object({
+        {"name", "process_name"},
+        {"ph", "M"},
+        {"pid", 1},
+        {"args", json::object({{"name", "bpt"}})},
+    }));
+    for (auto lane = 0; lane < n_lanes; ++lane) {
+        auto lane_name = fmt::format("worker {}", lane);
+        if (lane == 0) {
+            lane_name = "main";
+        } else if (std::ranges::find(async_lanes, lane) != async_lanes.end()) {
+            lane_name = fmt::format("async {}", lane);
+        }
+        events.push_back(json::object({
+            {"name", "thread_name"},
+            {"ph", "M"},
+            {"pid", 1},
+            {"tid", lane},
+            {"args", json::object({{"name", std::move(lane_name)}})},
+        }));
+    }
+    auto doc = json::object({
+        {"traceEvents", std::move(events)},
+        {"displayTimeUnit", "ms"},
+    });
+    fs::create_directories(fs::absolute(filepath).parent_path());
+    bpt::write_file(filepath, doc.dump());
+    bpt_log(info, "Wrote build trace to [{}]", filepath.string());
+}
+
+trace::slice::slice(std::string_view category, std::string_view name, std::string_view detail) {
+    if (is_recording()) {
+        _begin(category, name, detail);
+    }
+}
+
+void trace::slice::_begin(std::string_view category,
+                          std::string_view name,
+                          std::string_view detail) {
+    _category = std::string(category);
+    _name     = std::string(name);
+    _detail   = std::string(detail);
+    _lane     = _async ? acquire_async_lane() : this_thread_lane();
+    _start    = std::chrono::steady_clock::now();
+    _active   = true;
+}
+
+trace::async_slice::async_slice(std::string_view category,
+                                std::string_view name,
+                                std::string_view detail) {
+    _async = true;
+    if (is_recording()) {
+        _begin(category, name, detail);
+    }
+}
+
+trace::slice::~slice() {
+    if (!_active) {
+        return;
+    }
+    auto  stop = std::chrono::steady_clock::now();
+    auto& st   = state();
+    auto  ev   = trace_event{
+        .category    = std::move(_category),
+        .name        = std::move(_name),
+        .detail      = std::move(_detail),
+        .start_us    = us_since_start(_start),
+        .duration_us = std::chrono::duration_cast<std::chrono::microseconds>(stop - _start).count(),
+        .lane        = _lane,
+    };
+    std::unique_lock lk{st.mut};
+    st.events.push_back(std::move(ev));
+    if (_async) {
+        st.free_async_lanes.push_back(_lane);
+    }
+}
+
+void trace::slice::set_detail(std::string_view detail) {
+    if (_active) {
+        _detail = std::string(detail);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <bpt/util/fs/path.hpp>
+
+#include <chrono>
+#include <concepts>
+#include <string>
+#include <string_view>
+
+namespace bpt::trace {
+
+/**
+ * Begin recording trace events. Until this is called, creating a `slice` has no effect. The
+ * calling thread is assigned the first lane of the trace.
+ */
+void start_recording() noexcept;
+
+/**
+ * Determine whether trace events are being recorded.
+ */
+bool is_recording() noexcept;
+
+/**
+ * Write every event recorded so far to the given file, in the Chrome trace event format. The
+ * file can be opened with chrome://tracing or https://ui.perfetto.dev.
+ */
+void write_file(path_ref filepath);
+
+/**
+ * Records a single slice of time on the calling thread's lane, covering the lifetime of this
+ * object. Each thread that records a slice is given its own lane in the trace, so slices recorded
+ * by the workers of `parallel_run` and `task_graph` show how the work was spread across them.
+ */
+class slice {
+    std::string _category;
+    std::string _name;
+    std::string _detail;
+
+    std::chrono::steady_clock::time_point _start;
+    bool                                  _active = false;
+    int                                   _lane   = 0;
+
+protected:
+    /// Whether the slice is placed on a lane of its own, rather than that of the calling thread
+    bool _async = false;
+
+    slice() = default;
+    void _begin(std::string_view category, std::string_view name, std::string_view detail);
+
+public:
+    /**
+     * @param category The kind of work being done, e.g. "compile" or "phase"
+     * @param name The name to display on the slice
+     * @param detail Additional information to attach to the slice, e.g. a command line
+     */
+    slice(std::string_view category, std::string_view name, std::string_view detail = {});
+
+    /**
+     * Create a slice whose name and detail are only generated if trace events are being
+     * recorded. Use this where formatting them would be a cost paid by every build.
+     * @param category The kind of work being done, e.g. "compile" or "phase"
+     * @param make_name Returns the name to display on the slice
+     * @param make_detail Returns the additional information to attach to the slice
+     */
+    template <std::invocable NameFn, std::invocable DetailFn>
+    slice(std::string_view category, NameFn&& make_name, DetailFn&& make_detail) {
+        if (is_recording()) {
+            _begin(category, make_name(), make_detail());
+        }
+    }
+
+    ~slice();
+
+    slice(const slice&) = delete;
+    slice& operator=(const slice&) = delete;
+
+    /// Replace the additional information attached to this slice
+    void set_detail(std::string_view detail);
+};
+
+/**
+ * A slice for work that does not occupy a thread, such as a child process that runs while its task
+ * waits to be resumed. It may end on a different thread than the one that began it. Each async
+ * slice is given a lane that no other running slice is using, and lanes are reused once their
+ * slices end.
+ */
+class async_slice : public slice {
+public:
+    /// @see slice::slice
+    async_slice(std::string_view category, std::string_view name, std::string_view detail = {});
+
+    /// @see slice::slice
+    template <std::invocable NameFn, std::invocable DetailFn>
+    async_slice(std::string_view category, NameFn&& make_name, DetailFn&& make_detail) {
+        _async = true;
+        if (is_recording()) {
+            _begin(category, make_name(), make_detail());
+        }
+    }
+};
+
+}  // namespace bpt::trace
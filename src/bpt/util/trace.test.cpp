@@ -0,0 +1,83 @@
+#include "./trace.hpp"
+
+#include <bpt/temp.hpp>
+#include <bpt/util/fs/io.hpp>
+
+#include <catch2/catch.hpp>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Record a build trace") {
+    int  n_generated = 0;
+    auto make_name   = [&] {
+        ++n_generated;
+        return std::string("lazy");
+    };
+    auto make_detail = [&] {
+        ++n_generated;
+        return std::string("the detail");
+    };
+
+    // Nothing is recorded or generated until recording begins
+    REQUIRE_FALSE(bpt::trace::is_recording());
+    { bpt::trace::slice s{"test", make_name, make_detail}; }
+    CHECK(n_generated == 0);
+
+    bpt::trace::start_recording();
+    CHECK(bpt::trace::is_recording());
+    { bpt::trace::slice s{"test", make_name, make_detail}; }
+    CHECK(n_generated == 2);
+    std::thread([] { bpt::trace::slice s{"test", "eager"}; }).join();
+
+    auto tdir = bpt::temporary_dir::create();
+    bpt::trace::write_file(tdir.path() / "trace.json");
+    auto doc = nlohmann::json::parse(bpt::read_file(tdir.path() / "trace.json"));
+
+    auto& events = doc["traceEvents"];
+    auto  slices = std::vector<nlohmann::json>{};
+    std::ranges::copy_if(events, std::back_inserter(slices), [](auto& ev) {
+        return ev["ph"] == "X";
+    });
+    REQUIRE(slices.size() == 2);
+    CHECK(slices[0]["name"] == "lazy");
+    CHECK(slices[0]["cat"] == "test");
+    CHECK(slices[0]["args"]["detail"] == "the detail");
+    CHECK(slices[0]["tid"] == 0);
+    CHECK(slices[1]["name"] == "eager");
+    CHECK_FALSE(slices[1].contains("args"));
+    // Each thread records to its own lane
+    CHECK(slices[1]["tid"] == 1);
+}
+
+TEST_CASE("Record async slices on lanes of their own") {
+    bpt::trace::start_recording();
+    {
+        auto first = std::make_unique<bpt::trace::async_slice>("async-test", "first");
+        bpt::trace::async_slice second{"async-test", [] { return "second"; }, [] { return ""; }};
+        // An async slice may end on another thread
+        std::thread([&] { first.reset(); }).join();
+        bpt::trace::async_slice third{"async-test", "third"};
+    }
+
+    auto tdir = bpt::temporary_dir::create();
+    bpt::trace::write_file(tdir.path() / "trace.json");
+    auto doc = nlohmann::json::parse(bpt::read_file(tdir.path() / "trace.json"));
+
+    std::map<std::string, int> lanes;
+    for (auto& ev : doc["traceEvents"]) {
+        if (ev["ph"] == "X" && ev["cat"] == "async-test") {
+            lanes[ev["name"]] = ev["tid"];
+        }
+    }
+    REQUIRE(lanes.size() == 3);
+    CHECK(lanes["first"] != lanes["second"]);
+    // The lane of the first slice is free again once it has ended
+    CHECK(lanes["third"] == lanes["first"]);
+}
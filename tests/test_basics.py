@@ -1,9 +1,10 @@
+import json
 from pathlib import Path
 import time
 from subprocess import CalledProcessError
 
 import pytest
-from bpt_ci import paths
+from bpt_ci import paths, proc
 from bpt_ci.bpt import BPTWrapper
 from bpt_ci.testing import Project, ProjectYAML
 from bpt_ci.testing.error import expect_error_marker
@@ -56,6 +57,135 @@ def test_simple_lib(tmp_project: Project) -> None:
     assert list(tmp_project.build_root.glob('libtest-project.*')) != [], 'No archive was created'
 
 
+def test_build_trace_file(tmp_project: Project, tmp_path: Path) -> None:
+    """Check that a build trace records the work that was done"""
+    tmp_project.write('src/foo.cpp', r'int foo() { return 0; }')
+    tmp_project.write('src/foo.main.cpp', r'int main() {}')
+    trace_file = tmp_path / 'trace.json'
+    tmp_project.build(more_args=[f'--trace-file={trace_file}'])
+    events = json.loads(trace_file.read_text())['traceEvents']
+    categories = {ev.get('cat') for ev in events}
+    assert {'phase', 'compile', 'archive', 'link'} <= categories
+
+
+def test_build_report(tmp_project: Project) -> None:
+    """Check that a report can be generated from a previous build"""
+    tmp_project.write('src/foo.hpp', r'int foo();')
+    tmp_project.write('src/foo.cpp', '#include "./foo.hpp"\nint foo() { return 0; }')
+    tmp_project.write('src/foo.main.cpp', '#include "./foo.hpp"\nint main() { return foo(); }')
+    tmp_project.build()
+    tmp_project.bpt.run(['build-report', f'--out={tmp_project.build_root}', '--limit=5'])
+
+
+def test_precompiled_header(tmp_project: Project) -> None:
+    """Check that a library can use a precompiled header, and that changes to it cause a rebuild"""
+    tmp_project.write('src/pch.hpp', '#pragma once\n#include <vector>\nconstexpr int value = 4;')
+    tmp_project.write('src/foo.main.cpp', '#include "./pch.hpp"\nint main() { return value; }')
+    tmp_project.bpt_yaml = {
+        'name': 'test',
+        'version': '1.2.3',
+        'libraries': [{
+            'path': '.',
+            'name': 'test',
+            'precompiled-header': 'src/pch.hpp',
+        }],
+    }
+    app = tmp_project.build_root / f'foo{paths.EXE_SUFFIX}'
+    tmp_project.build()
+    assert proc.run([app]).returncode == 4
+    # The program must see the new value when the precompiled header changes
+    time.sleep(1)  # Sleep long enough to register a file change
+    tmp_project.write('src/pch.hpp', '#pragma once\n#include <vector>\nconstexpr int value = 7;')
+    tmp_project.build()
+    assert proc.run([app]).returncode == 7
+
+
+def test_unity_build(tmp_project: Project) -> None:
+    """Check that library sources can be combined into unity compilations, and rebuilt on change"""
+    tmp_project.write('src/values.hpp', '#pragma once\nint value_1();\nint value_2();')
+    tmp_project.write('src/1.cpp', '#include "./values.hpp"\nint value_1() { return 3; }')
+    tmp_project.write('src/2.cpp', '#include "./values.hpp"\nint value_2() { return 4; }')
+    tmp_project.write('src/app.main.cpp',
+                      '#include "./values.hpp"\nint main() { return value_1() + value_2(); }')
+    app = tmp_project.build_root / f'app{paths.EXE_SUFFIX}'
+    tmp_project.build(more_args=['--unity'])
+    assert list(tmp_project.build_root.glob('**/*.unity.cpp'))
+    assert proc.run([app]).returncode == 7
+    time.sleep(1)  # Sleep long enough to register a file change
+    tmp_project.write('src/2.cpp', '#include "./values.hpp"\nint value_2() { return 9; }')
+    tmp_project.build(more_args=['--unity'])
+    assert proc.run([app]).returncode == 12
+
+
+def test_incremental_archive_and_link(tmp_project: Project) -> None:
+    """Check that unchanged archives and executables are not created again, but changed ones are"""
+    tmp_project.write('src/value.cpp', 'int value() { return 3; }')
+    tmp_project.write('src/app.main.cpp', 'int value();\nint main() { return value(); }')
+    app = tmp_project.build_root / f'app{paths.EXE_SUFFIX}'
+    tmp_project.build()
+    archive, = tmp_project.build_root.glob('lib*')
+    archive_mtime = archive.stat().st_mtime_ns
+    app_mtime = app.stat().st_mtime_ns
+    # A no-op build does not archive or link
+    time.sleep(1)
+    tmp_project.build()
+    assert archive.stat().st_mtime_ns == archive_mtime
+    assert app.stat().st_mtime_ns == app_mtime
+    # Changing a library source archives and links again
+    tmp_project.write('src/value.cpp', 'int value() { return 5; }')
+    tmp_project.build()
+    assert archive.stat().st_mtime_ns != archive_mtime
+    assert proc.run([app]).returncode == 5
+
+
+def test_source_listing_is_updated(tmp_project: Project) -> None:
+    """Check that files added after a build are found, though the listing of sources is recorded"""
+    tmp_project.write('src/value.cpp', 'int value() { return 3; }')
+    tmp_project.write('src/app.main.cpp', 'int value();\nint main() { return value(); }')
+    app = tmp_project.build_root / f'app{paths.EXE_SUFFIX}'
+    tmp_project.build()
+    tmp_project.build()
+    assert proc.run([app]).returncode == 3
+    # A source in a new subdirectory is compiled, and appears in the compilation database
+    tmp_project.write('src/sub/other.cpp', 'int other() { return 4; }')
+    tmp_project.write('src/app.main.cpp', 'int other();\nint main() { return other(); }')
+    tmp_project.build()
+    assert proc.run([app]).returncode == 4
+    compdb = json.loads(tmp_project.build_root.joinpath('compile_commands.json').read_text())
+    assert any(entry['file'].endswith('other.cpp') for entry in compdb)
+
+
+def test_cached_test_results(tmp_project: Project) -> None:
+    """Check that a passing test is only run again when it changes, or with --rerun-tests"""
+    runs_file = tmp_project.root / 'runs.txt'
+
+    def write_test(message: str) -> None:
+        tmp_project.write(
+            'src/count.test.cpp', f"""
+            #include <fstream>
+            int main() {{
+                std::ofstream{{{json.dumps(str(runs_file))}, std::ios::app}} << "{message}\\n";
+            }}
+            """)
+
+    def runs() -> list[str]:
+        return runs_file.read_text().splitlines()
+
+    write_test('first')
+    tmp_project.build()
+    assert runs() == ['first']
+    # The test has not changed, so it is not run again
+    tmp_project.build()
+    assert runs() == ['first']
+    tmp_project.build(more_args=['--rerun-tests'])
+    assert runs() == ['first', 'first']
+    # Changing the test runs it again
+    time.sleep(1)
+    write_test('second')
+    tmp_project.build()
+    assert runs() == ['first', 'first', 'second']
+
+
 def test_lib_with_just_test(tmp_project: Project) -> None:
     tmp_project.write('src/foo.test.cpp', 'int main() {}')
     tmp_project.build()
@@ -1,3 +1,5 @@
+from pathlib import Path
+import shutil
 import subprocess
 
 import pytest
@@ -87,3 +89,35 @@ def test_partial_build_rebuild(test_project: Project) -> None:
     ''')
     # We should now compile and link to get the updated value
     assert build_and_get_rc(test_project) == (99 - 6)
+
+
+def test_object_cache(test_project: Project, tmp_path: Path) -> None:
+    """
+    Objects restored from the object cache must reflect the current content of their inputs
+    """
+    args = [f'--object-cache-dir={tmp_path / "objects"}']
+    test_project.build(more_args=args)
+    # Build again from scratch. Every object will be restored from the cache.
+    shutil.rmtree(test_project.build_root)
+    test_project.build(more_args=args)
+    assert proc.run([test_project.build_root / ('app' + paths.EXE_SUFFIX)]).returncode == 0
+    # Changing a header must not restore the stale objects
+    test_project.write('src/values.hpp', '''
+        const int first_value = 4;
+        const int second_value = 10;
+    ''')
+    shutil.rmtree(test_project.build_root)
+    test_project.build(more_args=args)
+    assert proc.run([test_project.build_root / ('app' + paths.EXE_SUFFIX)]).returncode == 6
+
+
+def test_memory_budget(test_project: Project) -> None:
+    """
+    A memory budget smaller than any single compilation must still allow the build to complete
+    """
+    test_project.build(more_args=['--memory-budget=1'])
+    # Rebuild from scratch, now with recorded memory usage for every file
+    for obj in test_project.build_root.glob('**/*.o*'):
+        obj.unlink()
+    test_project.build(more_args=['--memory-budget=1'])
+    assert proc.run([test_project.build_root / ('app' + paths.EXE_SUFFIX)]).returncode == 0
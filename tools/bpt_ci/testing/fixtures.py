@@ -258,6 +258,7 @@ class Project:
               with_tests: bool = True,
               repos: Sequence[Pathish] = (),
               log_level: Literal['info', 'debug', 'trace'] = 'trace',
+              more_args: Sequence[str] = (),
               cwd: Pathish | None = None) -> None:
         """
         Execute 'bpt build' on the project
@@ -274,7 +275,7 @@ class Project:
                            tweaks_dir=tweaks_dir,
                            with_tests=with_tests,
                            repos=repos,
-                           more_args=[f'--log-level={log_level}'],
+                           more_args=[f'--log-level={log_level}', *more_args],
                            cwd=cwd)
 
     def compile_file(self, *paths: Pathish, toolchain: Optional[Pathish] = None) -> None: